@@ -0,0 +1,220 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "BackendQueue.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	const char *QUEUE_CLASS_NAMES[NUM_QUEUE_CLASSES] = {"demand_read", "demand_write", "prefetch", "writeback"};
+
+	QueueClass queue_class(TransactionType type)
+	{
+		if (type == DATA_READ)
+			return QUEUE_DEMAND_READ;
+		else if (type == DATA_WRITE)
+			return QUEUE_DEMAND_WRITE;
+		else if (type == PREFETCH)
+			return QUEUE_PREFETCH;
+		else
+			return QUEUE_WRITEBACK; // SYNC (and anything else that only moves dirty data)
+	}
+
+	BackendQueue::BackendQueue()
+	{
+		priority = false;
+		count = 0;
+		next_seq = 0;
+		selected = 0;
+	}
+
+	void BackendQueue::set_priority(bool p)
+	{
+		priority = p;
+
+		// Rebuild the page counts (they are only needed for PRIORITY).
+		pages.clear();
+		if (priority)
+		{
+			for (uint64_t c=0; c < NUM_QUEUE_CLASSES; c++)
+			{
+				for (list<Entry>::iterator it = queues[c].begin(); it != queues[c].end(); it++)
+					count_page(*it, c, true);
+			}
+		}
+	}
+
+	void BackendQueue::count_page(const Entry &e, uint64_t c, bool add)
+	{
+		uint64_t page = PAGE_ADDRESS(e.trans.address);
+		if (add)
+		{
+			unordered_map<uint64_t, PageCount>::iterator it = pages.find(page);
+			if (it == pages.end())
+			{
+				PageCount empty;
+				for (uint64_t i=0; i < NUM_QUEUE_CLASSES; i++)
+					empty.n[i] = 0;
+				it = pages.insert(make_pair(page, empty)).first;
+			}
+			it->second.n[c]++;
+		}
+		else
+		{
+			PageCount &pc = pages[page];
+			pc.n[c]--;
+			bool none = true;
+			for (uint64_t i=0; i < NUM_QUEUE_CLASSES; i++)
+				none = none && (pc.n[i] == 0);
+			if (none)
+				pages.erase(page);
+		}
+	}
+
+	void BackendQueue::push(const Transaction &t, QueueClass queue_class, uint64_t cycle)
+	{
+		Entry e;
+		e.trans = t;
+		e.cycle = cycle;
+		e.seq = next_seq++;
+		e.stat_class = queue_class;
+
+		uint64_t c = queue_class;
+		if (priority)
+		{
+			// Don't pass lower priority transactions to the same page.
+			unordered_map<uint64_t, PageCount>::iterator it = pages.find(PAGE_ADDRESS(t.address));
+			if (it != pages.end())
+			{
+				for (uint64_t i=NUM_QUEUE_CLASSES; i > c + 1; i--)
+				{
+					if (it->second.n[i-1] > 0)
+					{
+						c = i-1;
+						break;
+					}
+				}
+			}
+			count_page(e, c, true);
+		}
+
+		queues[c].push_back(e);
+		count++;
+	}
+
+	void BackendQueue::select(uint64_t cycle)
+	{
+		// Oldest first (FIFO), or the oldest of the starved classes (PRIORITY).
+		uint64_t oldest = NUM_QUEUE_CLASSES;
+		for (uint64_t c=0; c < NUM_QUEUE_CLASSES; c++)
+		{
+			if (queues[c].empty())
+				continue;
+			const Entry &head = queues[c].front();
+			if (priority && (cycle - head.cycle < QUEUE_STARVATION_LIMIT))
+				continue;
+			if ((oldest == NUM_QUEUE_CLASSES) || (head.seq < queues[oldest].front().seq))
+				oldest = c;
+		}
+
+		if (oldest < NUM_QUEUE_CLASSES)
+		{
+			selected = oldest;
+			return;
+		}
+
+		// Otherwise the highest priority class.
+		for (uint64_t c=0; c < NUM_QUEUE_CLASSES; c++)
+		{
+			if (!queues[c].empty())
+			{
+				selected = c;
+				return;
+			}
+		}
+	}
+
+	const Transaction &BackendQueue::front()
+	{
+		return queues[selected].front().trans;
+	}
+
+	uint64_t BackendQueue::pop(uint64_t cycle, QueueClass &queue_class)
+	{
+		const Entry &e = queues[selected].front();
+		uint64_t waited = cycle - e.cycle;
+		queue_class = (QueueClass)e.stat_class;
+		if (priority)
+			count_page(e, selected, false);
+		queues[selected].pop_front();
+		count--;
+		return waited;
+	}
+
+	void BackendQueue::checkpoint(StateWriter &w)
+	{
+		for (uint64_t c=0; c < NUM_QUEUE_CLASSES; c++)
+		{
+			w.put((uint64_t)queues[c].size());
+			for (list<Entry>::iterator it = queues[c].begin(); it != queues[c].end(); it++)
+			{
+				w.put(it->trans);
+				w.put(it->cycle);
+				w.put(it->seq);
+				w.put(it->stat_class);
+			}
+		}
+		w.put(next_seq);
+	}
+
+	void BackendQueue::restore(StateReader &r)
+	{
+		count = 0;
+		for (uint64_t c=0; c < NUM_QUEUE_CLASSES; c++)
+		{
+			uint64_t n;
+			r.get(n);
+			queues[c].clear();
+			for (uint64_t i=0; i < n; i++)
+			{
+				Entry e;
+				r.get(e.trans);
+				r.get(e.cycle);
+				r.get(e.seq);
+				r.get(e.stat_class);
+				queues[c].push_back(e);
+			}
+			count += n;
+		}
+		r.get(next_seq);
+		set_priority(priority);
+	}
+}
@@ -0,0 +1,120 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_BACKENDQUEUE_H
+#define HYBRIDSIM_BACKENDQUEUE_H
+
+// Queue of transactions waiting to be sent to a memory backend (dram_queue and flash_queue).
+//
+// Every transaction is queued in one of the classes below, depending on the request it was issued for.
+// With BACKEND_QUEUE_POLICY=FIFO, transactions are sent in the order they were queued. With PRIORITY, the
+// oldest transaction of the highest priority class goes first, unless the oldest transaction of some class
+// has waited QUEUE_STARVATION_LIMIT cycles, in which case the oldest of those goes first.
+//
+// Transactions to the same page are never reordered: a transaction queued behind lower priority
+// transactions to its page is queued in their class (it is still counted in its own class for the stats).
+
+#include <list>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "config.h"
+#include "Transaction.h"
+#include "Checkpoint.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	// Highest priority first.
+	enum QueueClass
+	{
+		QUEUE_DEMAND_READ,
+		QUEUE_DEMAND_WRITE,
+		QUEUE_PREFETCH,
+		QUEUE_WRITEBACK,
+		NUM_QUEUE_CLASSES
+	};
+
+	extern const char *QUEUE_CLASS_NAMES[NUM_QUEUE_CLASSES];
+
+	// Class of the backend traffic for a pending operation of the given type.
+	QueueClass queue_class(TransactionType type);
+
+	class BackendQueue
+	{
+		public:
+		BackendQueue();
+
+		// Switch between FIFO and PRIORITY (see BACKEND_QUEUE_POLICY).
+		void set_priority(bool priority);
+
+		void push(const Transaction &t, QueueClass queue_class, uint64_t cycle);
+
+		bool empty() { return count == 0; }
+		uint64_t size() { return count; }
+
+		// Pick the next transaction to send. front() and pop() then refer to it.
+		void select(uint64_t cycle);
+		const Transaction &front();
+
+		// Remove the selected transaction. Returns the number of cycles it waited and its class.
+		uint64_t pop(uint64_t cycle, QueueClass &queue_class);
+
+		void checkpoint(StateWriter &w);
+		void restore(StateReader &r);
+
+		private:
+		struct Entry
+		{
+			Transaction trans;
+			uint64_t cycle; // when it was queued
+			uint64_t seq; // queue order
+			uint64_t stat_class; // class it is counted in (the queue it is in may be lower)
+		};
+
+		void count_page(const Entry &e, uint64_t c, bool add);
+
+		bool priority;
+		list<Entry> queues[NUM_QUEUE_CLASSES];
+		uint64_t count;
+		uint64_t next_seq;
+		uint64_t selected;
+
+		// Number of queued transactions to each page in each class (only kept for PRIORITY).
+		struct PageCount
+		{
+			uint64_t n[NUM_QUEUE_CLASSES];
+		};
+		unordered_map<uint64_t, PageCount> pages;
+	};
+}
+
+#endif
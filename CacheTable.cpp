@@ -0,0 +1,151 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "CacheTable.h"
+
+#include <new>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace HybridSim
+{
+	const uint64_t CACHE_TABLE_HUGE_PAGE = 2*1024*1024;
+
+	CacheTable::CacheTable()
+	{
+		page_size = 1;
+		num_lines = 0;
+		lines = NULL;
+		prefill = false;
+		prefill_dirty = false;
+		num_sets = 1;
+	}
+
+	CacheTable::~CacheTable()
+	{
+		release();
+	}
+
+	void CacheTable::release()
+	{
+		// cache_line has a trivial destructor, so the memory can just be freed.
+		free(lines);
+		lines = NULL;
+		num_lines = 0;
+	}
+
+	void CacheTable::init(uint64_t num_pages, uint64_t page_bytes, bool prefill, bool prefill_dirty, uint64_t num_sets)
+	{
+		release();
+
+		page_size = page_bytes;
+		this->prefill = prefill;
+		this->prefill_dirty = prefill_dirty;
+		this->num_sets = (num_sets == 0) ? 1 : num_sets;
+
+		// Raw allocation, the lines are constructed by fill(). Large tables are aligned for transparent huge
+		// pages, which cuts the number of page faults taken by the fill by a factor of 512.
+		uint64_t bytes = num_pages * sizeof(cache_line);
+		void *mem = NULL;
+		if (bytes >= CACHE_TABLE_HUGE_PAGE)
+		{
+			if (posix_memalign(&mem, CACHE_TABLE_HUGE_PAGE, bytes) != 0)
+				mem = NULL;
+#ifdef MADV_HUGEPAGE
+			if (mem != NULL)
+				madvise(mem, bytes, MADV_HUGEPAGE);
+#endif
+		}
+		else
+			mem = malloc(bytes);
+		if ((mem == NULL) && (num_pages > 0))
+		{
+			cerr << "ERROR: Failed to allocate the cache table (" << num_pages << " pages).\n";
+			abort();
+		}
+		lines = (cache_line *)mem;
+		num_lines = num_pages;
+
+		uint64_t num_threads = thread::hardware_concurrency();
+		if ((num_threads <= 1) || (num_lines < CACHE_TABLE_PARALLEL_MIN))
+		{
+			fill(0, num_lines);
+			return;
+		}
+
+		// Split the table into one contiguous chunk per thread. The calling thread does the last chunk.
+		num_threads = min(num_threads, num_lines / (CACHE_TABLE_PARALLEL_MIN / 4));
+		uint64_t chunk = (num_lines + num_threads - 1) / num_threads;
+		vector<thread> workers;
+		for (uint64_t t=0; t < num_threads - 1; t++)
+			workers.push_back(thread(&CacheTable::fill, this, t * chunk, (t + 1) * chunk));
+		fill((num_threads - 1) * chunk, num_lines);
+		for (uint64_t t=0; t < workers.size(); t++)
+			workers[t].join();
+	}
+
+	void CacheTable::fill(uint64_t first, uint64_t last)
+	{
+		last = min(last, num_lines);
+		if (first >= last)
+			return;
+
+		if (!prefill)
+		{
+			for (uint64_t i=first; i < last; i++)
+				new (&lines[i]) cache_line();
+			return;
+		}
+
+		// Cache page i holds tag i / num_sets. Step through the sets instead of dividing for every line.
+		uint64_t tag = first / num_sets;
+		uint64_t set = first % num_sets;
+		for (uint64_t i=first; i < last; i++)
+		{
+			cache_line *line = new (&lines[i]) cache_line();
+			line->valid = true;
+			line->dirty = prefill_dirty;
+			line->sector_valid = ALL_SECTORS;
+			line->sector_dirty = prefill_dirty ? ALL_SECTORS : 0;
+			line->tag = tag;
+
+			set++;
+			if (set == num_sets)
+			{
+				set = 0;
+				tag++;
+			}
+		}
+	}
+}
@@ -0,0 +1,96 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_CACHETABLE_H
+#define HYBRIDSIM_CACHETABLE_H
+
+// The cache tag store.
+//
+// This is a flat table with one cache_line per cache page, indexed by the cache address (page number *
+// PAGE_SIZE). It has the same count()/operator[] interface as the unordered_map it replaced, but every page
+// always exists (lines start out invalid), so lookups are a single array index.
+//
+// For large caches the table is hundreds of MB, so init() fills it in one pass split across threads. The
+// memory is not touched before that pass, so each thread also takes the page faults for its own chunk.
+
+#include <stdint.h>
+
+#include "config.h"
+
+namespace HybridSim
+{
+	// Tables smaller than this are filled by the calling thread only.
+	const uint64_t CACHE_TABLE_PARALLEL_MIN = 65536;
+
+	class CacheTable
+	{
+		public:
+		CacheTable();
+		~CacheTable();
+
+		// Allocate num_pages invalid lines. If prefill is set, every line is instead made valid and mapped to
+		// the first num_pages pages of the NVDIMM (i.e. cache page i holds tag i / num_sets), as for PREFILL_CACHE.
+		void init(uint64_t num_pages, uint64_t page_bytes, bool prefill=false, bool prefill_dirty=false, uint64_t num_sets=1);
+
+		uint64_t count(uint64_t cache_addr) const
+		{
+			return ((cache_addr % page_size) == 0) && ((cache_addr / page_size) < num_lines) ? 1 : 0;
+		}
+
+		cache_line &operator[](uint64_t cache_addr)
+		{
+			assert((cache_addr / page_size) < num_lines);
+			return lines[cache_addr / page_size];
+		}
+
+		// Access by cache page number.
+		cache_line &line(uint64_t index) { return lines[index]; }
+		uint64_t size() const { return num_lines; }
+
+		private:
+		// Not copyable (the table owns its memory).
+		CacheTable(const CacheTable &);
+		CacheTable &operator=(const CacheTable &);
+
+		void release();
+		void fill(uint64_t first, uint64_t last);
+
+		uint64_t page_size;
+		uint64_t num_lines;
+		cache_line *lines;
+
+		// Parameters of the current init() for fill().
+		bool prefill;
+		bool prefill_dirty;
+		uint64_t num_sets;
+	};
+}
+
+#endif
@@ -0,0 +1,524 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "Checkpoint.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace HybridSim
+{
+	// Number of records buffered by saveCheckpoint() before each write.
+	const uint64_t CHECKPOINT_BUFFER_RECORDS = 65536;
+
+	const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+	const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+	// FNV-1a, one 64 bit word at a time (records are a multiple of 8 bytes).
+	template <class R> static inline uint64_t checksum_record(uint64_t hash, const R &rec)
+	{
+		const uint64_t *words = (const uint64_t *)&rec;
+		for (uint64_t i=0; i < sizeof(R)/8; i++)
+		{
+			hash ^= words[i];
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	static void check_geometry(uint64_t page_size, uint64_t set_size, uint64_t cache_pages, uint64_t total_pages)
+	{
+		if (page_size != PAGE_SIZE)
+		{
+			cerr << "ERROR: Attempted to restore state and PAGE_SIZE does not match in restore file and ini file."  << "\n";
+			abort();
+		}
+		if (set_size != SET_SIZE)
+		{
+			cerr << "ERROR: Attempted to restore state and SET_SIZE does not match in restore file and ini file."  << "\n";
+			abort();
+		}
+		if (cache_pages != CACHE_PAGES)
+		{
+			cerr << "ERROR: Attempted to restore state and CACHE_PAGES does not match in restore file and ini file."  << "\n";
+			abort();
+		}
+		if (total_pages != TOTAL_PAGES)
+		{
+			cerr << "ERROR: Attempted to restore state and TOTAL_PAGES does not match in restore file and ini file."  << "\n";
+			abort();
+		}
+	}
+
+	static void write_all(int fd, const void *buf, uint64_t len, string filename)
+	{
+		const char *p = (const char *)buf;
+		while (len > 0)
+		{
+			ssize_t ret = ::write(fd, p, len);
+			if (ret <= 0)
+			{
+				cerr << "ERROR: Failed to write checkpoint file: " << filename << "\n";
+				abort();
+			}
+			p += ret;
+			len -= ret;
+		}
+	}
+
+	void saveCheckpoint(string filename, CacheTable &cache)
+	{
+		int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+		{
+			cerr << "ERROR: Failed to load HybridSim's state save file: " << filename << "\n";
+			abort();
+		}
+
+		CheckpointHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+		header.version = CHECKPOINT_VERSION;
+		header.record_size = sizeof(CheckpointRecord);
+		header.page_size = PAGE_SIZE;
+		header.set_size = SET_SIZE;
+		header.cache_pages = CACHE_PAGES;
+		header.total_pages = TOTAL_PAGES;
+		header.num_records = cache.size();
+		header.sector_size = SECTOR_SIZE;
+
+		// The checksum is only known at the end, so write a placeholder header first.
+		write_all(fd, &header, sizeof(header), filename);
+
+		vector<CheckpointRecord> buffer(CHECKPOINT_BUFFER_RECORDS);
+		uint64_t buffer_count = 0;
+		uint64_t hash = FNV_OFFSET;
+		for (uint64_t i=0; i < cache.size(); i++)
+		{
+			cache_line &line = cache.line(i);
+			CheckpointRecord &rec = buffer[buffer_count++];
+			rec.tag = line.tag;
+			rec.ts = line.ts;
+			rec.flags = (line.valid ? CHECKPOINT_VALID : 0) | (line.dirty ? CHECKPOINT_DIRTY : 0) |
+				(line.prefetched ? CHECKPOINT_PREFETCHED : 0) | (line.used ? CHECKPOINT_USED : 0);
+			rec.sector_valid = line.sector_valid;
+			rec.sector_dirty = line.sector_dirty;
+			rec.reserved = 0;
+			hash = checksum_record(hash, rec);
+
+			if (buffer_count == CHECKPOINT_BUFFER_RECORDS)
+			{
+				write_all(fd, &buffer[0], buffer_count * sizeof(CheckpointRecord), filename);
+				buffer_count = 0;
+			}
+		}
+		if (buffer_count > 0)
+			write_all(fd, &buffer[0], buffer_count * sizeof(CheckpointRecord), filename);
+
+		header.checksum = hash;
+		if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header))
+		{
+			cerr << "ERROR: Failed to write checkpoint header: " << filename << "\n";
+			abort();
+		}
+
+		::close(fd);
+	}
+
+	bool isBinaryCheckpoint(string filename)
+	{
+		char magic[8];
+		ifstream inFile(filename.c_str(), ios_base::in | ios_base::binary);
+		if (!inFile.is_open())
+			return false;
+		inFile.read(magic, 8);
+		return inFile.gcount() == 8 && memcmp(magic, CHECKPOINT_MAGIC, 8) == 0;
+	}
+
+	// Sector bitmaps of a restored page. Version 1 records don't have them, and bitmaps taken with another
+	// SECTOR_SIZE don't mean anything, so those pages are restored whole.
+	static inline void restore_sectors(cache_line &line, const CheckpointRecordV1 &rec, bool same_sectors)
+	{
+		line.sector_valid = line.valid ? ALL_SECTORS : 0;
+		line.sector_dirty = line.dirty ? ALL_SECTORS : 0;
+	}
+
+	static inline void restore_sectors(cache_line &line, const CheckpointRecord &rec, bool same_sectors)
+	{
+		if (!same_sectors)
+		{
+			line.sector_valid = line.valid ? ALL_SECTORS : 0;
+			line.sector_dirty = line.dirty ? ALL_SECTORS : 0;
+			return;
+		}
+		line.sector_valid = rec.sector_valid;
+		line.sector_dirty = line.dirty ? rec.sector_dirty : 0;
+	}
+
+	// Copy and checksum the records in the same pass so the file is only read once. Returns the checksum.
+	template <class R> static uint64_t restore_records(const void *data, uint64_t num_records, CacheTable &cache,
+			bool clean, bool same_sectors)
+	{
+		const R *records = (const R *)data;
+		uint64_t hash = FNV_OFFSET;
+		for (uint64_t i=0; i < num_records; i++)
+		{
+			const R &rec = records[i];
+			hash = checksum_record(hash, rec);
+
+			cache_line &line = cache.line(i);
+			line.valid = rec.flags & CHECKPOINT_VALID;
+			line.dirty = (rec.flags & CHECKPOINT_DIRTY) && !clean;
+			line.prefetched = rec.flags & CHECKPOINT_PREFETCHED;
+			line.used = rec.flags & CHECKPOINT_USED;
+			line.tag = rec.tag;
+			line.ts = rec.ts;
+			restore_sectors(line, rec, same_sectors);
+
+			// The line must not be locked on restore.
+			// This is a point of weirdness with the replay warmup design (since we can't restore the system
+			// exactly as it was), but it is unavoidable. In flight transactions are simply lost. Although, if
+			// replay warmup is done right, the system should run until all transactions are processed.
+			line.locked = false;
+			line.lock_count = 0;
+		}
+		return hash;
+	}
+
+	static void loadBinaryCheckpoint(string filename, CacheTable &cache, bool clean)
+	{
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			cerr << "ERROR: Failed to load HybridSim's state restore file: " << filename << "\n";
+			abort();
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(CheckpointHeaderV1))
+		{
+			cerr << "ERROR: Checkpoint file is truncated: " << filename << "\n";
+			abort();
+		}
+
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED)
+		{
+			cerr << "ERROR: Failed to mmap checkpoint file: " << filename << "\n";
+			abort();
+		}
+		madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+		// Both header versions start the same way, up to the checksum.
+		const CheckpointHeaderV1 *header = (const CheckpointHeaderV1 *)map;
+		uint64_t header_size, record_size;
+		if (header->version == CHECKPOINT_VERSION)
+		{
+			header_size = sizeof(CheckpointHeader);
+			record_size = sizeof(CheckpointRecord);
+		}
+		else if (header->version == 1)
+		{
+			header_size = sizeof(CheckpointHeaderV1);
+			record_size = sizeof(CheckpointRecordV1);
+		}
+		else
+			header_size = record_size = 0;
+		if ((header_size == 0) || (header->record_size != record_size) || ((uint64_t)st.st_size < header_size))
+		{
+			cerr << "ERROR: Unsupported checkpoint version or record size in " << filename << "\n";
+			abort();
+		}
+		check_geometry(header->page_size, header->set_size, header->cache_pages, header->total_pages);
+		if (header->num_records != cache.size() ||
+				(uint64_t)st.st_size != header_size + header->num_records * record_size)
+		{
+			cerr << "ERROR: Checkpoint file size does not match its header: " << filename << "\n";
+			abort();
+		}
+
+		const void *records = (const char *)map + header_size;
+		uint64_t hash;
+		if (header->version == CHECKPOINT_VERSION)
+		{
+			bool same_sectors = ((const CheckpointHeader *)map)->sector_size == SECTOR_SIZE;
+			hash = restore_records<CheckpointRecord>(records, header->num_records, cache, clean, same_sectors);
+		}
+		else
+			hash = restore_records<CheckpointRecordV1>(records, header->num_records, cache, clean, false);
+
+		if (hash != header->checksum)
+		{
+			cerr << "ERROR: Checkpoint checksum mismatch, the file is corrupt: " << filename << "\n";
+			abort();
+		}
+
+		munmap(map, st.st_size);
+		::close(fd);
+	}
+
+	static void loadTextCheckpoint(string filename, CacheTable &cache, bool clean)
+	{
+		ifstream inFile;
+		inFile.open(filename.c_str());
+		if (!inFile.is_open())
+		{
+			cerr << "ERROR: Failed to load HybridSim's state restore file: " << filename << "\n";
+			abort();
+		}
+
+		// Read the parameters and confirm that they are the same as the current HybridSystem instance.
+		uint64_t page_size = 0, set_size = 0, cache_pages = 0, total_pages = 0;
+		inFile >> page_size >> set_size >> cache_pages >> total_pages;
+		check_geometry(page_size, set_size, cache_pages, total_pages);
+
+		// The ASCII format only lists the valid pages, so everything else starts out invalid.
+		cache.init(CACHE_PAGES, PAGE_SIZE);
+
+		uint64_t cache_addr, data;
+		cache_line line;
+		while (inFile >> cache_addr >> line.valid >> line.dirty >> line.tag >> data >> line.ts)
+		{
+			if (cache.count(cache_addr) == 0)
+			{
+				cerr << "ERROR: Invalid cache address " << cache_addr << " in restore file " << filename << "\n";
+				abort();
+			}
+
+			if (clean)
+				line.dirty = 0;
+			line.sector_valid = line.valid ? ALL_SECTORS : 0;
+			line.sector_dirty = line.dirty ? ALL_SECTORS : 0;
+
+			// See the comment in loadBinaryCheckpoint().
+			line.locked = false;
+
+			cache[cache_addr] = line;
+		}
+
+		inFile.close();
+	}
+
+	void loadCheckpoint(string filename, CacheTable &cache, bool clean)
+	{
+		if (isBinaryCheckpoint(filename))
+			loadBinaryCheckpoint(filename, cache, clean);
+		else
+			loadTextCheckpoint(filename, cache, clean);
+	}
+
+
+	void StateWriter::open(string filename)
+	{
+		this->filename = filename;
+		outFile.open(filename.c_str(), ios_base::out | ios_base::trunc | ios_base::binary);
+		if (!outFile.is_open())
+		{
+			cerr << "ERROR: Failed to open HybridSim state file for writing: " << filename << "\n";
+			abort();
+		}
+
+		write(STATE_MAGIC, 8);
+		put(STATE_VERSION);
+	}
+
+	void StateWriter::close()
+	{
+		section("end");
+		outFile.close();
+		if (outFile.fail())
+		{
+			cerr << "ERROR: Failed to write HybridSim state file: " << filename << "\n";
+			abort();
+		}
+	}
+
+	void StateWriter::write(const void *buf, uint64_t len)
+	{
+		outFile.write((const char *)buf, len);
+	}
+
+	void StateWriter::section(string name)
+	{
+		put(name);
+	}
+
+	void StateWriter::put(const string &v)
+	{
+		put((uint64_t)v.size());
+		write(v.data(), v.size());
+	}
+
+	void StateWriter::put(const Transaction &t)
+	{
+		// The data pointer is not saved. HybridSim itself never uses it.
+		put((uint32_t)t.transactionType);
+		put(t.address);
+	}
+
+	void StateWriter::put(const Pending &p)
+	{
+		put((uint32_t)p.op);
+		put(p.orig_addr);
+		put(p.flash_addr);
+		put(p.cache_addr);
+		put(p.victim_tag);
+		put(p.victim_valid);
+		put(p.callback_sent);
+		put((uint32_t)p.type);
+		put(p.sectors);
+		put(p.victim_sectors);
+	}
+
+	void StateWriter::put(const cache_line &line)
+	{
+		put(line.valid);
+		put(line.dirty);
+		put(line.locked);
+		put(line.prefetched);
+		put(line.used);
+		put(line.lock_count);
+		put(line.tag);
+		put(line.sector_valid);
+		put(line.sector_dirty);
+		put(line.ts);
+	}
+
+	void StateReader::open(string filename)
+	{
+		this->filename = filename;
+		inFile.open(filename.c_str(), ios_base::in | ios_base::binary);
+		if (!inFile.is_open())
+		{
+			cerr << "ERROR: Failed to open HybridSim state file: " << filename << "\n";
+			abort();
+		}
+
+		char magic[8];
+		uint32_t version;
+		read(magic, 8);
+		get(version);
+		if (memcmp(magic, STATE_MAGIC, 8) != 0 || version != STATE_VERSION)
+		{
+			cerr << "ERROR: " << filename << " is not a HybridSim state file of version " << STATE_VERSION << "\n";
+			abort();
+		}
+	}
+
+	void StateReader::close()
+	{
+		section("end");
+		inFile.close();
+	}
+
+	void StateReader::read(void *buf, uint64_t len)
+	{
+		inFile.read((char *)buf, len);
+		if ((uint64_t)inFile.gcount() != len)
+		{
+			cerr << "ERROR: HybridSim state file is truncated: " << filename << "\n";
+			abort();
+		}
+	}
+
+	void StateReader::section(string name)
+	{
+		string found;
+		uint64_t len;
+		get(len);
+		if (len > 256)
+		{
+			cerr << "ERROR: Expected section " << name << " in HybridSim state file " << filename << "\n";
+			abort();
+		}
+		found.resize(len);
+		if (len > 0)
+			read(&found[0], len);
+		if (found != name)
+		{
+			cerr << "ERROR: Expected section " << name << " but found " << found << " in HybridSim state file " << filename << "\n";
+			abort();
+		}
+	}
+
+	void StateReader::get(string &v)
+	{
+		uint64_t len;
+		get(len);
+		v.resize(len);
+		if (len > 0)
+			read(&v[0], len);
+	}
+
+	void StateReader::get(Transaction &t)
+	{
+		uint32_t type;
+		get(type);
+		t.transactionType = (TransactionType)type;
+		get(t.address);
+		t.data = NULL;
+	}
+
+	void StateReader::get(Pending &p)
+	{
+		uint32_t tmp;
+		get(tmp);
+		p.op = (PendingOperation)tmp;
+		get(p.orig_addr);
+		get(p.flash_addr);
+		get(p.cache_addr);
+		get(p.victim_tag);
+		get(p.victim_valid);
+		get(p.callback_sent);
+		get(tmp);
+		p.type = (TransactionType)tmp;
+		get(p.sectors);
+		get(p.victim_sectors);
+	}
+
+	void StateReader::get(cache_line &line)
+	{
+		get(line.valid);
+		get(line.dirty);
+		get(line.locked);
+		get(line.prefetched);
+		get(line.used);
+		get(line.lock_count);
+		get(line.tag);
+		get(line.sector_valid);
+		get(line.sector_dirty);
+		get(line.ts);
+	}
+}
@@ -0,0 +1,303 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_CHECKPOINT_H
+#define HYBRIDSIM_CHECKPOINT_H
+
+// Cache table checkpoints.
+//
+// A checkpoint file starts with a fixed 72 byte CheckpointHeader (magic "HYBCKPT", version, record size,
+// the cache geometry it was taken with, the record count, a checksum of the records and the sector size)
+// followed by one CheckpointRecord per cache page in cache page order, in host byte order. Because the
+// table is dense and fixed size, restoring is a single mmap and a linear copy, no parsing is needed.
+// Version 1 files (64 byte header, records without the sector bitmaps) are still restored, as whole pages.
+//
+// The older ASCII format ("PAGE_SIZE SET_SIZE CACHE_PAGES TOTAL_PAGES" followed by one
+// "cache_addr valid dirty tag data ts" line per valid page) is still accepted on restore.
+// tools/checkpoint_convert.py converts between the two formats.
+//
+// Full system checkpoints (HybridSystem::saveSystemState()) also capture everything that is in flight:
+// the controller queues, pending tables, prefetch/TLB/stream buffer state, the Logger counters and the
+// memory backends. They are written with StateWriter as a sequence of named sections so that a file from
+// a different build fails loudly at the first section that does not line up.
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <stdint.h>
+
+#include "config.h"
+#include "CacheTable.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	const char CHECKPOINT_MAGIC[8] = {'H', 'Y', 'B', 'C', 'K', 'P', 'T', '\0'};
+	const uint32_t CHECKPOINT_VERSION = 2;
+
+	// Flag bits in CheckpointRecord.flags.
+	const uint32_t CHECKPOINT_VALID = 0x1;
+	const uint32_t CHECKPOINT_DIRTY = 0x2;
+	const uint32_t CHECKPOINT_PREFETCHED = 0x4;
+	const uint32_t CHECKPOINT_USED = 0x8;
+
+	struct CheckpointHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t record_size;
+		uint64_t page_size;
+		uint64_t set_size;
+		uint64_t cache_pages;
+		uint64_t total_pages;
+		uint64_t num_records;
+		uint64_t checksum; // FNV-1a over the record data
+		uint64_t sector_size; // SECTOR_SIZE the sector bitmaps were taken with
+	};
+
+	struct CheckpointRecord
+	{
+		uint64_t tag;
+		uint64_t ts;
+		uint32_t flags;
+		uint32_t sector_valid;
+		uint32_t sector_dirty;
+		uint32_t reserved;
+	};
+
+	// Version 1 layout.
+	struct CheckpointHeaderV1
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t record_size;
+		uint64_t page_size;
+		uint64_t set_size;
+		uint64_t cache_pages;
+		uint64_t total_pages;
+		uint64_t num_records;
+		uint64_t checksum;
+	};
+
+	struct CheckpointRecordV1
+	{
+		uint64_t tag;
+		uint64_t ts;
+		uint32_t flags;
+		uint32_t reserved;
+	};
+
+	// Write the cache table to filename in the binary format.
+	void saveCheckpoint(string filename, CacheTable &cache);
+
+	// Fill the cache table from filename (binary or ASCII). The geometry in the file must match the
+	// current ini file. If clean is set, all restored pages are marked clean (see RESTORE_CLEAN).
+	void loadCheckpoint(string filename, CacheTable &cache, bool clean);
+
+	// Returns true if filename starts with the binary checkpoint magic.
+	bool isBinaryCheckpoint(string filename);
+
+
+	const char STATE_MAGIC[8] = {'H', 'Y', 'B', 'S', 'T', 'A', 'T', 'E'};
+	const uint32_t STATE_VERSION = 19;
+
+	// Binary stream used for full system checkpoints.
+	// Values are written in host byte order. Containers are written as a count followed by their elements.
+	class StateWriter
+	{
+		public:
+		void open(string filename);
+		void close();
+
+		// Write a section marker. StateReader::section() must be called with the same name on restore.
+		void section(string name);
+
+		void put(uint64_t v) { write(&v, sizeof(v)); }
+		void put(int64_t v) { write(&v, sizeof(v)); }
+		void put(uint32_t v) { write(&v, sizeof(v)); }
+		void put(double v) { write(&v, sizeof(v)); }
+		void put(bool v) { uint8_t b = v; write(&b, 1); }
+		void put(const string &v);
+		void put(const Transaction &t);
+		void put(const Pending &p);
+		void put(const cache_line &line);
+
+		template <class A, class B> void put(const pair<A, B> &v)
+		{
+			put(v.first);
+			put(v.second);
+		}
+
+		template <class T> void put(const list<T> &v)
+		{
+			put((uint64_t)v.size());
+			for (typename list<T>::const_iterator it = v.begin(); it != v.end(); it++)
+				put(*it);
+		}
+
+		template <class T> void put(const vector<T> &v)
+		{
+			put((uint64_t)v.size());
+			for (typename vector<T>::const_iterator it = v.begin(); it != v.end(); it++)
+				put(*it);
+		}
+
+		template <class T> void put(const set<T> &v)
+		{
+			put((uint64_t)v.size());
+			for (typename set<T>::const_iterator it = v.begin(); it != v.end(); it++)
+				put(*it);
+		}
+
+		// Unordered containers are written in whatever order they iterate in. Nothing in HybridSim may depend
+		// on that order (see StateReader::get()).
+		template <class T> void put(const unordered_set<T> &v)
+		{
+			put((uint64_t)v.size());
+			for (typename unordered_set<T>::const_iterator it = v.begin(); it != v.end(); it++)
+				put(*it);
+		}
+
+		template <class K, class V> void put(const unordered_map<K, V> &v)
+		{
+			put((uint64_t)v.size());
+			for (typename unordered_map<K, V>::const_iterator it = v.begin(); it != v.end(); it++)
+			{
+				put(it->first);
+				put(it->second);
+			}
+		}
+
+		private:
+		void write(const void *buf, uint64_t len);
+
+		ofstream outFile;
+		string filename;
+	};
+
+	class StateReader
+	{
+		public:
+		void open(string filename);
+		void close();
+
+		// Check that the next thing in the file is the section marker for name (aborts otherwise).
+		void section(string name);
+
+		void get(uint64_t &v) { read(&v, sizeof(v)); }
+		void get(int64_t &v) { read(&v, sizeof(v)); }
+		void get(uint32_t &v) { read(&v, sizeof(v)); }
+		void get(double &v) { read(&v, sizeof(v)); }
+		void get(bool &v) { uint8_t b; read(&b, 1); v = b; }
+		void get(string &v);
+		void get(Transaction &t);
+		void get(Pending &p);
+		void get(cache_line &line);
+
+		template <class A, class B> void get(pair<A, B> &v)
+		{
+			get(v.first);
+			get(v.second);
+		}
+
+		template <class T> void get(list<T> &v)
+		{
+			uint64_t n;
+			get(n);
+			v.clear();
+			for (uint64_t i=0; i < n; i++)
+			{
+				v.push_back(T());
+				get(v.back());
+			}
+		}
+
+		template <class T> void get(vector<T> &v)
+		{
+			uint64_t n;
+			get(n);
+			v.assign(n, T());
+			for (uint64_t i=0; i < n; i++)
+				get(v[i]);
+		}
+
+		template <class T> void get(set<T> &v)
+		{
+			uint64_t n;
+			get(n);
+			v.clear();
+			for (uint64_t i=0; i < n; i++)
+			{
+				T tmp;
+				get(tmp);
+				v.insert(v.end(), tmp);
+			}
+		}
+
+		// A restored unordered container iterates in a different order than the saved one, so searches over
+		// one must break ties on the key (e.g. the TLB victim) and output must be sorted (e.g. the Logger's
+		// pages_used) for restored runs to match uninterrupted ones.
+		template <class T> void get(unordered_set<T> &v)
+		{
+			uint64_t n;
+			get(n);
+			v.clear();
+			for (uint64_t i=0; i < n; i++)
+			{
+				T tmp;
+				get(tmp);
+				v.insert(tmp);
+			}
+		}
+
+		template <class K, class V> void get(unordered_map<K, V> &v)
+		{
+			uint64_t n;
+			get(n);
+			v.clear();
+			for (uint64_t i=0; i < n; i++)
+			{
+				pair<K, V> tmp;
+				get(tmp.first);
+				get(tmp.second);
+				v.insert(tmp);
+			}
+		}
+
+		private:
+		void read(void *buf, uint64_t len);
+
+		ifstream inFile;
+		string filename;
+	};
+}
+
+#endif
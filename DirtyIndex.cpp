@@ -0,0 +1,138 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "DirtyIndex.h"
+
+namespace HybridSim
+{
+	DirtyIndex::DirtyIndex()
+	{
+		num_sets = 0;
+		set_size = 0;
+		words_per_set = 0;
+		dirty_count = 0;
+	}
+
+	void DirtyIndex::init(uint64_t num_sets, uint64_t set_size)
+	{
+		this->num_sets = num_sets;
+		this->set_size = set_size;
+		words_per_set = (set_size + 63) / 64;
+		dirty_count = 0;
+		bits.assign(num_sets * words_per_set, 0);
+	}
+
+	void DirtyIndex::rebuild(CacheTable &cache)
+	{
+		init(num_sets, set_size);
+		for (uint64_t i=0; i < cache.size(); i++)
+		{
+			cache_line &line = cache.line(i);
+			if (line.valid && line.dirty)
+				set(i);
+		}
+	}
+
+	void DirtyIndex::set(uint64_t cache_page)
+	{
+		uint64_t way = cache_page / num_sets;
+		uint64_t &word = bits[(cache_page % num_sets) * words_per_set + way / 64];
+		uint64_t mask = 1ULL << (way % 64);
+		if ((word & mask) == 0)
+		{
+			word |= mask;
+			dirty_count++;
+		}
+	}
+
+	void DirtyIndex::clear(uint64_t cache_page)
+	{
+		uint64_t way = cache_page / num_sets;
+		uint64_t &word = bits[(cache_page % num_sets) * words_per_set + way / 64];
+		uint64_t mask = 1ULL << (way % 64);
+		if ((word & mask) != 0)
+		{
+			word &= ~mask;
+			dirty_count--;
+		}
+	}
+
+	bool DirtyIndex::test(uint64_t cache_page) const
+	{
+		uint64_t way = cache_page / num_sets;
+		return (bits[(cache_page % num_sets) * words_per_set + way / 64] & (1ULL << (way % 64))) != 0;
+	}
+
+	bool DirtyIndex::any(uint64_t set) const
+	{
+		for (uint64_t i=0; i < words_per_set; i++)
+		{
+			if (bits[set * words_per_set + i] != 0)
+				return true;
+		}
+		return false;
+	}
+
+	void DirtyIndex::pages(vector<uint64_t> &out) const
+	{
+		// Skip whole words at a time, so a mostly clean cache costs one test per 64 ways.
+		if (dirty_count == 0)
+			return;
+		for (uint64_t i=0; i < bits.size(); i++)
+		{
+			uint64_t word = bits[i];
+			while (word != 0)
+			{
+				uint64_t bit = __builtin_ctzll(word);
+				word &= word - 1;
+				uint64_t set = i / words_per_set;
+				uint64_t way = (i % words_per_set) * 64 + bit;
+				out.push_back(way * num_sets + set);
+			}
+		}
+	}
+
+	void DirtyIndex::checkpoint(StateWriter &w)
+	{
+		w.put(bits);
+		w.put(dirty_count);
+	}
+
+	void DirtyIndex::restore(StateReader &r)
+	{
+		r.get(bits);
+		r.get(dirty_count);
+		if (bits.size() != num_sets * words_per_set)
+		{
+			cerr << "ERROR: Dirty page index in state file does not match the cache geometry.\n";
+			abort();
+		}
+	}
+}
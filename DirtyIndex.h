@@ -0,0 +1,90 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_DIRTYINDEX_H
+#define HYBRIDSIM_DIRTYINDEX_H
+
+// Index of the dirty pages in the cache.
+//
+// Each set has a bitmap with one bit per way, plus there is a count of the dirty pages in the whole cache.
+// HybridSystem sets a page's bit when a write makes it dirty and clears it when the page is synced or
+// chosen as a victim (its write-back is then already under way), so syncAll() only has to visit the dirty
+// pages instead of scanning the whole cache table, and eager cleaning can skip clean sets a word at a time.
+//
+// Pages are identified by their cache page number (the cache address / PAGE_SIZE), which is
+// way * NUM_SETS + set.
+
+#include <vector>
+#include <stdint.h>
+
+#include "CacheTable.h"
+#include "Checkpoint.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	class DirtyIndex
+	{
+		public:
+		DirtyIndex();
+
+		// Clear the index for a cache with the given geometry.
+		void init(uint64_t num_sets, uint64_t set_size);
+
+		// Set the index from the dirty bits of the valid lines in the cache table.
+		void rebuild(CacheTable &cache);
+
+		void set(uint64_t cache_page);
+		void clear(uint64_t cache_page);
+		bool test(uint64_t cache_page) const;
+
+		// True if any page in the set is dirty.
+		bool any(uint64_t set) const;
+
+		// Number of dirty pages in the whole cache.
+		uint64_t count() const { return dirty_count; }
+
+		// Append the cache page numbers of all dirty pages, set by set.
+		void pages(vector<uint64_t> &out) const;
+
+		void checkpoint(StateWriter &w);
+		void restore(StateReader &r);
+
+		private:
+		uint64_t num_sets;
+		uint64_t set_size;
+		uint64_t words_per_set;
+		uint64_t dirty_count;
+		vector<uint64_t> bits;
+	};
+}
+
+#endif
@@ -34,6 +34,15 @@ using namespace std;
 
 namespace HybridSim {
 
+	// OPT key of invalid and flushed lines (they are evicted before any line that holds a page).
+	const uint64_t OPT_EVICT_FIRST = (uint64_t) 18446744073709551615U;
+
+	// An OPT heap is rebuilt from the set's lines when stale entries make it this many times the set size.
+	const uint64_t OPT_QUEUE_COMPACT = 4;
+
+	// Sets eager_clean() looks at per cycle. The next call carries on where it stopped.
+	const uint64_t EAGER_CLEAN_SCAN_SETS = 64;
+
 	HybridSystem::HybridSystem(uint id, string ini)
 	{
 		if (ini == "")
@@ -61,35 +70,75 @@ namespace HybridSim {
 		inipathPrefix.append("/");
 
 		iniReader.read(hybridsim_ini);
-		if (ENABLE_LOGGER)
+
+		// Register the controller counters with the logger so they appear in the JSON and CSV stats.
+		// This must happen before log.init() so the CSV header includes them.
+		log.register_counter("tlb_misses", &tlb_misses);
+		log.register_counter("tlb_hits", &tlb_hits);
+		log.register_counter("total_prefetches", &total_prefetches);
+		log.register_counter("unused_prefetches", &unused_prefetches);
+		log.register_counter("unused_prefetch_victims", &unused_prefetch_victims);
+		log.register_counter("prefetch_hit_nops", &prefetch_hit_nops);
+		log.register_counter("demand_misses", &demand_misses);
+		log.register_counter("stride_streams_allocated", &stride_prefetcher.streams_allocated);
+		log.register_counter("stride_confirmations", &stride_prefetcher.stride_confirmations);
+		log.register_counter("stride_mispredictions", &stride_prefetcher.stride_mispredictions);
+		log.register_counter("stride_feedback_increases", &stride_prefetcher.feedback_increases);
+		log.register_counter("stride_feedback_decreases", &stride_prefetcher.feedback_decreases);
+		log.register_counter("late_prefetches", &prefetch_throttle.late_prefetches);
+		log.register_counter("prefetch_pollution_misses", &prefetch_throttle.pollution_misses);
+		log.register_counter("prefetch_throttle_increases", &prefetch_throttle.level_increases);
+		log.register_counter("prefetch_throttle_decreases", &prefetch_throttle.level_decreases);
+		log.register_counter("unique_one_misses", &unique_one_misses);
+		log.register_counter("unique_stream_buffers", &unique_stream_buffers);
+		log.register_counter("stream_buffer_hits", &stream_buffer_hits);
+		log.register_counter("data_accesses", &data_accesses);
+		log.register_counter("nvm_bytes_read", &nvm_bytes_read);
+		log.register_counter("nvm_bytes_written", &nvm_bytes_written);
+		log.register_counter("sector_misses", &sector_misses);
+		log.register_counter("sync_alls", &sync_alls);
+		log.register_counter("sync_all_pages", &sync_all_pages);
+		log.register_counter("syncs_written", &syncs_written);
+		log.register_counter("syncs_clean", &syncs_clean);
+		log.register_counter("eager_cleans", &eager_cleans);
+		log.register_counter("fill_buffer_hits", &fill_buffer_hits);
+		log.register_counter("fill_writes_deferred", &fill_writes_deferred);
+		log.register_counter("merged_reads", &merged_reads);
+		log.register_counter("merged_writes", &merged_writes);
+		log.register_counter("rejected_accesses", &rejected_accesses);
+		log.register_counter("writeback_buffer_inserts", &writeback_buffer_inserts);
+		log.register_counter("writeback_buffer_idle_drains", &writeback_buffer_idle_drains);
+		log.register_counter("writeback_buffer_forced_drains", &writeback_buffer_forced_drains);
+		log.register_counter("writeback_buffer_hits", &writeback_buffer_hits);
+
+		if (Instrumentation::logging())
 			log.init();
 
+		if (Instrumentation::profiling())
+			profiler.init();
+
 		// Make sure that there are more cache pages than pages per set. 
 		assert(CACHE_PAGES >= SET_SIZE);
 
 		systemID = id;
-		cerr << "Creating DRAM with " << dram_ini << "\n";
 		uint64_t dram_size = (CACHE_PAGES * PAGE_SIZE) >> 20;
 		dram_size = (dram_size == 0) ? 1 : dram_size; // DRAMSim requires a minimum of 1 MB, even if HybridSim isn't going to use it.
 		dram_size = (OVERRIDE_DRAM_SIZE == 0) ? dram_size : OVERRIDE_DRAM_SIZE; // If OVERRIDE_DRAM_SIZE is non-zero, then use it.
-		dram = DRAMSim::getMemorySystemInstance(dram_ini, sys_ini, inipathPrefix, "resultsfilename", dram_size);
-
-		cerr << "Creating Flash with " << flash_ini << "\n";
-		flash = NVDSim::getNVDIMMInstance(1,flash_ini,"ini/def_system.ini",inipathPrefix,"");
+		dram = createDRAMBackend(inipathPrefix, dram_size);
+		flash = createFlashBackend(inipathPrefix);
 		cerr << "Done with creating memories" << endl;
 
 		// Set up the callbacks for DRAM.
-		typedef DRAMSim::Callback <HybridSystem, void, uint, uint64_t, uint64_t> dramsim_callback_t;
-		DRAMSim::TransactionCompleteCB *read_cb = new dramsim_callback_t(this, &HybridSystem::DRAMReadCallback);
-		DRAMSim::TransactionCompleteCB *write_cb = new dramsim_callback_t(this, &HybridSystem::DRAMWriteCallback);
-		dram->RegisterCallbacks(read_cb, write_cb, NULL);
+		typedef Callback <HybridSystem, void, uint, uint64_t, uint64_t> backend_callback_t;
+		BackendCallback *read_cb = new backend_callback_t(this, &HybridSystem::DRAMReadCallback);
+		BackendCallback *write_cb = new backend_callback_t(this, &HybridSystem::DRAMWriteCallback);
+		dram->RegisterCallbacks(read_cb, NULL, write_cb);
 
 		// Set up the callbacks for NVDIMM.
-		typedef NVDSim::Callback <HybridSystem, void, uint, uint64_t, uint64_t, bool> nvdsim_callback_t;
-		NVDSim::Callback_t *nv_read_cb = new nvdsim_callback_t(this, &HybridSystem::FlashReadCallback);
-		NVDSim::Callback_t *nv_write_cb = new nvdsim_callback_t(this, &HybridSystem::FlashWriteCallback);
-		NVDSim::Callback_t *nv_crit_cb = new nvdsim_callback_t(this, &HybridSystem::FlashCriticalLineCallback);
-		flash->RegisterCallbacks(nv_read_cb, nv_crit_cb, nv_write_cb, NULL);
+		BackendCallback *nv_read_cb = new backend_callback_t(this, &HybridSystem::FlashReadCallback);
+		BackendCallback *nv_write_cb = new backend_callback_t(this, &HybridSystem::FlashWriteCallback);
+		BackendCallback *nv_crit_cb = new backend_callback_t(this, &HybridSystem::FlashCriticalLineCallback);
+		flash->RegisterCallbacks(nv_read_cb, nv_crit_cb, nv_write_cb);
 
 		// Need to check the queue when we start.
 		check_queue = true;
@@ -100,82 +149,33 @@ namespace HybridSim {
 		// No active transaction to start with.
 		active_transaction_flag = false;
 
+		// Allocate the cache table. With PREFILL_CACHE, the first CACHE_PAGES of the NVDIMM start out mapped
+		// (unless a checkpoint is about to be restored), otherwise all pages start out invalid.
+		cache.init(CACHE_PAGES, PAGE_SIZE, PREFILL_CACHE && !ENABLE_RESTORE, PREFILL_CACHE_DIRTY, NUM_SETS);
+
 		// Call the restore cache state function.
 		// If ENABLE_RESTORE is set, then this will fill the cache table.
 		restoreCacheTable();
 
-		// Load prefetch data.
-		if (ENABLE_PERFECT_PREFETCHING)
-		{
-			// MOVE THIS TO A FUNCTION.
-
-			// Open prefetch file.
-			ifstream prefetch_file;
-			prefetch_file.open(PREFETCH_FILE, ifstream::in);
-			if (!prefetch_file.is_open())
-			{
-				cerr << "ERROR: Failed to load prefetch file: " << PREFETCH_FILE << "\n";
-				abort();
-			}
-
-			// Declare variables for parsing string and uint64_t.
-			string parse_string;
-			uint64_t num_sets, cur_set, set_size, set_counter, tmp_num;
-
-			// Parse prefetch data.
-			prefetch_file >> parse_string;
-			if (parse_string != "NUM_SETS")
-			{
-				cerr << "ERROR: Invalid prefetch file format. NUM_SETS does not appear at beginning.\n";
-				abort();
-			}
-			
-			prefetch_file >> num_sets;
-
-			for (cur_set = 0; cur_set < num_sets; cur_set++)
-			{
-				prefetch_file >> parse_string;
-				if (parse_string != "SET")
-				{
-					cerr << "ERROR: Invalid prefetch file format. SET does not appear at beginning of set " << cur_set << ".\n";
-					abort();
-				}
-
-				prefetch_file >> tmp_num;
-				if (tmp_num != cur_set)
-				{
-					cerr << "ERROR: Invalid prefetch file format. Sets not given in order. (" << cur_set << ")\n";
-					abort();
-				}
-				
-				// Read the size fo this set.
-				prefetch_file >> set_size;
-
-				// Create a new entry in the maps.
-				prefetch_access_number[cur_set] = list<uint64_t>();
-				prefetch_flush_addr[cur_set] = list<uint64_t>();
-				prefetch_new_addr[cur_set] = list<uint64_t>();
-				prefetch_counter[cur_set] = 0;
-
-				// Process each prefetch.
-				for (set_counter = 0; set_counter < set_size; set_counter++)
-				{
-					// Read and store the access counter.
-					prefetch_file >> tmp_num;
-					prefetch_access_number[cur_set].push_back(tmp_num);
+		// Index the pages that start out dirty.
+		dirty_index.init(NUM_SETS, SET_SIZE);
+		dirty_index.rebuild(cache);
 
-					// Read and store the flush address.
-					prefetch_file >> tmp_num;
-					prefetch_flush_addr[cur_set].push_back(tmp_num);
-
-					// Read and store the new address.
-					prefetch_file >> tmp_num;
-					prefetch_new_addr[cur_set].push_back(tmp_num);
-				}
-			}
+		// Map the prefetch schedule.
+		if (ENABLE_PERFECT_PREFETCHING)
+			prefetch_schedule.load(PREFETCH_FILE, NUM_SETS);
 
-			prefetch_file.close();
+		// Set up the replacement policy. OPT also needs the oracle trace, which the trace-based simulator
+		// passes with loadOracle() if ORACLE_TRACE_FILE is not set.
+		if ((REPLACEMENT_POLICY != "LRU") && (REPLACEMENT_POLICY != "OPT"))
+		{
+			cerr << "ERROR: Invalid REPLACEMENT_POLICY " << REPLACEMENT_POLICY << " (must be LRU or OPT).\n";
+			abort();
 		}
+		opt_replacement = (REPLACEMENT_POLICY == "OPT");
+		oracle_loaded = false;
+		if (opt_replacement && (ORACLE_TRACE_FILE != "none"))
+			loadOracle(ORACLE_TRACE_FILE);
 
 		// Initialize size/max counters.
 		// Note: Some of this is just debug info, but I'm keeping it around because it is useful.
@@ -185,6 +185,10 @@ namespace HybridSim {
 		trans_queue_max = 0;
 		trans_queue_size = 0; // This is not debugging info.
 
+		accepted_accesses = 0;
+		accepted_accesses_max = 0;
+		rejected_accesses = 0;
+
 		tlb_misses = 0;
 		tlb_hits = 0;
 
@@ -192,11 +196,53 @@ namespace HybridSim {
 		unused_prefetches = 0;
 		unused_prefetch_victims = 0;
 		prefetch_hit_nops = 0;
+		demand_misses = 0;
 
+		one_miss_table.init(ONE_MISS_TABLE_SIZE);
+		stream_buffers.init(NUM_STREAM_BUFFERS);
 		unique_one_misses = 0;
 		unique_stream_buffers = 0;
 		stream_buffer_hits = 0;
 
+		data_accesses = 0;
+		nvm_bytes_read = 0;
+		nvm_bytes_written = 0;
+		sector_misses = 0;
+		check_sector_config();
+
+		sync_alls = 0;
+		sync_all_pages = 0;
+		syncs_written = 0;
+		syncs_clean = 0;
+		dirty_pages_max = dirty_index.count();
+
+		eager_clean_set = 0;
+		eager_clean_active = false;
+		eager_clean_addr = 0;
+		eager_cleans = 0;
+		set_eager_cleaning();
+
+		fill_buffer_hits = 0;
+		fill_writes_deferred = 0;
+
+		merged_reads = 0;
+		merged_writes = 0;
+
+		writeback_buffer_inserts = 0;
+		writeback_buffer_idle_drains = 0;
+		writeback_buffer_forced_drains = 0;
+		writeback_buffer_hits = 0;
+		writeback_buffer_max = 0;
+		set_writeback_buffer_size();
+
+		if (ENABLE_STRIDE_PREFETCHER)
+			stride_prefetcher.init();
+
+		if (ENABLE_PREFETCH_THROTTLE)
+			prefetch_throttle.init();
+
+		set_backend_queue_policy();
+
 		// Create file descriptors for debugging output (if needed).
 		if (DEBUG_VICTIM) 
 		{
@@ -208,25 +254,12 @@ namespace HybridSim {
 			}
 		}
 
+		// The trace outputs are buffered binary traces (see TraceFile.h). TraceWriter aborts if the file fails to open.
 		if (DEBUG_NVDIMM_TRACE) 
-		{
-			debug_nvdimm_trace.open("nvdimm_trace.log", ios_base::out | ios_base::trunc);
-			if (!debug_nvdimm_trace.is_open())
-			{
-				cerr << "ERROR: HybridSim debug_nvdimm_trace file failed to open.\n";
-				abort();
-			}
-		}
+			debug_nvdimm_trace.open("nvdimm_trace.bin");
 
 		if (DEBUG_FULL_TRACE) 
-		{
-			debug_full_trace.open("full_trace.log", ios_base::out | ios_base::trunc);
-			if (!debug_full_trace.is_open())
-			{
-				cerr << "ERROR: HybridSim debug_full_trace file failed to open.\n";
-				abort();
-			}
-		}
+			debug_full_trace.open("full_trace.bin");
 	}
 
 	HybridSystem::~HybridSystem()
@@ -250,6 +283,9 @@ namespace HybridSim {
 
 	void HybridSystem::update()
 	{
+		// Host time in update() that is not part of a more specific phase is charged to PROFILE_UPDATE_OTHER.
+		ProfileScope update_scope(profiler, PROFILE_UPDATE_OTHER);
+
 		// Process the transaction queue.
 		// This will fill the dram_queue and flash_queue.
 
@@ -260,19 +296,69 @@ namespace HybridSim {
 		if (trans_queue_size > trans_queue_max)
 			trans_queue_max = trans_queue_size;
 
+		if (ENABLE_PREFETCH_THROTTLE)
+			prefetch_throttle.update(currentClockCycle);
+
 		// Log the queue length.
 		bool idle = (trans_queue.empty()) && (pending_pages.empty());
 		bool flash_idle = (flash_queue.empty()) && (flash_pending.empty());
 		bool dram_idle = (dram_queue.empty()) && (dram_pending.empty());
-		if (ENABLE_LOGGER)
+		if (Instrumentation::logging())
 			log.access_update(trans_queue_size, idle, flash_idle, dram_idle);
 
+		// Lines that misses read back out of the write-back buffer arrive like lines from the NVM.
+		while (!buffer_reads.empty() && (buffer_reads.front().first <= currentClockCycle))
+		{
+			uint64_t line_addr = buffer_reads.front().second;
+			buffer_reads.pop_front();
+			FlashReadCallback(0, line_addr, currentClockCycle);
+		}
+
+		// Reads of lines in the fill buffer.
+		while (!fill_buffer_reads.empty() && (fill_buffer_reads.front().first <= currentClockCycle))
+		{
+			uint64_t data_addr = fill_buffer_reads.front().second;
+			fill_buffer_reads.pop_front();
+			Pending p = dram_pending[data_addr];
+			dram_pending.erase(data_addr);
+			CacheReadFinish(data_addr, p);
+		}
+
+		// Write out a buffered victim whenever the NVM has nothing else to do, or regardless once the
+		// buffer reaches its high watermark.
+		bool flash_idle_used = false;
+		if (writeback_buffer.size() > 0)
+		{
+			if (flash_idle)
+			{
+				writeback_buffer_drain();
+				writeback_buffer_idle_drains++;
+				flash_idle_used = true;
+			}
+			else if (writeback_buffer.size() >= WRITEBACK_BUFFER_HIGH_WATERMARK)
+			{
+				writeback_buffer_drain();
+				writeback_buffer_forced_drains++;
+			}
+		}
+
+		// Use idle NVM time to write back dirty pages while too much of the cache is dirty, one page at a time.
+		// Buffered victims go first, and only one of them starts per idle cycle.
+		if (flash_idle && !flash_idle_used && !eager_clean_active && (dirty_index.count() > eager_clean_limit))
+			eager_clean();
+
 
 		// See if there are any transactions ready to be processed.
 		if ((active_transaction_flag) && (delay_counter == 0))
 		{
+				if (update_scope.active())
+					profiler.next(PROFILE_TAG_LOOKUP);
+
 				ProcessTransaction(active_transaction);
 				active_transaction_flag = false;
+
+				if (update_scope.active())
+					profiler.next(PROFILE_UPDATE_OTHER);
 		}
 		
 
@@ -281,6 +367,14 @@ namespace HybridSim {
 		bool sent_transaction = false;
 
 
+		// Only time the scan if there is something to scan (the timestamp reads are not free).
+		bool profile_scan = update_scope.active() && check_queue && !trans_queue.empty();
+		if (profile_scan)
+			profiler.next(PROFILE_QUEUE_SCAN);
+
+		if (!merge_blocked_pages.empty())
+			merge_blocked_pages.clear();
+
 		list<Transaction>::iterator it = trans_queue.begin();
 		while((it != trans_queue.end()) && (pending_pages.size() < NUM_SETS) && (check_queue) && (delay_counter == 0))
 		{
@@ -296,7 +390,7 @@ namespace HybridSim {
 				contention_lock(flash_addr);
 
 				// Log the page access.
-				if (ENABLE_LOGGER)
+				if (Instrumentation::logging())
 					log.access_page(page_addr);
 
 				// Set this transaction as active and start the delay counter, which
@@ -318,10 +412,20 @@ namespace HybridSim {
 
 				break;
 			}
+			else if ((MSHR_TARGETS > 0) && (merge_blocked_pages.count(page_addr) == 0) && merge_secondary_miss(*it))
+			{
+				// The access now waits on the page's fill instead (see merge_secondary_miss).
+				it = trans_queue.erase(it);
+				trans_queue_size--;
+			}
 			else
 			{
+				// Later accesses to the page must not overtake this one by merging.
+				if (MSHR_TARGETS > 0)
+					merge_blocked_pages.insert(page_addr);
+
 				// Log the set conflict.
-				if (ENABLE_LOGGER)
+				if (Instrumentation::logging())
 					log.access_set_conflict(SET_INDEX(page_addr));
 
 				// Skip to the next and do nothing else.
@@ -329,6 +433,9 @@ namespace HybridSim {
 			}
 		}
 
+		if (profile_scan)
+			profiler.next(PROFILE_UPDATE_OTHER);
+
 		// If there is nothing to do, wait until a new transaction arrives or a pending set is released.
 		// Only set check_queue to false if the delay counter is 0. Otherwise, a transaction that arrives
 		// while delay_counter is running might get missed and stuck in the queue.
@@ -338,12 +445,17 @@ namespace HybridSim {
 		}
 
 
+		bool profile_issue = update_scope.active() && (!dram_queue.empty() || !flash_queue.empty());
+		if (profile_issue)
+			profiler.next(PROFILE_BACKEND_ISSUE);
+
 		// Process DRAM transaction queue until it is empty or addTransaction returns false.
 		// Note: This used to be a while, but was changed ot an if to only allow one
 		// transaction to be sent to the DRAM per cycle.
 		bool not_full = true;
 		if (not_full && !dram_queue.empty())
 		{
+			dram_queue.select(currentClockCycle);
 			Transaction tmp = dram_queue.front();
 			bool isWrite;
 			if (tmp.transactionType == DATA_WRITE)
@@ -353,8 +465,12 @@ namespace HybridSim {
 			not_full = dram->addTransaction(isWrite, tmp.address);
 			if (not_full)
 			{
-				dram_queue.pop_front();
+				QueueClass queue_class;
+				uint64_t waited = dram_queue.pop(currentClockCycle, queue_class);
 				dram_pending_set.insert(tmp.address);
+
+				if (Instrumentation::logging())
+					log.backend_queue_delay(false, queue_class, waited);
 			}
 		}
 
@@ -366,6 +482,7 @@ namespace HybridSim {
 		{
 			bool isWrite;
 
+			flash_queue.select(currentClockCycle);
 			Transaction tmp = flash_queue.front();
 			if (tmp.transactionType == DATA_WRITE)
 				isWrite = true;
@@ -375,16 +492,20 @@ namespace HybridSim {
 
 			if (not_full)
 			{
-				flash_queue.pop_front();
+				QueueClass queue_class;
+				uint64_t waited = flash_queue.pop(currentClockCycle, queue_class);
+
+				if (Instrumentation::logging())
+					log.backend_queue_delay(true, queue_class, waited);
 
 				if (DEBUG_NVDIMM_TRACE)
-				{
-					debug_nvdimm_trace << currentClockCycle << " " << (isWrite ? 1 : 0) << " " << tmp.address << "\n";
-					debug_nvdimm_trace.flush();
-				}
+					debug_nvdimm_trace.write(currentClockCycle, isWrite, tmp.address);
 			}
 		}
 
+		if (profile_issue)
+			profiler.next(PROFILE_UPDATE_OTHER);
+
 		// Decrement the delay counter.
 		if (delay_counter > 0)
 		{
@@ -393,13 +514,26 @@ namespace HybridSim {
 
 
 		// Update the logger.
-		if (ENABLE_LOGGER)
+		if (Instrumentation::logging())
+		{
+			if (update_scope.active())
+				profiler.next(PROFILE_LOGGER);
+
 			log.update();
+		}
 
 		// Update the memories.
+		if (update_scope.active())
+			profiler.next(PROFILE_DRAM_UPDATE);
 		dram->update();
+
+		if (update_scope.active())
+			profiler.next(PROFILE_FLASH_UPDATE);
 		flash->update();
 
+		if (Instrumentation::profiling())
+			profiler.update();
+
 		// Increment the cycle count.
 		step();
 	}
@@ -424,6 +558,21 @@ namespace HybridSim {
 
 	bool HybridSystem::addTransaction(Transaction &trans)
 	{
+		ProfileScope add_scope(profiler, PROFILE_ADD_TRANSACTION);
+		if (Instrumentation::profiling())
+			profiler.access();
+
+		// Turn the access away while the input queue is full. The caller keeps it and tries again
+		// after a later update() (see WillAcceptTransaction()).
+		if (!WillAcceptTransaction())
+		{
+			rejected_accesses++;
+			return false;
+		}
+
+		// Record the access before the MMIO remapping so the captured trace can be replayed directly.
+		if (DEBUG_FULL_TRACE)
+			debug_full_trace.write(currentClockCycle, (trans.transactionType == DATA_WRITE), trans.address);
 
 		if (REMAP_MMIO)
 		{
@@ -444,7 +593,8 @@ namespace HybridSim {
 				else
 					assert(0);
 
-				log.mmio_dropped();
+				if (Instrumentation::logging())
+					log.mmio_dropped();
 
 				return true;
 			}
@@ -453,12 +603,25 @@ namespace HybridSim {
 				// Subtract 0.5 GB from the address to adjust for MMIO.
 				trans.address -= HALFGB;
 
-				log.mmio_remapped();
+				if (Instrumentation::logging())
+					log.mmio_remapped();
 			}
 		}
 
 		pending_count += 1;
 
+		// Held until the access's ReadDone/WriteDone callback (MMIO accesses above complete right away).
+		accepted_accesses++;
+		if (accepted_accesses > accepted_accesses_max)
+			accepted_accesses_max = accepted_accesses;
+
+		if (ENABLE_PREFETCH_THROTTLE && ((trans.transactionType == DATA_READ) || (trans.transactionType == DATA_WRITE)))
+		{
+			prefetch_throttle.demand_access(PAGE_ADDRESS(trans.address));
+			if (ENABLE_STRIDE_PREFETCHER)
+				stride_prefetcher.demand_arrival(PAGE_ADDRESS(trans.address));
+		}
+
 		trans_queue.push_back(trans);
 		trans_queue_size++;
 
@@ -469,19 +632,13 @@ namespace HybridSim {
 		}
 
 		// Start the logging for this access.
-		if (ENABLE_LOGGER)
+		if (Instrumentation::logging())
 			log.access_start(trans.address);
 
-		if (DEBUG_FULL_TRACE)
-		{
-			debug_full_trace << currentClockCycle << " " << ((trans.transactionType == DATA_WRITE) ? 1 : 0) << " " << trans.address << "\n";
-			debug_full_trace.flush();
-		}
-
 		// Restart queue checking.
 		this->check_queue = true;
 
-		return true; // TODO: Figure out when this could be false.
+		return true;
 	}
 
 	void HybridSystem::addPrefetch(uint64_t prefetch_addr)
@@ -489,6 +646,9 @@ namespace HybridSim {
 		// Create prefetch transaction.
 		Transaction prefetch_transaction = Transaction(PREFETCH, prefetch_addr, NULL);
 
+		if (ENABLE_PREFETCH_THROTTLE)
+			prefetch_throttle.prefetch_issued(PAGE_ADDRESS(prefetch_addr));
+
 		// Push the operation onto the front of the transaction queue (so it executes immediately).
 		trans_queue.push_front(prefetch_transaction);
 		trans_queue_size += 1;
@@ -516,9 +676,9 @@ namespace HybridSim {
 
 	bool HybridSystem::WillAcceptTransaction()
 	{
-		// Always true for now since MARSS expects this.
-		// Might change later.
-		return true;
+		// Accesses stay in the input queue from addTransaction() until their callback, so this bounds
+		// everything the controller is working on for the caller (prefetches, syncs and flushes are not counted).
+		return (INPUT_QUEUE_DEPTH == 0) || (accepted_accesses < INPUT_QUEUE_DEPTH);
 	}
 
 	void HybridSystem::ProcessTransaction(Transaction &trans)
@@ -589,38 +749,7 @@ namespace HybridSim {
 
 		}
 
-		// Place access_process here and combine it with access_cache.
-		// Tell the logger when the access is processed (used for timing the time in queue).
-		// Only do this for DATA_READ and DATA_WRITE.
-		if ((ENABLE_LOGGER) && ((trans.transactionType == DATA_READ) || (trans.transactionType == DATA_WRITE)))
-			log.access_process(trans.address, trans.transactionType == DATA_READ, hit);
-
-		// Handle prefetching operations.
-		if (ENABLE_PERFECT_PREFETCHING && ((trans.transactionType == DATA_READ) || (trans.transactionType == DATA_WRITE)))
-		{
-			// Increment prefetch counter for this set.
-			prefetch_counter[set_index]++;
-
-			// If there are any prefetches left in this set prefetch list.
-			if (!prefetch_access_number[set_index].empty())
-			{
-				// If the counter exceeds the front of the access list, 
-				// then issue a prefetch and pop the front of the prefetch lists for this set.
-				// This must be a > because the prefetch must only happen AFTER the access.
-				if (prefetch_counter[set_index] > prefetch_access_number[set_index].front())
-				{
-
-					// Add prefetch, then add flush (this makes flush run first).
-					addPrefetch(prefetch_new_addr[set_index].front());
-					addFlush(prefetch_flush_addr[set_index].front());
-
-					// Go to the next prefetch in this set.
-					prefetch_access_number[set_index].pop_front();
-					prefetch_flush_addr[set_index].pop_front();
-					prefetch_new_addr[set_index].pop_front();
-				}
-			}
-		}
+		note_data_access(trans, set_index, hit);
 
 
 		if (hit)
@@ -628,6 +757,9 @@ namespace HybridSim {
 			// Lock the line that was hit (so it cannot be selected as a victim while being processed).
 			contention_cache_line_lock(cache_address);
 
+			if (opt_replacement && ((trans.transactionType == DATA_READ) || (trans.transactionType == DATA_WRITE)))
+				opt_update(cache_address, oracle_access(PAGE_ADDRESS(addr)));
+
 			if ((ENABLE_STREAM_BUFFER) && 
 					((trans.transactionType == DATA_READ) || (trans.transactionType == DATA_WRITE)))
 			{
@@ -635,7 +767,24 @@ namespace HybridSim {
 			}
 
 			// Issue operation to the DRAM.
-			if (trans.transactionType == DATA_READ)
+			// In sectored mode, an access to a sector that isn't in the DRAM yet reads it from the NVM instead.
+			if (((trans.transactionType == DATA_READ) || (trans.transactionType == DATA_WRITE)) &&
+					((cur_line.sector_valid & SECTOR_BIT(addr)) == 0))
+			{
+				sector_misses++;
+
+				Pending p;
+				p.orig_addr = trans.address;
+				p.flash_addr = addr;
+				p.cache_addr = cache_address;
+				p.victim_tag = 0;
+				p.victim_valid = false;
+				p.callback_sent = false;
+				p.type = trans.transactionType;
+				p.sectors = SECTOR_BIT(addr);
+				SectorRead(p);
+			}
+			else if (trans.transactionType == DATA_READ)
 				CacheRead(trans.address, addr, cache_address);
 			else if(trans.transactionType == DATA_WRITE)
 				CacheWrite(trans.address, addr, cache_address);
@@ -650,6 +799,12 @@ namespace HybridSim {
 				contention_unlock(flash_address, flash_address, "PREFETCH (hit)", false, 0, true, cache_address);
 
 				prefetch_hit_nops++;
+				if (ENABLE_PREFETCH_THROTTLE)
+				{
+					prefetch_throttle.prefetch_dropped(PAGE_ADDRESS(addr));
+					if (ENABLE_STRIDE_PREFETCHER)
+						stride_prefetcher.prefetch_dropped(PAGE_ADDRESS(addr));
+				}
 
 				return; 
 			}
@@ -681,7 +836,31 @@ namespace HybridSim {
 				return;
 			}
 
-			assert(trans.transactionType != SYNC);
+			// A SYNC can also miss if its page was evicted after it was queued. The eviction wrote the page
+			// back, unless it is still waiting in the write-back buffer.
+			if (trans.transactionType == SYNC)
+			{
+				uint64_t flash_address = addr;
+				if (writeback_buffer.contains(PAGE_ADDRESS(addr)))
+				{
+					uint32_t buffered_sectors = *writeback_buffer.find(PAGE_ADDRESS(addr));
+					writeback_buffer.erase(PAGE_ADDRESS(addr));
+					VictimWriteIssue(PAGE_ADDRESS(addr), buffered_sectors);
+					writeback_buffer_forced_drains++;
+					syncs_written++;
+				}
+				else
+					syncs_clean++;
+				contention_unlock(flash_address, flash_address, "SYNC (miss)", false, 0, false, 0);
+				return;
+			}
+
+			if (trans.transactionType != PREFETCH)
+			{
+				demand_misses++;
+				if (ENABLE_PREFETCH_THROTTLE)
+					prefetch_throttle.demand_miss(PAGE_ADDRESS(addr));
+			}
 
 			if ((SEQUENTIAL_PREFETCHING_WINDOW > 0) && (trans.transactionType != PREFETCH))
 			{
@@ -693,7 +872,7 @@ namespace HybridSim {
 				stream_buffer_miss_handler(PAGE_ADDRESS(addr));
 			}
 
-			// Select a victim offset within the set (LRU)
+			// Select a victim offset within the set (LRU or OPT)
 			uint64_t victim = *(set_address_list.begin());
 			uint64_t min_ts = (uint64_t) 18446744073709551615U; // Max uint64_t
 			bool min_init = false;
@@ -710,38 +889,50 @@ namespace HybridSim {
 
 			uint64_t victim_counter = 0;
 			uint64_t victim_set_offset = 0;
-			for (list<uint64_t>::iterator it=set_address_list.begin(); it != set_address_list.end(); it++)
+			if (opt_replacement)
 			{
-				cur_address = *it;
-				cur_line = cache[cur_address];
-
-				if (DEBUG_VICTIM)
-				{
-					debug_victim << "cur_address= 0x" << hex << cur_address << dec << "\n";
-					debug_victim << "cur_tag= " << cur_line.tag << "\n";
-					debug_victim << "dirty= " << cur_line.dirty << "\n";
-					debug_victim << "valid= " << cur_line.valid << "\n";
-					debug_victim << "ts= " << cur_line.ts << "\n";
-					debug_victim << "min_ts= " << min_ts << "\n\n";
-				}
-
-				// If the current line is the least recent we've seen so far, then select it.
-				// But do not select it if the line is locked.
-				if (((cur_line.ts < min_ts) || (!min_init)) && (!cur_line.locked))
+				// Belady's OPT: evict the unlocked line whose page is used again farthest in the future.
+				victim = opt_victim(set_index);
+				victim_set_offset = (victim / PAGE_SIZE) / NUM_SETS;
+			}
+			else
+			{
+				for (list<uint64_t>::iterator it=set_address_list.begin(); it != set_address_list.end(); it++)
 				{
-					victim = cur_address;	
-					min_ts = cur_line.ts;
-					min_init = true;
+					cur_address = *it;
+					cur_line = cache[cur_address];
 
-					victim_set_offset = victim_counter;
 					if (DEBUG_VICTIM)
 					{
-						debug_victim << "FOUND NEW MINIMUM!\n\n";
+						debug_victim << "cur_address= 0x" << hex << cur_address << dec << "\n";
+						debug_victim << "cur_tag= " << cur_line.tag << "\n";
+						debug_victim << "dirty= " << cur_line.dirty << "\n";
+						debug_victim << "valid= " << cur_line.valid << "\n";
+						debug_victim << "ts= " << cur_line.ts << "\n";
+						debug_victim << "min_ts= " << min_ts << "\n\n";
 					}
-				}
 
-				victim_counter++;
+					// If the current line is the least recent we've seen so far, then select it.
+					// But do not select it if the line is locked.
+					if (((cur_line.ts < min_ts) || (!min_init)) && (!cur_line.locked))
+					{
+						victim = cur_address;	
+						min_ts = cur_line.ts;
+						min_init = true;
+
+						victim_set_offset = victim_counter;
+						if (DEBUG_VICTIM)
+						{
+							debug_victim << "FOUND NEW MINIMUM!\n\n";
+						}
+					}
+
+					victim_counter++;
 				
+				}
+
+				// contention_is_unlocked() only lets a miss in while the set has an unlocked line.
+				assert(min_init);
 			}
 
 			if (DEBUG_VICTIM)
@@ -756,7 +947,7 @@ namespace HybridSim {
 			// Log the victim, set, etc.
 			// THIS MUST HAPPEN AFTER THE CUR_LINE IS SET TO THE VICTIM LINE.
 			uint64_t victim_flash_addr = FLASH_ADDRESS(cur_line.tag, set_index);
-			if ((ENABLE_LOGGER) && ((trans.transactionType == DATA_READ) || (trans.transactionType == DATA_WRITE)))
+			if ((Instrumentation::logging()) && ((trans.transactionType == DATA_READ) || (trans.transactionType == DATA_WRITE)))
 				log.access_miss(PAGE_ADDRESS(addr), victim_flash_addr, set_index, victim, cur_line.dirty, cur_line.valid);
 
 
@@ -769,6 +960,11 @@ namespace HybridSim {
 			// Lock the cache line so no one else tries to use it while this miss is being serviced.
 			contention_cache_line_lock(cache_address);
 
+			// The line is keyed by the missed page from now on (it stays locked until the page arrives).
+			// Prefetches are not accesses, so they only look up the page's next use.
+			if (opt_replacement)
+				opt_update(cache_address, (trans.transactionType == PREFETCH) ? oracle_peek(PAGE_ADDRESS(addr)) : oracle_access(PAGE_ADDRESS(addr)));
+
 
 			if (DEBUG_CACHE)
 			{
@@ -784,8 +980,13 @@ namespace HybridSim {
 				// to the unused_prefetch_victims counter.
 				unused_prefetches--;
 				unused_prefetch_victims++;
+				if (ENABLE_PREFETCH_THROTTLE && ENABLE_STRIDE_PREFETCHER)
+					stride_prefetcher.prefetch_evicted_unused(victim_flash_addr);
 			}
 
+			if (ENABLE_PREFETCH_THROTTLE && (trans.transactionType == PREFETCH) && cur_line.valid)
+				prefetch_throttle.prefetch_evicted(victim_flash_addr);
+
 			Pending p;
 			p.orig_addr = trans.address;
 			p.flash_addr = addr;
@@ -795,18 +996,157 @@ namespace HybridSim {
 			p.callback_sent = false;
 			p.type = trans.transactionType;
 
+			// Only the accessed sector is read (all of them for a prefetch), and only the dirty sectors of the
+			// victim are written back. Unsectored pages are a single sector.
+			p.sectors = (trans.transactionType == PREFETCH) ? ALL_SECTORS : SECTOR_BIT(addr);
+			p.victim_sectors = cur_line.sector_dirty;
+
+			// If the page that missed is still waiting in the write-back buffer, the NVM doesn't have its dirty
+			// sectors yet. Those are read back out of the buffer instead (and stay dirty in the cache).
+			uint32_t buffered_sectors = 0;
+			if (writeback_buffer.contains(PAGE_ADDRESS(addr)))
+			{
+				buffered_sectors = *writeback_buffer.find(PAGE_ADDRESS(addr));
+				writeback_buffer.erase(PAGE_ADDRESS(addr));
+				p.sectors |= buffered_sectors;
+				writeback_buffer_hits++;
+			}
+
 			// Read the line that missed from the NVRAM.
 			// This is started immediately to minimize the latency of the waiting user of HybridSim.
-			LineRead(p);
+			LineRead(p, buffered_sectors);
 
 			// If the cur_line is dirty, then do a victim writeback process (starting with VictimRead).
+			// The victim is no longer counted as dirty once its write-back has started.
 			if (cur_line.dirty)
 			{
+				dirty_index.clear(cache_address / PAGE_SIZE);
 				VictimRead(p);
 			}
 		}
 	}
 
+	void HybridSystem::note_data_access(Transaction &trans, uint64_t set_index, bool hit)
+	{
+		// Only do this for DATA_READ and DATA_WRITE.
+		if ((trans.transactionType != DATA_READ) && (trans.transactionType != DATA_WRITE))
+			return;
+
+		// Place access_process here and combine it with access_cache.
+		// Tell the logger when the access is processed (used for timing the time in queue).
+		if (Instrumentation::logging())
+			log.access_process(trans.address, trans.transactionType == DATA_READ, hit);
+		data_accesses++;
+
+		// Handle prefetching operations.
+		if (ENABLE_PERFECT_PREFETCHING)
+		{
+			// Count the access to this set. If that makes the next prefetch in this set due, issue it.
+			// The schedule only fires AFTER the access that completes its count.
+			const PrefetchEntry *prefetch = prefetch_schedule.access(set_index);
+			if (prefetch != NULL)
+			{
+				// Add prefetch, then add flush (this makes flush run first).
+				addPrefetch(prefetch->new_addr);
+				addFlush(prefetch->flush_addr);
+			}
+		}
+
+		if (ENABLE_STRIDE_PREFETCHER)
+		{
+			issue_stride_prefetches(PAGE_ADDRESS(ALIGN(trans.address)));
+		}
+	}
+
+	bool HybridSystem::merge_secondary_miss(Transaction &trans)
+	{
+		// Only reads and writes can wait on a fill. Everything else waits in the queue as before.
+		if ((trans.transactionType != DATA_READ) && (trans.transactionType != DATA_WRITE))
+			return false;
+
+		uint64_t addr = ALIGN(trans.address);
+		uint64_t page_addr = PAGE_ADDRESS(addr);
+		unordered_map<uint64_t, Pending>::iterator fill = flash_pending.find(page_addr);
+		if ((fill == flash_pending.end()) || (fill->second.op != LINE_READ))
+			return false;
+
+		// The burst with the line must still be on its way. This also rules out sectors that aren't being
+		// filled (and SINGLE_WORD, which doesn't track the bursts).
+		uint64_t burst_addr = page_addr + (PAGE_OFFSET(addr) / FLASH_BURST_SIZE) * FLASH_BURST_SIZE;
+		unordered_map<uint64_t, unordered_set<uint64_t> >::iterator wait = flash_pending_wait.find(page_addr);
+		if ((wait == flash_pending_wait.end()) || (wait->second.count(burst_addr) == 0))
+			return false;
+
+		unordered_map<uint64_t, list<Transaction> >::iterator targets = merged_accesses.find(page_addr);
+		if ((targets != merged_accesses.end()) && (targets->second.size() >= MSHR_TARGETS))
+			return false;
+
+		// An access to the same address as the miss or another target stays in the queue until that one is
+		// done, since the Logger only tracks one access per address at a time.
+		if (fill->second.orig_addr == trans.address)
+			return false;
+		if (targets != merged_accesses.end())
+		{
+			for (list<Transaction>::iterator it = targets->second.begin(); it != targets->second.end(); it++)
+			{
+				if (it->address == trans.address)
+					return false;
+			}
+		}
+
+		if (DEBUG_CACHE)
+			cerr << currentClockCycle << ": " << "Merging access to " << trans.address << " into the fill of page " << page_addr << "\n";
+
+		merged_accesses[page_addr].push_back(trans);
+		uint32_t &sectors = merged_pages[page_addr];
+		if (trans.transactionType == DATA_WRITE)
+		{
+			sectors |= SECTOR_BIT(addr);
+			merged_writes++;
+		}
+		else
+			merged_reads++;
+
+		// Same bookkeeping as a hit, since the page is on its way into the cache.
+		note_data_access(trans, SET_INDEX(addr), true);
+		if (opt_replacement)
+			opt_update(fill->second.cache_addr, oracle_access(page_addr));
+		if (ENABLE_STREAM_BUFFER)
+			stream_buffer_hit_handler(page_addr);
+
+		return true;
+	}
+
+	void HybridSystem::finish_merged_accesses(uint64_t page_addr, uint64_t burst_addr)
+	{
+		unordered_map<uint64_t, list<Transaction> >::iterator targets = merged_accesses.find(page_addr);
+		if (targets == merged_accesses.end())
+			return;
+
+		// Complete the accesses to the lines in the burst that just arrived.
+		list<Transaction>::iterator it = targets->second.begin();
+		while (it != targets->second.end())
+		{
+			uint64_t addr = ALIGN(it->address);
+			if (page_addr + (PAGE_OFFSET(addr) / FLASH_BURST_SIZE) * FLASH_BURST_SIZE != burst_addr)
+			{
+				++it;
+				continue;
+			}
+
+			if (it->transactionType == DATA_READ)
+				ReadDoneCallback(systemID, it->address, currentClockCycle);
+			else
+				WriteDoneCallback(systemID, it->address, currentClockCycle);
+			pending_count -= 1;
+
+			it = targets->second.erase(it);
+		}
+
+		if (targets->second.empty())
+			merged_accesses.erase(targets);
+	}
+
 	void HybridSystem::VictimRead(Pending p)
 	{
 		if (DEBUG_CACHE)
@@ -823,16 +1163,22 @@ namespace HybridSim {
 #if SINGLE_WORD
 		// Schedule a read from DRAM to get the line being evicted.
 		Transaction t = Transaction(DATA_READ, p.cache_addr, NULL);
-		dram_queue.push_back(t);
+		dram_queue.push(t, queue_class(p.type), currentClockCycle);
 #else
-		// Schedule reads for the entire page.
+		// Schedule reads for the sectors being written back (the entire page if it isn't sectored).
+		// With DRAM_CRITICAL_LINE_FIRST, start at the line that missed, since that is where the new page is
+		// written first.
 		dram_pending_wait[p.cache_addr] = unordered_set<uint64_t>();
-		for(uint64_t i=0; i<PAGE_SIZE/BURST_SIZE; i++)
+		uint64_t bursts = PAGE_SIZE/BURST_SIZE;
+		uint64_t first = DRAM_CRITICAL_LINE_FIRST ? PAGE_OFFSET(p.flash_addr)/BURST_SIZE : 0;
+		for(uint64_t i=0; i<bursts; i++)
 		{
-			uint64_t addr = p.cache_addr + i*BURST_SIZE;
+			uint64_t addr = p.cache_addr + ((first + i) % bursts)*BURST_SIZE;
+			if ((p.victim_sectors & SECTOR_BIT(addr)) == 0)
+				continue;
 			dram_pending_wait[p.cache_addr].insert(addr);
 			Transaction t = Transaction(DATA_READ, addr, NULL);
-			dram_queue.push_back(t);
+			dram_queue.push(t, queue_class(p.type), currentClockCycle);
 		}
 #endif
 
@@ -862,6 +1208,18 @@ namespace HybridSim {
 		// Remove the read that just finished from the wait set.
 		dram_pending_wait[cache_page_addr].erase(addr);
 
+		// The new page's line can be written over the victim's now.
+		if (!fill_waiting.empty())
+		{
+			unordered_map<uint64_t, uint64_t>::iterator waiting = fill_waiting.find(addr);
+			if (waiting != fill_waiting.end())
+			{
+				QueueClass fill_class = (QueueClass)waiting->second;
+				fill_waiting.erase(waiting);
+				FillLineWrite(addr, fill_class);
+			}
+		}
+
 		if (!dram_pending_wait[cache_page_addr].empty())
 		{
 			// If not done with this line, then re-enter pending map.
@@ -891,6 +1249,10 @@ namespace HybridSim {
 		uint64_t victim_address = FLASH_ADDRESS(p.victim_tag, SET_INDEX(p.cache_addr));
 		contention_unlock(p.flash_addr, p.orig_addr, "VICTIM_READ", p.victim_valid, victim_address, true, p.cache_addr);
 
+		// The write below keeps the NVM busy, so the next eager clean waits for it.
+		if (eager_clean_active && (p.type == SYNC) && (p.cache_addr == eager_clean_addr))
+			eager_clean_active = false;
+
 		// Schedule a write to the flash to simulate the transfer
 		VictimWrite(p);
 	}
@@ -904,23 +1266,151 @@ namespace HybridSim {
 		// This is where the victim line is stored in the Flash address space.
 		uint64_t victim_flash_addr = (p.victim_tag * NUM_SETS + SET_INDEX(p.flash_addr)) * PAGE_SIZE; 
 
+		// Dirty victims of misses wait in the write-back buffer (if there is one).
+		// SYNC is asking for the page to be in the NVM, so it is always written immediately.
+		if ((WRITEBACK_BUFFER_SIZE > 0) && (p.type != SYNC))
+		{
+			if (writeback_buffer.size() >= WRITEBACK_BUFFER_SIZE)
+			{
+				// The buffer is full, so make room by writing out the oldest page.
+				writeback_buffer_drain();
+				writeback_buffer_forced_drains++;
+			}
+
+			uint64_t evicted;
+			writeback_buffer.insert(victim_flash_addr, p.victim_sectors, evicted);
+			writeback_buffer_inserts++;
+			if (writeback_buffer.size() > writeback_buffer_max)
+				writeback_buffer_max = writeback_buffer.size();
+			return;
+		}
+
+		VictimWriteIssue(victim_flash_addr, p.victim_sectors);
+	}
+
+	void HybridSystem::VictimWriteIssue(uint64_t victim_flash_addr, uint32_t sectors)
+	{
 #if SINGLE_WORD
 		// Schedule a write to Flash to save the evicted line.
 		Transaction t = Transaction(DATA_WRITE, victim_flash_addr, NULL);
-		flash_queue.push_back(t);
+		flash_queue.push(t, QUEUE_WRITEBACK, currentClockCycle);
+		nvm_bytes_written += PAGE_SIZE;
 #else
-		// Schedule writes for the entire page.
+		// Schedule writes for the sectors being written back (the entire page if it isn't sectored).
 		for(uint64_t i=0; i<PAGE_SIZE/FLASH_BURST_SIZE; i++)
 		{
-			Transaction t = Transaction(DATA_WRITE, victim_flash_addr + i*FLASH_BURST_SIZE, NULL);
-			flash_queue.push_back(t);
+			uint64_t addr = victim_flash_addr + i*FLASH_BURST_SIZE;
+			if ((sectors & SECTOR_BIT(addr)) == 0)
+				continue;
+			Transaction t = Transaction(DATA_WRITE, addr, NULL);
+			flash_queue.push(t, QUEUE_WRITEBACK, currentClockCycle);
+			nvm_bytes_written += FLASH_BURST_SIZE;
 		}
 #endif
 
 		// No pending event schedule necessary (might add later for debugging though).
 	}
 
-	void HybridSystem::LineRead(Pending p)
+	void HybridSystem::writeback_buffer_drain()
+	{
+		uint64_t victim_flash_addr, sectors;
+		if (!writeback_buffer.oldest(victim_flash_addr, sectors))
+			return;
+
+		if (DEBUG_CACHE)
+			cerr << currentClockCycle << ": " << "Draining " << victim_flash_addr << " from the write-back buffer\n";
+
+		writeback_buffer.erase(victim_flash_addr);
+		VictimWriteIssue(victim_flash_addr, sectors);
+	}
+
+	void HybridSystem::set_writeback_buffer_size()
+	{
+		if ((WRITEBACK_BUFFER_SIZE > 0) && ((WRITEBACK_BUFFER_HIGH_WATERMARK == 0) || (WRITEBACK_BUFFER_HIGH_WATERMARK > WRITEBACK_BUFFER_SIZE)))
+		{
+			cerr << "ERROR: WRITEBACK_BUFFER_HIGH_WATERMARK must be between 1 and WRITEBACK_BUFFER_SIZE.\n";
+			abort();
+		}
+
+		// Write out the oldest pages that no longer fit.
+		while (writeback_buffer.size() > WRITEBACK_BUFFER_SIZE)
+		{
+			writeback_buffer_drain();
+			writeback_buffer_forced_drains++;
+		}
+		writeback_buffer.set_capacity(WRITEBACK_BUFFER_SIZE);
+	}
+
+	void HybridSystem::set_eager_cleaning()
+	{
+		if ((EAGER_CLEAN_THRESHOLD < 0.0) || (EAGER_CLEAN_THRESHOLD > 1.0))
+		{
+			cerr << "ERROR: EAGER_CLEAN_THRESHOLD must be between 0 and 1.\n";
+			abort();
+		}
+		eager_clean_limit = (uint64_t)(EAGER_CLEAN_THRESHOLD * CACHE_PAGES);
+	}
+
+	bool HybridSystem::eager_clean()
+	{
+		// Go round the sets, so the cleaning is spread over the whole cache. In each set, clean the least
+		// recently used dirty page, since it is the next one to be evicted. Pages that are being accessed are
+		// skipped. While they are all being accessed, only EAGER_CLEAN_SCAN_SETS sets are looked at per cycle.
+		for (uint64_t n=0; (n < NUM_SETS) && (n < EAGER_CLEAN_SCAN_SETS); n++)
+		{
+			uint64_t set_index = eager_clean_set;
+			eager_clean_set = (eager_clean_set + 1) % NUM_SETS;
+			if (!dirty_index.any(set_index))
+				continue;
+
+			// Leave at least one line unlocked, so a miss that is being looked up can still find a victim.
+			unordered_map<uint64_t, uint64_t>::iterator locked_lines = set_counter.find(set_index);
+			if ((locked_lines != set_counter.end()) && (locked_lines->second + 1 >= SET_SIZE))
+				continue;
+
+			bool found = false;
+			uint64_t cache_addr = 0;
+			uint64_t oldest_ts = 0;
+			for (uint64_t way=0; way < SET_SIZE; way++)
+			{
+				uint64_t cache_page = way * NUM_SETS + set_index;
+				if (!dirty_index.test(cache_page))
+					continue;
+
+				cache_line &cur_line = cache.line(cache_page);
+				if (cur_line.locked || !contention_is_unlocked(FLASH_ADDRESS(cur_line.tag, set_index)))
+					continue;
+
+				if (!found || (cur_line.ts < oldest_ts))
+				{
+					found = true;
+					cache_addr = cache_page * PAGE_SIZE;
+					oldest_ts = cur_line.ts;
+				}
+			}
+			if (!found)
+				continue;
+
+			// Lock the page and the line as for a SYNC hit, then write the page back with sync().
+			uint64_t flash_addr = FLASH_ADDRESS(cache[cache_addr].tag, set_index);
+			if (DEBUG_CACHE)
+				cerr << currentClockCycle << ": " << "Eager cleaning " << flash_addr << " (cache address " << cache_addr << ")\n";
+
+			contention_lock(flash_addr);
+			contention_cache_line_lock(cache_addr);
+			pending_count += 1;
+			sync(flash_addr, cache_addr, Transaction(SYNC, flash_addr, NULL));
+
+			eager_clean_active = true;
+			eager_clean_addr = cache_addr;
+			eager_cleans++;
+			return true;
+		}
+
+		return false;
+	}
+
+	void HybridSystem::LineRead(Pending p, uint32_t buffered_sectors)
 	{
 		if (DEBUG_CACHE)
 		{
@@ -938,25 +1428,130 @@ namespace HybridSim {
 
 #if SINGLE_WORD
 		// Schedule a read from Flash to get the new line 
-		Transaction t = Transaction(DATA_READ, page_addr, NULL);
-		flash_queue.push_back(t);
+		if (buffered_sectors != 0)
+		{
+			buffer_reads.push_back(make_pair(currentClockCycle + BUFFER_READ_DELAY, page_addr));
+		}
+		else
+		{
+			Transaction t = Transaction(DATA_READ, page_addr, NULL);
+			flash_queue.push(t, queue_class(p.type), currentClockCycle);
+			nvm_bytes_read += PAGE_SIZE;
+		}
 #else
-		// Schedule reads for the entire page.
+		// Schedule reads for the sectors being filled (the entire page if it isn't sectored). Sectors that
+		// are still in the write-back buffer come from there.
+		FlashSectorRead(page_addr, p.sectors & ~buffered_sectors, queue_class(p.type));
+		if (buffered_sectors != 0)
+			BufferSectorRead(page_addr, buffered_sectors);
+#endif
+		if (buffered_sectors != 0)
+			buffered_fills[page_addr] = buffered_sectors;
+
+		// Add a record in the Flash's pending table.
+		p.op = LINE_READ;
+		flash_pending[page_addr] = p;
+	}
+
+	void HybridSystem::FlashSectorRead(uint64_t page_addr, uint32_t sectors, QueueClass queue_class)
+	{
 		flash_pending_wait[page_addr] = unordered_set<uint64_t>();
 		for(uint64_t i=0; i<PAGE_SIZE/FLASH_BURST_SIZE; i++)
 		{
 			uint64_t addr = page_addr + i*FLASH_BURST_SIZE;
+			if ((sectors & SECTOR_BIT(addr)) == 0)
+				continue;
 			flash_pending_wait[page_addr].insert(addr);
 			Transaction t = Transaction(DATA_READ, addr, NULL);
-			flash_queue.push_back(t);
+			flash_queue.push(t, queue_class, currentClockCycle);
+			nvm_bytes_read += FLASH_BURST_SIZE;
 		}
-#endif
+	}
 
-		// Add a record in the Flash's pending table.
-		p.op = LINE_READ;
+	void HybridSystem::BufferSectorRead(uint64_t page_addr, uint32_t sectors)
+	{
+		// Must come after FlashSectorRead(), which starts the page's wait set.
+		for(uint64_t i=0; i<PAGE_SIZE/FLASH_BURST_SIZE; i++)
+		{
+			uint64_t addr = page_addr + i*FLASH_BURST_SIZE;
+			if ((sectors & SECTOR_BIT(addr)) == 0)
+				continue;
+			flash_pending_wait[page_addr].insert(addr);
+			buffer_reads.push_back(make_pair(currentClockCycle + BUFFER_READ_DELAY, addr));
+		}
+	}
+
+	void HybridSystem::SectorRead(Pending p)
+	{
+		if (DEBUG_CACHE)
+			cerr << currentClockCycle << ": " << "Performing SECTOR_READ for (" << p.flash_addr << ", " << p.cache_addr << ") sectors="
+				<< hex << p.sectors << dec << "\n";
+
+		uint64_t page_addr = PAGE_ADDRESS(p.flash_addr);
+
+		// The page's entry in the Flash's pending table is in use until this is done, so no other
+		// access to the page can start until then (see contention_is_unlocked).
+		assert(flash_pending.count(page_addr) == 0);
+		sector_fill_pages.insert(page_addr);
+
+		FlashSectorRead(page_addr, p.sectors, queue_class(p.type));
+
+		p.op = SECTOR_READ;
 		flash_pending[page_addr] = p;
 	}
 
+	void HybridSystem::SectorReadFinish(uint64_t addr, Pending p)
+	{
+		uint64_t page_addr = PAGE_ADDRESS(p.flash_addr);
+
+		// Remove the read that just finished from the wait set.
+		flash_pending_wait[page_addr].erase(addr);
+		if (!flash_pending_wait[page_addr].empty())
+		{
+			// If not done with these sectors, then re-enter pending map.
+			flash_pending[page_addr] = p;
+			return;
+		}
+		flash_pending_wait.erase(page_addr);
+
+		if (DEBUG_CACHE)
+			cerr << currentClockCycle << ": " << "SECTOR_READ for (" << p.flash_addr << ", " << p.cache_addr << ") has completed.\n";
+
+		cache_line cur_line = cache[p.cache_addr];
+		cur_line.sector_valid |= p.sectors;
+		cache[p.cache_addr] = cur_line;
+
+		// Store the sectors in DRAM.
+		LineWrite(p);
+
+		sector_fill_pages.erase(page_addr);
+		this->check_queue = true;
+
+		if (p.type == DATA_READ)
+		{
+			// Same cache state update as CacheRead.
+			cur_line = cache[p.cache_addr];
+			cur_line.ts = currentClockCycle;
+			if ((cur_line.prefetched) && (cur_line.used == false))
+			{
+				unused_prefetches--;
+				if (ENABLE_PREFETCH_THROTTLE)
+					prefetch_throttle.prefetch_used();
+			}
+			cur_line.used = true;
+			cache[p.cache_addr] = cur_line;
+
+			CacheReadFinish(p.cache_addr, p);
+		}
+		else if (p.type == DATA_WRITE)
+			CacheWriteFinish(p);
+		else
+		{
+			// Background fill of the rest of a page (SECTOR_FILL=BACKGROUND).
+			contention_cache_line_unlock(p.cache_addr);
+		}
+	}
+
 
 	void HybridSystem::LineReadFinish(uint64_t addr, Pending p)
 	{
@@ -979,6 +1574,10 @@ namespace HybridSim {
 		// Remove the read that just finished from the wait set.
 		flash_pending_wait[page_addr].erase(addr);
 
+		// Accesses that merged into this fill can finish as soon as their lines are here.
+		if (!merged_accesses.empty())
+			finish_merged_accesses(page_addr, addr);
+
 		if (!flash_pending_wait[page_addr].empty())
 		{
 			// If not done with this line, then re-enter pending map.
@@ -1006,6 +1605,8 @@ namespace HybridSim {
 		cur_line.tag = TAG(p.flash_addr);
 		cur_line.dirty = false;
 		cur_line.valid = true;
+		cur_line.sector_valid = p.sectors;
+		cur_line.sector_dirty = 0;
 		cur_line.ts = currentClockCycle;
 		cur_line.used = false;
 		if (p.type == PREFETCH)
@@ -1013,16 +1614,68 @@ namespace HybridSim {
 			cur_line.prefetched = true;
 			total_prefetches++;
 			unused_prefetches++;
+			if (ENABLE_PREFETCH_THROTTLE)
+			{
+				prefetch_throttle.prefetch_filled(PAGE_ADDRESS(p.flash_addr));
+				if (ENABLE_STRIDE_PREFETCHER)
+					stride_prefetcher.prefetch_filled(PAGE_ADDRESS(p.flash_addr));
+			}
 		}
 		else
 		{
 			cur_line.prefetched = false;
 		}
+
+		// Apply the accesses that merged into this fill (they have all finished by now).
+		unordered_map<uint64_t, uint32_t>::iterator merged = merged_pages.find(PAGE_ADDRESS(p.flash_addr));
+		if (merged != merged_pages.end())
+		{
+			if (cur_line.prefetched)
+			{
+				unused_prefetches--;
+				if (ENABLE_PREFETCH_THROTTLE)
+					prefetch_throttle.prefetch_used();
+			}
+			cur_line.used = true;
+			if (merged->second != 0)
+			{
+				cur_line.dirty = true;
+				cur_line.sector_dirty |= merged->second;
+				dirty_index.set(p.cache_addr / PAGE_SIZE);
+				if (dirty_index.count() > dirty_pages_max)
+					dirty_pages_max = dirty_index.count();
+			}
+			merged_pages.erase(merged);
+		}
+
+		// Sectors read back out of the write-back buffer haven't been written to the NVM yet.
+		unordered_map<uint64_t, uint32_t>::iterator buffered = buffered_fills.find(PAGE_ADDRESS(p.flash_addr));
+		if (buffered != buffered_fills.end())
+		{
+			cur_line.dirty = true;
+			cur_line.sector_dirty |= buffered->second;
+			dirty_index.set(p.cache_addr / PAGE_SIZE);
+			if (dirty_index.count() > dirty_pages_max)
+				dirty_pages_max = dirty_index.count();
+			buffered_fills.erase(buffered);
+		}
 		cache[p.cache_addr] = cur_line;
 
 		// Schedule LineWrite operation to store the line in DRAM.
 		LineWrite(p);
 
+		// With SECTOR_FILL=BACKGROUND, read the rest of the page now. The line stays locked until it is done.
+		if ((SECTOR_SIZE != 0) && (SECTOR_FILL == "BACKGROUND") && (p.sectors != ALL_SECTORS))
+		{
+			Pending fill = p;
+			fill.orig_addr = PAGE_ADDRESS(p.flash_addr);
+			fill.callback_sent = true;
+			fill.type = PREFETCH;
+			fill.sectors = ALL_SECTORS & ~p.sectors;
+			contention_cache_line_lock(p.cache_addr);
+			SectorRead(fill);
+		}
+
 		// Use the CacheReadFinish/CacheWriteFinish functions to mark the page dirty (DATA_WRITE only), perform
 		// the callback to the requesting module, and remove this set from the pending sets to allow future
 		// operations to this set to start.
@@ -1054,14 +1707,30 @@ namespace HybridSim {
 
 #if SINGLE_WORD
 		// Schedule a write to DRAM to simulate the write of the line that was read from Flash.
-		Transaction t = Transaction(DATA_WRITE, p.cache_addr, NULL);
-		dram_queue.push_back(t);
+		FillLineWrite(p.cache_addr, queue_class(p.type));
 #else
-		// Schedule writes for the entire page.
-		for(uint64_t i=0; i<PAGE_SIZE/BURST_SIZE; i++)
-		{
-			Transaction t = Transaction(DATA_WRITE, p.cache_addr + i*BURST_SIZE, NULL);
-			dram_queue.push_back(t);
+		// Schedule writes for the sectors that were read (the entire page if it isn't sectored).
+		// With DRAM_CRITICAL_LINE_FIRST, the line that missed goes first, and the lines stay in the fill
+		// buffer until their writes are done (see CacheRead). A line whose victim read hasn't finished
+		// yet is written as soon as it has (see VictimReadFinish), so the victim's reads and the fill's
+		// writes take turns instead of the whole fill waiting behind the whole victim.
+		uint64_t bursts = PAGE_SIZE/BURST_SIZE;
+		uint64_t first = DRAM_CRITICAL_LINE_FIRST ? PAGE_OFFSET(p.flash_addr)/BURST_SIZE : 0;
+		unordered_map<uint64_t, unordered_set<uint64_t> >::iterator victim = dram_pending_wait.end();
+		if (DRAM_CRITICAL_LINE_FIRST)
+			victim = dram_pending_wait.find(p.cache_addr);
+		for(uint64_t i=0; i<bursts; i++)
+		{
+			uint64_t addr = p.cache_addr + ((first + i) % bursts)*BURST_SIZE;
+			if ((p.sectors & SECTOR_BIT(addr)) == 0)
+				continue;
+			if ((victim != dram_pending_wait.end()) && (victim->second.count(addr) != 0))
+			{
+				fill_waiting[addr] = queue_class(p.type);
+				fill_writes_deferred++;
+				continue;
+			}
+			FillLineWrite(addr, queue_class(p.type));
 		}
 #endif
 
@@ -1069,6 +1738,20 @@ namespace HybridSim {
 	}
 
 
+	void HybridSystem::FillLineWrite(uint64_t addr, QueueClass queue_class)
+	{
+		Transaction t = Transaction(DATA_WRITE, addr, NULL);
+		dram_queue.push(t, queue_class, currentClockCycle);
+
+		// Writes to a line finish in the order they are queued, so the line leaves the fill buffer once
+		// the writes already queued to it and this one are done.
+		if (DRAM_CRITICAL_LINE_FIRST)
+		{
+			dram_writes[addr]++;
+			fill_lines[addr] = dram_writes[addr];
+		}
+	}
+
 	void HybridSystem::CacheRead(uint64_t orig_addr, uint64_t flash_addr, uint64_t cache_addr)
 	{
 		if (DEBUG_CACHE)
@@ -1079,8 +1762,14 @@ namespace HybridSim {
 
 		assert(cache_addr == PAGE_ADDRESS(data_addr));
 
-		Transaction t = Transaction(DATA_READ, data_addr, NULL);
-		dram_queue.push_back(t);
+		// A line that a fill is still writing into the DRAM is read from the fill buffer, so the read doesn't
+		// wait behind the rest of the page's writes.
+		bool forward = DRAM_CRITICAL_LINE_FIRST && ((fill_lines.count(data_addr) != 0) || (fill_waiting.count(data_addr) != 0));
+		if (!forward)
+		{
+			Transaction t = Transaction(DATA_READ, data_addr, NULL);
+			dram_queue.push(t, QUEUE_DEMAND_READ, currentClockCycle);
+		}
 
 		// Update the cache state
 		// This could be done here or in CacheReadFinish
@@ -1088,7 +1777,11 @@ namespace HybridSim {
 		cache_line cur_line = cache[cache_addr];
 		cur_line.ts = currentClockCycle;
 		if ((cur_line.prefetched) && (cur_line.used == false)) // Note: this if statement must come before cur_line.used is set to true.
+		{
 			unused_prefetches--;
+			if (ENABLE_PREFETCH_THROTTLE)
+				prefetch_throttle.prefetch_used();
+		}
 		cur_line.used = true;
 		cache[cache_addr] = cur_line;
 
@@ -1102,6 +1795,13 @@ namespace HybridSim {
 		p.victim_valid = false;
 		p.callback_sent = false;
 		p.type = DATA_READ;
+
+		if (forward)
+		{
+			fill_buffer_hits++;
+			fill_buffer_reads.push_back(make_pair(currentClockCycle + BUFFER_READ_DELAY, data_addr));
+		}
+
 		assert(dram_pending.count(data_addr) == 0);
 		dram_pending[data_addr] = p;
 
@@ -1136,7 +1836,9 @@ namespace HybridSim {
 		uint64_t data_addr = cache_addr + PAGE_OFFSET(flash_addr);
 
 		Transaction t = Transaction(DATA_WRITE, data_addr, NULL);
-		dram_queue.push_back(t);
+		dram_queue.push(t, QUEUE_DEMAND_WRITE, currentClockCycle);
+		if (DRAM_CRITICAL_LINE_FIRST)
+			dram_writes[data_addr]++;
 
 		// Finish the operation by updating cache state, doing the callback, and removing the pending set.
 		// Note: This is only split up so the LineWrite operation can reuse the second half
@@ -1161,8 +1863,16 @@ namespace HybridSim {
 		cache_line cur_line = cache[p.cache_addr];
 		cur_line.dirty = true;
 		cur_line.valid = true;
+		cur_line.sector_dirty |= SECTOR_BIT(p.flash_addr);
+		dirty_index.set(p.cache_addr / PAGE_SIZE);
+		if (dirty_index.count() > dirty_pages_max)
+			dirty_pages_max = dirty_index.count();
 		if ((cur_line.prefetched) && (cur_line.used == false)) // Note: this if statement must come before cur_line.used is set to true.
+		{
 			unused_prefetches--;
+			if (ENABLE_PREFETCH_THROTTLE)
+				prefetch_throttle.prefetch_used();
+		}
 		cur_line.used = true;
 		cur_line.ts = currentClockCycle;
 		cache[p.cache_addr] = cur_line;
@@ -1194,6 +1904,8 @@ namespace HybridSim {
 		cache_line cur_line = cache[cache_addr];
 		cur_line.ts = 0;
 		cache[cache_addr] = cur_line;
+		if (opt_replacement)
+			opt_update(cache_addr, OPT_EVICT_FIRST);
 
 		uint64_t set_index = SET_INDEX(cache_addr);
 		uint64_t flash_address = FLASH_ADDRESS(cur_line.tag, set_index);
@@ -1210,6 +1922,8 @@ namespace HybridSim {
 
 	void HybridSystem::DRAMReadCallback(uint id, uint64_t addr, uint64_t cycle)
 	{
+		ProfileScope callback_scope(profiler, PROFILE_CALLBACK);
+
 		// Determine which address to look up in the pending table.
 		// If there is an entry for this page in the dram_pending_wait, then that
 		// means this is for a VICTIM_READ operation and we should use the page address.
@@ -1260,8 +1974,22 @@ namespace HybridSim {
 
 	void HybridSystem::DRAMWriteCallback(uint id, uint64_t addr, uint64_t cycle)
 	{
-		// Nothing to do (it doesn't matter when the DRAM write finishes for the cache controller, as long as it happens).
+		ProfileScope callback_scope(profiler, PROFILE_CALLBACK);
+
+		// Nothing to do (it doesn't matter when the DRAM write finishes for the cache controller, as long as it happens),
+		// except that a filled line leaves the fill buffer once its own write is done.
 		dram_pending_set.erase(addr);
+		if (DRAM_CRITICAL_LINE_FIRST)
+		{
+			unordered_map<uint64_t, uint64_t>::iterator writes = dram_writes.find(addr);
+			assert(writes != dram_writes.end());
+			if (--writes->second == 0)
+				dram_writes.erase(writes);
+
+			unordered_map<uint64_t, uint64_t>::iterator fill = fill_lines.find(addr);
+			if ((fill != fill_lines.end()) && (--fill->second == 0))
+				fill_lines.erase(fill);
+		}
 	}
 
 	void HybridSystem::DRAMPowerCallback(double a, double b, double c, double d)
@@ -1269,8 +1997,10 @@ namespace HybridSim {
 		printf("power callback: %0.3f, %0.3f, %0.3f, %0.3f\n",a,b,c,d);
 	}
 
-	void HybridSystem::FlashReadCallback(uint id, uint64_t addr, uint64_t cycle, bool unmapped)
+	void HybridSystem::FlashReadCallback(uint id, uint64_t addr, uint64_t cycle)
 	{
+		ProfileScope callback_scope(profiler, PROFILE_CALLBACK);
+
 		if (flash_pending.count(PAGE_ADDRESS(addr)) != 0)
 		{
 			// Get the pending object.
@@ -1283,6 +2013,10 @@ namespace HybridSim {
 			{
 				LineReadFinish(addr, p);
 			}
+			else if (p.op == SECTOR_READ)
+			{
+				SectorReadFinish(addr, p);
+			}
 			else
 			{
 				ERROR("FlashReadCallback received an invalid op.");
@@ -1298,8 +2032,10 @@ namespace HybridSim {
 		}
 	}
 
-	void HybridSystem::FlashCriticalLineCallback(uint id, uint64_t addr, uint64_t cycle, bool unmapped)
+	void HybridSystem::FlashCriticalLineCallback(uint id, uint64_t addr, uint64_t cycle)
 	{
+		ProfileScope callback_scope(profiler, PROFILE_CALLBACK);
+
 		// This function is called to implement critical line first for reads.
 		// This allows HybridSim to tell the external user it can make progress as soon as the data
 		// it is waiting for is back in the memory controller.
@@ -1314,7 +2050,7 @@ namespace HybridSim {
 			// Note: DO NOT REMOVE THIS FROM THE PENDING SET.
 
 
-			if (p.op == LINE_READ)
+			if ((p.op == LINE_READ) || (p.op == SECTOR_READ))
 			{
 				if (p.callback_sent)
 				{
@@ -1351,8 +2087,10 @@ namespace HybridSim {
 
 	}
 
-	void HybridSystem::FlashWriteCallback(uint id, uint64_t addr, uint64_t cycle, bool unmapped)
+	void HybridSystem::FlashWriteCallback(uint id, uint64_t addr, uint64_t cycle)
 	{
+		ProfileScope callback_scope(profiler, PROFILE_CALLBACK);
+
 		// Nothing to do (it doesn't matter when the flash write finishes for the cache controller, as long as it happens).
 
 		if (DEBUG_CACHE)
@@ -1363,6 +2101,10 @@ namespace HybridSim {
 
 	void HybridSystem::ReadDoneCallback(uint sysID, uint64_t orig_addr, uint64_t cycle)
 	{
+		// Free the access's input queue entry first, so the callback can add another access.
+		assert(accepted_accesses > 0);
+		accepted_accesses--;
+
 		if (ReadDone != NULL)
 		{
 			uint64_t callback_addr = orig_addr;
@@ -1380,13 +2122,16 @@ namespace HybridSim {
 		}
 
 		// Finish the logging for this access.
-		if (ENABLE_LOGGER)
+		if (Instrumentation::logging())
 			log.access_stop(orig_addr);
 	}
 
 
 	void HybridSystem::WriteDoneCallback(uint sysID, uint64_t orig_addr, uint64_t cycle)
 	{
+		assert(accepted_accesses > 0);
+		accepted_accesses--;
+
 		if (WriteDone != NULL)
 		{
 			uint64_t callback_addr = orig_addr;
@@ -1404,7 +2149,7 @@ namespace HybridSim {
 		}
 
 		// Finish the logging for this access.
-		if (ENABLE_LOGGER)
+		if (Instrumentation::logging())
 			log.access_stop(orig_addr);
 	}
 
@@ -1422,12 +2167,89 @@ namespace HybridSim {
 		// Save the cache table if necessary.
 		saveCacheTable();
 
+		// Write out whatever is left in the debug trace buffers.
+		TraceWriter::flush_all();
+
 		cerr << "TLB Misses: " << tlb_misses << "\n";
 		cerr << "TLB Hits: " << tlb_hits << "\n";
 		cerr << "Total prefetches: " << total_prefetches << "\n";
 		cerr << "Unused prefetches in cache: " << unused_prefetches << "\n";
 		cerr << "Unused prefetch victims: " << unused_prefetch_victims << "\n";
 		cerr << "Prefetch hit NOPs: " << prefetch_hit_nops << "\n";
+		if (total_prefetches > 0)
+		{
+			// A prefetch was useful if its page was accessed before being evicted.
+			uint64_t useful_prefetches = total_prefetches - unused_prefetches - unused_prefetch_victims;
+			cerr << "Prefetch accuracy: " << (double)useful_prefetches / total_prefetches << "\n";
+			cerr << "Prefetch coverage: " << (double)useful_prefetches / (useful_prefetches + demand_misses) << "\n";
+		}
+
+		if (ENABLE_STRIDE_PREFETCHER)
+		{
+			cerr << "Stride streams allocated: " << stride_prefetcher.streams_allocated << "\n";
+			cerr << "Stride confirmations: " << stride_prefetcher.stride_confirmations << "\n";
+			cerr << "Stride mispredictions: " << stride_prefetcher.stride_mispredictions << "\n";
+			if (ENABLE_PREFETCH_THROTTLE)
+			{
+				cerr << "Stride feedback increases: " << stride_prefetcher.feedback_increases << "\n";
+				cerr << "Stride feedback decreases: " << stride_prefetcher.feedback_decreases << "\n";
+			}
+		}
+
+		if (ENABLE_PREFETCH_THROTTLE)
+		{
+			cerr << "Late prefetches: " << prefetch_throttle.late_prefetches << "\n";
+			cerr << "Prefetch pollution misses: " << prefetch_throttle.pollution_misses << "\n";
+			cerr << "Prefetch throttle increases: " << prefetch_throttle.level_increases << "\n";
+			cerr << "Prefetch throttle decreases: " << prefetch_throttle.level_decreases << "\n";
+			cerr << "Final prefetch throttle level: " << prefetch_throttle.level << "\n";
+		}
+
+		cerr << "NVM bytes read: " << nvm_bytes_read << "\n";
+		cerr << "NVM bytes written: " << nvm_bytes_written << "\n";
+		if (data_accesses > 0)
+			cerr << "NVM bytes per access: " << (double)(nvm_bytes_read + nvm_bytes_written) / data_accesses << "\n";
+		if (SECTOR_SIZE != 0)
+			cerr << "Sector misses: " << sector_misses << "\n";
+
+		cerr << "Dirty pages: " << dirty_index.count() << "\n";
+		cerr << "Max dirty pages: " << dirty_pages_max << "\n";
+		if (EAGER_CLEAN_THRESHOLD < 1.0)
+			cerr << "Eager cleans: " << eager_cleans << "\n";
+		if (DRAM_CRITICAL_LINE_FIRST)
+		{
+			cerr << "Fill buffer hits: " << fill_buffer_hits << "\n";
+			cerr << "Fill writes deferred: " << fill_writes_deferred << "\n";
+		}
+		if (INPUT_QUEUE_DEPTH > 0)
+		{
+			cerr << "Max accepted accesses: " << accepted_accesses_max << "\n";
+			cerr << "Rejected accesses: " << rejected_accesses << "\n";
+		}
+		if (MSHR_TARGETS > 0)
+		{
+			cerr << "Merged reads: " << merged_reads << "\n";
+			cerr << "Merged writes: " << merged_writes << "\n";
+		}
+		if (sync_alls > 0)
+		{
+			cerr << "Sync alls: " << sync_alls << "\n";
+			cerr << "Sync all pages: " << sync_all_pages << "\n";
+		}
+		if (syncs_written + syncs_clean > 0)
+		{
+			cerr << "Syncs written: " << syncs_written << "\n";
+			cerr << "Syncs clean: " << syncs_clean << "\n";
+		}
+
+		if (WRITEBACK_BUFFER_SIZE > 0)
+		{
+			cerr << "Write-back buffer inserts: " << writeback_buffer_inserts << "\n";
+			cerr << "Write-back buffer idle drains: " << writeback_buffer_idle_drains << "\n";
+			cerr << "Write-back buffer forced drains: " << writeback_buffer_forced_drains << "\n";
+			cerr << "Write-back buffer hits: " << writeback_buffer_hits << "\n";
+			cerr << "Write-back buffer max occupancy: " << writeback_buffer_max << "\n";
+		}
 
 		if (ENABLE_STREAM_BUFFER)
 		{
@@ -1436,12 +2258,17 @@ namespace HybridSim {
 			cerr << "Stream buffers hits: " << stream_buffer_hits << "\n";
 		}
 
+		// Print out the host time profile.
+		if (Instrumentation::profiling())
+			profiler.print();
+
 		// Print out the log file.
-		if (ENABLE_LOGGER)
+		if (Instrumentation::logging())
 		{
 			log.print();
 		
-			// Tell NVDIMM to print logs now
+			// Tell the memories to print logs now
+			dram->saveStats();
 			flash->saveStats();
 		}
 	}
@@ -1449,142 +2276,447 @@ namespace HybridSim {
 
 	void HybridSystem::restoreCacheTable()
 	{
-		if (PREFILL_CACHE)
+		if (ENABLE_RESTORE)
 		{
-			// Fill the cache table.
-			for (uint64_t i=0; i<CACHE_PAGES; i++)
-			{
-				uint64_t cache_addr = i*PAGE_SIZE;
-				cache_line line;
+			cerr << "PERFORMING RESTORE OF CACHE TABLE!!!\n";
 
-				line.valid = true;
-				line.dirty = PREFILL_CACHE_DIRTY;
-				line.locked = false;
-				line.tag = TAG(cache_addr);
-				line.data = 0;
-				line.ts = 0;
+			confirm_directory_exists("state"); // Assumes using state directory, otherwise the user is on their own.
+			loadCheckpoint(HYBRIDSIM_RESTORE_FILE, cache, RESTORE_CLEAN);
 
-				// Put this in the cache.
-				cache[cache_addr] = line;
-			}
+			flash->loadState(NVDIMM_RESTORE_FILE);
 		}
 
-		if (ENABLE_RESTORE)
+		// Otherwise the cache table was already prefilled by CacheTable::init() if PREFILL_CACHE is set.
+	}
+
+	void HybridSystem::saveCacheTable()
+	{
+		if (ENABLE_SAVE)
 		{
-			cerr << "PERFORMING RESTORE OF CACHE TABLE!!!\n";
+			// Make sure the debug traces are complete up to the checkpoint.
+			TraceWriter::flush_all();
 
-			ifstream inFile;
 			confirm_directory_exists("state"); // Assumes using state directory, otherwise the user is on their own.
-			inFile.open(HYBRIDSIM_RESTORE_FILE);
-			if (!inFile.is_open())
+			cerr << "PERFORMING SAVE OF CACHE TABLE!!!\n";
+			saveCheckpoint(HYBRIDSIM_SAVE_FILE, cache);
+
+			flash->saveState(NVDIMM_SAVE_FILE);
+		}
+	}
+
+
+
+	void HybridSystem::saveSystemState(string filename)
+	{
+		StateWriter w;
+		w.open(filename);
+		saveSystemState(w);
+		w.close();
+	}
+
+	void HybridSystem::restoreSystemState(string filename)
+	{
+		StateReader r;
+		r.open(filename);
+		restoreSystemState(r);
+		r.close();
+	}
+
+	void HybridSystem::saveSystemState(StateWriter &w)
+	{
+		// Make sure the debug traces are complete up to the checkpoint.
+		TraceWriter::flush_all();
+
+		w.section("hybridsystem");
+		w.put(PAGE_SIZE);
+		w.put(SET_SIZE);
+		w.put(CACHE_PAGES);
+		w.put(TOTAL_PAGES);
+		w.put(currentClockCycle);
+
+		for (uint64_t i=0; i < cache.size(); i++)
+			w.put(cache.line(i));
+
+		w.section("pending");
+		w.put(dram_pending);
+		w.put(flash_pending);
+		w.put(dram_pending_wait);
+		w.put(flash_pending_wait);
+		w.put(pending_flash_addr);
+		w.put(pending_pages);
+		w.put(set_counter);
+
+		w.section("controller");
+		w.put(check_queue);
+		w.put(delay_counter);
+		w.put(active_transaction);
+		w.put(active_transaction_flag);
+		w.put(pending_count);
+		w.put(dram_pending_set);
+		w.put(dram_bad_address);
+		w.put(max_dram_pending);
+		w.put(pending_pages_max);
+		w.put(trans_queue_max);
+		w.put(trans_queue_size);
+		w.put(accepted_accesses);
+		w.put(accepted_accesses_max);
+		w.put(rejected_accesses);
+		w.put(trans_queue);
+		dram_queue.checkpoint(w);
+		flash_queue.checkpoint(w);
+
+		// Perfect prefetching: the schedule itself is reloaded from PREFETCH_FILE, so only the
+		// per set access counters and cursors are saved.
+		w.section("prefetch");
+		prefetch_schedule.checkpoint(w);
+		w.put(total_prefetches);
+		w.put(unused_prefetches);
+		w.put(unused_prefetch_victims);
+		w.put(prefetch_hit_nops);
+		w.put(demand_misses);
+
+		w.section("tlb");
+		w.put(tlb_base_set);
+		w.put(tlb_misses);
+		w.put(tlb_hits);
+
+		w.section("stream buffer");
+		vector<pair<uint64_t, uint64_t> > sb_entries;
+		one_miss_table.entries(sb_entries);
+		w.put(sb_entries);
+		stream_buffers.entries(sb_entries);
+		w.put(sb_entries);
+		w.put(unique_one_misses);
+		w.put(unique_stream_buffers);
+		w.put(stream_buffer_hits);
+
+		w.section("sectors");
+		w.put(sector_fill_pages);
+		w.put(data_accesses);
+		w.put(nvm_bytes_read);
+		w.put(nvm_bytes_written);
+		w.put(sector_misses);
+
+		w.section("dirty pages");
+		dirty_index.checkpoint(w);
+		w.put(sync_alls);
+		w.put(sync_all_pages);
+		w.put(syncs_written);
+		w.put(syncs_clean);
+		w.put(dirty_pages_max);
+		w.put(eager_clean_set);
+		w.put(eager_clean_active);
+		w.put(eager_clean_addr);
+		w.put(eager_cleans);
+
+		w.section("fill buffer");
+		w.put(fill_lines);
+		w.put(fill_waiting);
+		w.put(dram_writes);
+		w.put(fill_buffer_reads);
+		w.put(fill_buffer_hits);
+		w.put(fill_writes_deferred);
+
+		w.section("merged accesses");
+		w.put(merged_accesses);
+		w.put(merged_pages);
+		w.put(merged_reads);
+		w.put(merged_writes);
+
+		w.section("writeback buffer");
+		vector<pair<uint64_t, uint64_t> > wb_entries;
+		writeback_buffer.entries(wb_entries);
+		w.put(wb_entries);
+		w.put(writeback_buffer_inserts);
+		w.put(writeback_buffer_idle_drains);
+		w.put(writeback_buffer_forced_drains);
+		w.put(writeback_buffer_hits);
+		w.put(writeback_buffer_max);
+		w.put(buffered_fills);
+		w.put(buffer_reads);
+
+		w.section("stride prefetcher");
+		stride_prefetcher.checkpoint(w);
+
+		w.section("prefetch throttle");
+		prefetch_throttle.checkpoint(w);
+
+		// OPT replacement: the oracle itself is reloaded from the trace, so only the per page
+		// positions and the line keys are saved.
+		w.section("oracle");
+		w.put(oracle_position);
+		w.put(opt_next);
+
+		w.put(Instrumentation::logging());
+		if (Instrumentation::logging())
+			log.checkpoint(w);
+
+		dram->checkpoint(w);
+		flash->checkpoint(w);
+	}
+
+	void HybridSystem::restoreSystemState(StateReader &r)
+	{
+		cerr << "PERFORMING RESTORE OF FULL SYSTEM STATE!!!\n";
+
+		r.section("hybridsystem");
+		uint64_t page_size, set_size, cache_pages, total_pages;
+		r.get(page_size);
+		r.get(set_size);
+		r.get(cache_pages);
+		r.get(total_pages);
+		if ((page_size != PAGE_SIZE) || (set_size != SET_SIZE) || (cache_pages != CACHE_PAGES) || (total_pages != TOTAL_PAGES))
+		{
+			cerr << "ERROR: Attempted to restore system state and PAGE_SIZE, SET_SIZE, CACHE_PAGES or TOTAL_PAGES does not match in state file and ini file.\n";
+			abort();
+		}
+		r.get(currentClockCycle);
+
+		for (uint64_t i=0; i < cache.size(); i++)
+			r.get(cache.line(i));
+
+		r.section("pending");
+		r.get(dram_pending);
+		r.get(flash_pending);
+		r.get(dram_pending_wait);
+		r.get(flash_pending_wait);
+		r.get(pending_flash_addr);
+		r.get(pending_pages);
+		r.get(set_counter);
+
+		r.section("controller");
+		r.get(check_queue);
+		r.get(delay_counter);
+		r.get(active_transaction);
+		r.get(active_transaction_flag);
+		r.get(pending_count);
+		r.get(dram_pending_set);
+		r.get(dram_bad_address);
+		r.get(max_dram_pending);
+		r.get(pending_pages_max);
+		r.get(trans_queue_max);
+		r.get(trans_queue_size);
+		r.get(accepted_accesses);
+		r.get(accepted_accesses_max);
+		r.get(rejected_accesses);
+		r.get(trans_queue);
+		dram_queue.restore(r);
+		flash_queue.restore(r);
+
+		r.section("prefetch");
+		prefetch_schedule.restore(r);
+		r.get(total_prefetches);
+		r.get(unused_prefetches);
+		r.get(unused_prefetch_victims);
+		r.get(prefetch_hit_nops);
+		r.get(demand_misses);
+
+		r.section("tlb");
+		r.get(tlb_base_set);
+		r.get(tlb_misses);
+		r.get(tlb_hits);
+
+		r.section("stream buffer");
+		vector<pair<uint64_t, uint64_t> > sb_entries;
+		uint64_t evicted;
+		r.get(sb_entries);
+		one_miss_table.init(ONE_MISS_TABLE_SIZE);
+		for (uint64_t i=0; i < sb_entries.size(); i++)
+			one_miss_table.insert(sb_entries[i].first, sb_entries[i].second, evicted);
+		r.get(sb_entries);
+		stream_buffers.init(NUM_STREAM_BUFFERS);
+		for (uint64_t i=0; i < sb_entries.size(); i++)
+			stream_buffers.insert(sb_entries[i].first, sb_entries[i].second, evicted);
+		r.get(unique_one_misses);
+		r.get(unique_stream_buffers);
+		r.get(stream_buffer_hits);
+
+		r.section("sectors");
+		r.get(sector_fill_pages);
+		r.get(data_accesses);
+		r.get(nvm_bytes_read);
+		r.get(nvm_bytes_written);
+		r.get(sector_misses);
+
+		r.section("dirty pages");
+		dirty_index.restore(r);
+		r.get(sync_alls);
+		r.get(sync_all_pages);
+		r.get(syncs_written);
+		r.get(syncs_clean);
+		r.get(dirty_pages_max);
+		r.get(eager_clean_set);
+		r.get(eager_clean_active);
+		r.get(eager_clean_addr);
+		r.get(eager_cleans);
+
+		r.section("fill buffer");
+		r.get(fill_lines);
+		r.get(fill_waiting);
+		r.get(dram_writes);
+		r.get(fill_buffer_reads);
+		r.get(fill_buffer_hits);
+		r.get(fill_writes_deferred);
+
+		r.section("merged accesses");
+		r.get(merged_accesses);
+		r.get(merged_pages);
+		r.get(merged_reads);
+		r.get(merged_writes);
+
+		r.section("writeback buffer");
+		vector<pair<uint64_t, uint64_t> > wb_entries;
+		r.get(wb_entries);
+		writeback_buffer.init(WRITEBACK_BUFFER_SIZE);
+		for (uint64_t i=0; i < wb_entries.size(); i++)
+			writeback_buffer.insert(wb_entries[i].first, wb_entries[i].second, evicted);
+		r.get(writeback_buffer_inserts);
+		r.get(writeback_buffer_idle_drains);
+		r.get(writeback_buffer_forced_drains);
+		r.get(writeback_buffer_hits);
+		r.get(writeback_buffer_max);
+		r.get(buffered_fills);
+		r.get(buffer_reads);
+
+		r.section("stride prefetcher");
+		stride_prefetcher.restore(r);
+
+		r.section("prefetch throttle");
+		prefetch_throttle.restore(r);
+
+		r.section("oracle");
+		r.get(oracle_position);
+		r.get(opt_next);
+		if (opt_replacement)
+		{
+			if (!oracle_loaded || (opt_next.size() != CACHE_PAGES))
 			{
-				cerr << "ERROR: Failed to load HybridSim's state restore file: " << HYBRIDSIM_RESTORE_FILE << "\n";
+				cerr << "ERROR: The oracle trace must be loaded before restoring a checkpoint with REPLACEMENT_POLICY=OPT.\n";
 				abort();
 			}
+			opt_queue.assign(NUM_SETS, priority_queue<pair<uint64_t, uint64_t> >());
+			for (uint64_t i=0; i < NUM_SETS; i++)
+				opt_rebuild(i);
+		}
 
-			uint64_t tmp;
+		bool logged;
+		r.get(logged);
+		if (logged != Instrumentation::logging())
+		{
+			cerr << "ERROR: Full system checkpoints can't be moved between FAST and normal builds.\n";
+			abort();
+		}
+		if (Instrumentation::logging())
+			log.restore(r);
 
-			// Read the parameters and confirm that they are the same as the current HybridSystem instance.
-			inFile >> tmp;
-			if (tmp != PAGE_SIZE)
-			{
-				cerr << "ERROR: Attempted to restore state and PAGE_SIZE does not match in restore file and ini file."  << "\n";
-				abort();
-			}
-			inFile >> tmp;
-			if (tmp != SET_SIZE)
-			{
-				cerr << "ERROR: Attempted to restore state and SET_SIZE does not match in restore file and ini file."  << "\n";
-				abort();
-			}
-			inFile >> tmp;
-			if (tmp != CACHE_PAGES)
-			{
-				cerr << "ERROR: Attempted to restore state and CACHE_PAGES does not match in restore file and ini file."  << "\n";
-				abort();
-			}
-			inFile >> tmp;
-			if (tmp != TOTAL_PAGES)
-			{
-				cerr << "ERROR: Attempted to restore state and TOTAL_PAGES does not match in restore file and ini file."  << "\n";
-				abort();
-			}
-				
-			// Read the cache table.
-			while(inFile.good())
-			{
-				uint64_t cache_addr;
-				cache_line line;
+		dram->restore(r);
+		flash->restore(r);
+	}
 
-				// Get the cache line data from the file.
-				inFile >> cache_addr;
-				inFile >> line.valid;
-				inFile >> line.dirty;
-				inFile >> line.tag;
-				inFile >> line.data;
-				inFile >> line.ts;
 
-				if (RESTORE_CLEAN)
-				{
-					line.dirty = 0;
-				}
 
-				// The line must not be locked on restore.
-				// This is a point of weirdness with the replay warmup design (since we can't restore the system
-				// exactly as it was), but it is unavoidable. In flight transactions are simply lost. Although, if
-				// replay warmup is done right, the system should run until all transactions are processed.
-				line.locked = false;
+	void HybridSystem::reconfigure(string inifile)
+	{
+		uint64_t old_page_size = PAGE_SIZE, old_set_size = SET_SIZE, old_burst_size = BURST_SIZE;
+		uint64_t old_flash_burst_size = FLASH_BURST_SIZE, old_total_pages = TOTAL_PAGES, old_cache_pages = CACHE_PAGES;
+		uint64_t old_sector_size = SECTOR_SIZE;
+		uint64_t old_enable_logger = ENABLE_LOGGER, old_enable_profiler = ENABLE_PROFILER;
+		string old_dram_backend = DRAM_BACKEND, old_flash_backend = FLASH_BACKEND;
+		string old_replacement_policy = REPLACEMENT_POLICY;
 
-				// Put this in the cache.
-				cache[cache_addr] = line;
-			}
-		
-			inFile.close();
+		iniReader.read(inifile);
 
-			flash->loadNVState(NVDIMM_RESTORE_FILE);
+		if ((PAGE_SIZE != old_page_size) || (SET_SIZE != old_set_size) || (BURST_SIZE != old_burst_size) ||
+				(FLASH_BURST_SIZE != old_flash_burst_size) || (TOTAL_PAGES != old_total_pages) || (CACHE_PAGES != old_cache_pages) ||
+				(SECTOR_SIZE != old_sector_size))
+		{
+			cerr << "ERROR: " << inifile << " changes the cache geometry, which can't be changed mid-run.\n";
+			abort();
+		}
+		if ((DRAM_BACKEND != old_dram_backend) || (FLASH_BACKEND != old_flash_backend))
+		{
+			cerr << "ERROR: " << inifile << " changes the memory backends, which can't be changed mid-run.\n";
+			abort();
 		}
+		if (REPLACEMENT_POLICY != old_replacement_policy)
+		{
+			cerr << "ERROR: " << inifile << " changes REPLACEMENT_POLICY, which can't be changed mid-run.\n";
+			abort();
+		}
+		if ((ENABLE_LOGGER != old_enable_logger) || (ENABLE_PROFILER != old_enable_profiler))
+		{
+			cerr << "ERROR: " << inifile << " changes ENABLE_LOGGER or ENABLE_PROFILER, which can't be changed mid-run.\n";
+			abort();
+		}
+
+		// The stream buffer tables keep their newest entries if they shrink.
+		one_miss_table.set_capacity(ONE_MISS_TABLE_SIZE);
+		stream_buffers.set_capacity(NUM_STREAM_BUFFERS);
+
+		if (ENABLE_STRIDE_PREFETCHER)
+			stride_prefetcher.reconfigure();
+
+		// SECTOR_FILL applies to the next miss.
+		check_sector_config();
+
+		// Queued transactions keep their order; only the choice of the next one changes.
+		set_backend_queue_policy();
+
+		// Buffered victims that no longer fit are written out.
+		set_writeback_buffer_size();
+
+		// A lower threshold starts cleaning the next time the NVM is idle.
+		set_eager_cleaning();
+
+		dram->reconfigure();
+		flash->reconfigure();
 	}
 
-	void HybridSystem::saveCacheTable()
+
+	void HybridSystem::check_sector_config()
 	{
-		if (ENABLE_SAVE)
+		if (SECTOR_SIZE != 0)
 		{
-			ofstream savefile;
-			confirm_directory_exists("state"); // Assumes using state directory, otherwise the user is on their own.
-			savefile.open(HYBRIDSIM_SAVE_FILE, ios_base::out | ios_base::trunc);
-			if (!savefile.is_open())
+			if (SINGLE_WORD)
 			{
-				cerr << "ERROR: Failed to load HybridSim's state save file: " << HYBRIDSIM_SAVE_FILE << "\n";
+				cerr << "ERROR: SECTOR_SIZE can't be used with SINGLE_WORD.\n";
 				abort();
 			}
-			cerr << "PERFORMING SAVE OF CACHE TABLE!!!\n";
-
-			savefile << PAGE_SIZE << " " << SET_SIZE << " " << CACHE_PAGES << " " << TOTAL_PAGES << "\n";
-
-			for (uint64_t i=0; i < CACHE_PAGES; i++)
+			if ((SECTOR_SIZE % BURST_SIZE != 0) || (SECTOR_SIZE % FLASH_BURST_SIZE != 0) || (PAGE_SIZE % SECTOR_SIZE != 0))
 			{
-				uint64_t cache_addr= i * PAGE_SIZE;
-
-				if (cache.count(cache_addr) == 0)
-					// Skip to next page if this cache_line entry is not in the cache table.
-					continue;
-
-				// Get the line entry.
-				cache_line line = cache[cache_addr];
-
-				if (!line.valid)
-					// If the line isn't valid, then don't need to save it.
-					continue;
-				
-				savefile << cache_addr << " " << line.valid << " " << line.dirty << " " << line.tag << " " << line.data << " " << line.ts << "\n";
+				cerr << "ERROR: SECTOR_SIZE must be a multiple of BURST_SIZE and FLASH_BURST_SIZE and must divide PAGE_SIZE.\n";
+				abort();
+			}
+			if (PAGE_SIZE / SECTOR_SIZE > MAX_SECTORS_PER_PAGE)
+			{
+				cerr << "ERROR: SECTOR_SIZE gives " << PAGE_SIZE / SECTOR_SIZE << " sectors per page (at most " << MAX_SECTORS_PER_PAGE 
+					<< " are supported).\n";
+				abort();
 			}
-
-			savefile.close();
-
-			flash->saveNVState(NVDIMM_SAVE_FILE);
+		}
+		if ((SECTOR_FILL != "DEMAND") && (SECTOR_FILL != "BACKGROUND"))
+		{
+			cerr << "ERROR: Invalid SECTOR_FILL " << SECTOR_FILL << " (must be DEMAND or BACKGROUND).\n";
+			abort();
 		}
 	}
 
+	void HybridSystem::set_backend_queue_policy()
+	{
+		if ((BACKEND_QUEUE_POLICY != "FIFO") && (BACKEND_QUEUE_POLICY != "PRIORITY"))
+		{
+			cerr << "ERROR: Invalid BACKEND_QUEUE_POLICY " << BACKEND_QUEUE_POLICY << " (must be FIFO or PRIORITY).\n";
+			abort();
+		}
+		if (QUEUE_STARVATION_LIMIT == 0)
+		{
+			cerr << "ERROR: QUEUE_STARVATION_LIMIT must be at least 1.\n";
+			abort();
+		}
+
+		dram_queue.set_priority(BACKEND_QUEUE_POLICY == "PRIORITY");
+		flash_queue.set_priority(BACKEND_QUEUE_POLICY == "PRIORITY");
+	}
 
 
 	// Page Contention functions
@@ -1664,23 +2796,38 @@ namespace HybridSim {
 	{
 		uint64_t page_addr = PAGE_ADDRESS(flash_addr);
 
-		// First see if the set is locked. This is done by looking at the set_counter.
-		// If the set counter exists and is equal to the set size, then we should NOT be trying to do any more accesses
-		// to the set, because this means that all of the cache lines are locked.
+		// Pages that are reading sectors from the Flash are locked until that is done.
+		if (!sector_fill_pages.empty() && (sector_fill_pages.count(page_addr) != 0))
+			return false;
+
+		// If the page is in the pending_pages or pending_flash_addr map, then it is locked.
+		if ((pending_pages.count(page_addr) != 0) || (pending_flash_addr.count(flash_addr) != 0))
+			return false;
+
+		// Then see if the set is full. This is done by looking at the set_counter.
+		// If every line in the set is locked, a miss has nothing to evict, so it must wait. A hit only needs
+		// its own line (which may already be locked by other hits), so it can go ahead.
 		uint64_t set_index = SET_INDEX(page_addr);
-		if (set_counter.count(set_index) > 0)
+		unordered_map<uint64_t, uint64_t>::iterator locked_lines = set_counter.find(set_index);
+		if ((locked_lines != set_counter.end()) && (locked_lines->second >= SET_SIZE) && !contention_is_cached(page_addr))
+			return false;
+
+		return true;
+	}
+
+	bool HybridSystem::contention_is_cached(uint64_t page_addr)
+	{
+		// Tag lookup without side effects. A page whose line is being filled or evicted is locked in
+		// pending_pages, so a match here is a line that can be hit right away.
+		uint64_t set_index = SET_INDEX(page_addr);
+		uint64_t tag = TAG(page_addr);
+		for (uint64_t way=0; way < SET_SIZE; way++)
 		{
-			if (set_counter[set_index] == SET_SIZE)
-			{
-				return false;
-			}
+			cache_line &cur_line = cache.line(way * NUM_SETS + set_index);
+			if (cur_line.valid && (cur_line.tag == tag))
+				return true;
 		}
-
-		// If the page is not in the penting_pages and pending_flash_addr map, then it is unlocked.
-		if ((pending_pages.count(page_addr) == 0) && (pending_flash_addr.count(flash_addr) == 0))
-			return true;
-		else
-			return false;
+		return false;
 	}
 
 
@@ -1716,15 +2863,14 @@ namespace HybridSim {
 	void HybridSystem::contention_cache_line_lock(uint64_t cache_addr)
 	{
 		cache_line cur_line = cache[cache_addr];
+		bool newly_locked = (cur_line.lock_count == 0);
 		cur_line.locked = true;
 		cur_line.lock_count++;
 		cache[cache_addr] = cur_line;
 
-		uint64_t set_index = SET_INDEX(cache_addr);
-		if (set_counter.count(set_index) == 0)
-			set_counter[set_index] = 1;
-		else
-			set_counter[set_index] += 1;
+		// The set counter counts locked lines, not accesses, so hits to the same line don't fill up the set.
+		if (newly_locked)
+			set_counter[SET_INDEX(cache_addr)] += 1;
 	}
 
 	void HybridSystem::contention_cache_line_unlock(uint64_t cache_addr)
@@ -1733,19 +2879,23 @@ namespace HybridSim {
 		cur_line.lock_count--;
 		assert(cur_line.lock_count >= 0);
 		if (cur_line.lock_count == 0)
+		{
 			cur_line.locked = false; // Only unlock if the count for outstanding accesses is 0.
+			set_counter[SET_INDEX(cache_addr)] -= 1;
+		}
 		cache[cache_addr] = cur_line;
-
-		uint64_t set_index = SET_INDEX(cache_addr);
-		set_counter[set_index] -= 1;
 	}
 
 	// PREFETCHING FUNCTIONS
 	void HybridSystem::issue_sequential_prefetches(uint64_t page_addr)
 	{
+		uint64_t window = SEQUENTIAL_PREFETCHING_WINDOW;
+		if (ENABLE_PREFETCH_THROTTLE)
+			window = prefetch_throttle.scale(window);
+
 		// Count down from the top address. This must be done because addPrefetch puts transactions at the front
 		// of the queue and we want page_addr+PAGE_SIZE to be the first prefetch issued.
-		for (int i=SEQUENTIAL_PREFETCHING_WINDOW; i > 0; i--)
+		for (uint64_t i=window; i > 0; i--)
 		{
 			// Compute the next prefetch address.
 			uint64_t prefetch_address = page_addr + (i * PAGE_SIZE);
@@ -1760,6 +2910,16 @@ namespace HybridSim {
 		}
 	}
 
+	void HybridSystem::issue_stride_prefetches(uint64_t page_addr)
+	{
+		// With ENABLE_PREFETCH_THROTTLE, each stream is throttled on its own (see StridePrefetcher.h).
+		stride_prefetcher.access(page_addr, stride_prefetches);
+
+		// Issue the farthest prefetch first, since addPrefetch puts transactions at the front of the queue.
+		for (vector<uint64_t>::reverse_iterator it = stride_prefetches.rbegin(); it != stride_prefetches.rend(); ++it)
+			addPrefetch(*it);
+	}
+
 
 	void HybridSystem::sync(uint64_t addr, uint64_t cache_address, Transaction trans)
 	{
@@ -1776,8 +2936,17 @@ namespace HybridSim {
 		// The address in the cache line should be the SAME as the address we are syncing on.
 		assert(victim_flash_addr == addr);
 
-		// Lock the cache line so no one else tries to use it while this miss is being serviced.
-		contention_cache_line_lock(cache_address);
+		// The page may have been cleaned since the SYNC was queued (e.g. by an earlier SYNC to it).
+		if (!cur_line.dirty)
+		{
+			syncs_clean++;
+			contention_unlock(addr, addr, "SYNC (clean)", false, 0, true, cache_address);
+			return;
+		}
+		syncs_written++;
+
+		// Note: The cache line was already locked by the hit in ProcessTransaction() and VictimReadFinish()
+		// unlocks it once.
 	
 		Pending p;
 		p.orig_addr = trans.address;
@@ -1788,48 +2957,41 @@ namespace HybridSim {
 		p.callback_sent = false;
 		p.type = trans.transactionType;
 
-		// The line MUST be dirty for a sync operation to be valid.
-		assert(cur_line.dirty);
+		// Only the dirty sectors need to go back to the NVM (the whole page if it isn't sectored).
+		p.victim_sectors = cur_line.sector_dirty;
 
 		VictimRead(p);
 
 		// Mark the line clean (since this is the whole point of SYNC).
 		cur_line.dirty = false;
+		cur_line.sector_dirty = 0;
 		cache[cache_address] = cur_line;
+		dirty_index.clear(cache_address / PAGE_SIZE);
 	}
 
 
 	void HybridSystem::syncAllCounter(uint64_t addr, Transaction trans)
 	{
-		//cout << "Processing SYNC_ALL_COUNTER " << addr << "\n";
-		uint64_t next_addr = addr + PAGE_SIZE;
-
-		//cout << "next_addr = " << next_addr << endl;
-		if (next_addr < (CACHE_PAGES * PAGE_SIZE))
+		// The SYNC_ALL_COUNTER transaction reaches the front of the queue once everything issued before the
+		// syncAll() has been processed. It then issues a SYNC for every page that is dirty at that point,
+		// so the cost of syncAll() depends on the amount of dirty data rather than the size of the cache.
+		// Victims still in the write-back buffer are dirty too. They go first.
+		sync_all_pages += writeback_buffer.size();
+		while (writeback_buffer.size() > 0)
 		{
-			// Issue SYNC_ALL_COUNTER transaction to next_addr.
-			// This is what iterates through all lines.
-			// Note: This must be done BEFORE the SYNC is added for the current line so 
-			// it is placed after the SYNC in the queue with add_front().
-			addSyncCounter(next_addr, false);
+			writeback_buffer_drain();
+			writeback_buffer_forced_drains++;
 		}
 
-		// Look up cache line.
-		if (cache.count(addr) == 0)
-		{
-			// If i is not allocated yet, allocate it.
-			cache[addr] = cache_line();
-		}
-		cache_line cur_line = cache[addr];
+		vector<uint64_t> dirty_pages;
+		dirty_index.pages(dirty_pages);
+		sync_all_pages += dirty_pages.size();
 
-		if (cur_line.valid && cur_line.dirty)
+		// addSync() puts each SYNC at the front of the queue, so go backwards to process them in order.
+		for (vector<uint64_t>::reverse_iterator it = dirty_pages.rbegin(); it != dirty_pages.rend(); ++it)
 		{
-			// Compute flash address.
-			uint64_t flash_addr = FLASH_ADDRESS(cur_line.tag, SET_INDEX(addr));
-
-			// Issue sync command for flash address.
-			addSync(flash_addr);
-			//cout << "Added sync for address " << flash_addr << endl;
+			uint64_t cache_addr = (*it) * PAGE_SIZE;
+			addSync(FLASH_ADDRESS(cache[cache_addr].tag, SET_INDEX(cache_addr)));
 		}
 
 		// Unlock the page and return.
@@ -1929,6 +3091,7 @@ namespace HybridSim {
 
 	void HybridSystem::syncAll()
 	{
+		sync_alls++;
 		addSyncCounter(0, true);
 	}
 
@@ -1955,9 +3118,10 @@ namespace HybridSim {
 				for (tlb_it = tlb_base_set.begin(); tlb_it != tlb_base_set.end(); tlb_it++)
 				{
 					uint64_t cur_ts = (*tlb_it).second;
-					if (cur_ts < tlb_victim_ts)
+					if ((cur_ts < tlb_victim_ts) || ((cur_ts == tlb_victim_ts) && ((*tlb_it).first < tlb_victim)))
 					{
-						// Found an older entry than the current victim.
+						// Found an older entry than the current victim (ties go to the lower address, so the
+						// choice doesn't depend on the hash table's iteration order).
 						tlb_victim = (*tlb_it).first;
 						tlb_victim_ts = cur_ts;
 					}
@@ -1996,133 +3160,218 @@ namespace HybridSim {
 		uint64_t prior_page = miss_page - PAGE_SIZE;
 		uint64_t next_page = miss_page + PAGE_SIZE;
 
-		// Look through the one miss table to see if there are any matches.
-		bool stream_detected = false;
-		list<pair<uint64_t, uint64_t> >::iterator it;
-		for (it=one_miss_table.begin(); it != one_miss_table.end(); it++)
+		// Somehow we managed to miss the same page twice in a short period of time.
+		// Remove the old entry so it can be readded as the newest one.
+		if (one_miss_table.contains(miss_page))
 		{
-			uint64_t entry_page = (*it).first;
-			//uint64_t entry_cycle = (*it).second;
+			one_miss_table.erase(miss_page);
 
-			if (entry_page == miss_page)
-			{
-				// Somehow we managed to miss the same page twice in a short period of time.
-				// Go ahead and remove this entry to make room for this to be readded.
-				it = one_miss_table.erase(it);
+			if (DEBUG_STREAM_BUFFER)
+				cerr << currentClockCycle << " : Stream buffer one miss double hit. miss_page=" << miss_page << "\n";
+		}
 
-				if (DEBUG_STREAM_BUFFER)
-					cerr << currentClockCycle << " : Stream buffer one miss double hit. miss_page=" << miss_page << "\n";
-			}
-			if (entry_page == prior_page)
+		uint64_t evicted;
+		if (one_miss_table.contains(prior_page))
+		{
+			// Stream detected!
+			if (DEBUG_STREAM_BUFFER)
+				cerr << currentClockCycle << " : New stream detected. Allocating stream buffer at addr " << next_page << "\n";
+
+			// Remove the entry for the prior page.
+			one_miss_table.erase(prior_page);
+
+			uint64_t length = STREAM_BUFFER_LENGTH;
+			if (ENABLE_PREFETCH_THROTTLE)
+				length = prefetch_throttle.scale(length);
+
+			// Save the next page in the stream buffer table, along with the last page prefetched for the stream.
+			// This is the address we will detect on a hit to the buffer.
+			// If all of the stream buffers are in use, the one that was advanced least recently is replaced.
+			if (stream_buffers.insert(next_page, miss_page + (length * PAGE_SIZE), evicted) && DEBUG_STREAM_BUFFER)
+				cerr << currentClockCycle << " : Stream buffer evicted addr=" << evicted << "\n";
+			unique_stream_buffers++;
+
+			// Issue prefetches to start the stream.
+			// Count down from the top address. This must be done because addPrefetch puts transactions at the front
+			// of the queue and we want page_addr+PAGE_SIZE to be the first prefetch issued.
+			for (uint64_t i=length; i > 0; i--)
 			{
-				// Stream detected!
-				stream_detected = true;
+				// Compute the next prefetch address.
+				uint64_t prefetch_address = miss_page + (i * PAGE_SIZE);
 
-				if (DEBUG_STREAM_BUFFER)
-					cerr << currentClockCycle << " : New stream detected. Allocating stream buffer at addr " << next_page << "\n";
-
-
-				// Remove the entry for the prior page.
-				it = one_miss_table.erase(it);
-
-				// Save the next page in the stream buffer table
-				// This is the address we will detect on a hit to the buffer.
-				stream_buffers[next_page] = currentClockCycle;
-				unique_stream_buffers++;
-
-				if (stream_buffers.size() > NUM_STREAM_BUFFERS)
-				{
-					// Evict stream buffer with oldest cycle.
-					unordered_map<uint64_t, uint64_t>::iterator sb_it;
-					uint64_t oldest_key = 0;
-					uint64_t oldest_cycle = currentClockCycle;
-					for (sb_it=stream_buffers.begin(); sb_it != stream_buffers.end(); sb_it++)
-					{
-						uint64_t cur_sb_cycle = (*sb_it).second;
-						if (cur_sb_cycle < oldest_cycle)
-						{
-							oldest_key = (*sb_it).first;
-							oldest_cycle = cur_sb_cycle;
-						}
-					}
-					stream_buffers.erase(oldest_key);
-
-					if (DEBUG_STREAM_BUFFER)
-						cerr << currentClockCycle << " : Stream buffer evicted addr=" << oldest_key << "\n";
-				}
-
-				// Issue prefetches to start the stream.
-				// Count down from the top address. This must be done because addPrefetch puts transactions at the front
-				// of the queue and we want page_addr+PAGE_SIZE to be the first prefetch issued.
-				for (int i=STREAM_BUFFER_LENGTH; i > 0; i--)
-				{
-					// Compute the next prefetch address.
-					uint64_t prefetch_address = miss_page + (i * PAGE_SIZE);
-
-					// If address is above the legal address space for the main memory, then do not issue this prefetch.
-					if (prefetch_address >= (TOTAL_PAGES * PAGE_SIZE))
-						continue;
-
-					// Add the prefetch.
-					addPrefetch(prefetch_address);
-				}
+				// If address is above the legal address space for the main memory, then do not issue this prefetch.
+				if (prefetch_address >= (TOTAL_PAGES * PAGE_SIZE))
+					continue;
 
-				break;
+				// Add the prefetch.
+				addPrefetch(prefetch_address);
 			}
 		}
-
-		if (!stream_detected)
+		else
 		{
-			// Insert miss address into the one_miss_table.
-			one_miss_table.push_back(make_pair(miss_page, currentClockCycle));
+			// Insert miss address into the one_miss_table (evicting the oldest miss if it is full).
+			if (one_miss_table.insert(miss_page, currentClockCycle, evicted) && DEBUG_STREAM_BUFFER)
+				cerr << currentClockCycle << " : One miss evicted addr=" << evicted << "\n";
 			unique_one_misses++;
 
 			if (DEBUG_STREAM_BUFFER)
 				cerr << currentClockCycle << " : One miss detected addr=" << miss_page << "\n";
 		}
-
-		// Enforce the size of the one miss table.
-		if (one_miss_table.size() > ONE_MISS_TABLE_SIZE)
-		{
-			if (DEBUG_STREAM_BUFFER)
-			{
-				cerr << currentClockCycle << " : One miss evicted addr=" << one_miss_table.front().first << "\n";
-			}
-
-			one_miss_table.pop_front();
-		}
-
 	}
 
 	void HybridSystem::stream_buffer_hit_handler(uint64_t hit_page)
 	{
-		if (stream_buffers.count(hit_page) == 1)
+		uint64_t *sb_prefetched = stream_buffers.find(hit_page);
+		if (sb_prefetched != NULL)
 		{
 			// Stream buffer hit!
 			stream_buffer_hits++;
 
+			uint64_t length = STREAM_BUFFER_LENGTH;
+			if (ENABLE_PREFETCH_THROTTLE)
+				length = prefetch_throttle.scale(length);
+
 			uint64_t next_page = hit_page + PAGE_SIZE;
-			uint64_t prefetch_address = hit_page + (STREAM_BUFFER_LENGTH * PAGE_SIZE);
+			uint64_t prefetch_address = hit_page + (length * PAGE_SIZE);
+			uint64_t prefetched = *sb_prefetched;
 
 			if ((DEBUG_STREAM_BUFFER==1) && (DEBUG_STREAM_BUFFER_HIT==1))
 			{
 				cerr << currentClockCycle << " : Stream Buffer Hit. hit_page=" << hit_page
-					<< " prior cycle=" << stream_buffers[hit_page] << " next_page=" << next_page 
+					<< " prefetched to=" << prefetched << " next_page=" << next_page 
 					<< " prefetch_addr=" << prefetch_address << "\n";
 			}
 
 			// Remove the current stream buffer entry and replace it with the next page.
 			stream_buffers.erase(hit_page);
 
-			// If the prefetch address is out of range, then do nothing.
+			// Prefetch the pages between the end of the stream buffer and prefetch_address (normally just
+			// prefetch_address, unless the throttle made the stream buffers longer). If the throttle made
+			// them shorter, the stream waits until it catches up.
+			// Count down from the top address, since addPrefetch puts transactions at the front of the queue.
+			for (uint64_t a = prefetch_address; (a > prefetched) && (a > hit_page); a -= PAGE_SIZE)
+			{
+				if (a < (TOTAL_PAGES * PAGE_SIZE))
+					addPrefetch(a);
+			}
+
+			// If the prefetch address is out of range, then the stream ends here.
 			if (prefetch_address < (TOTAL_PAGES * PAGE_SIZE))
 			{
-				// If it is in range, add the prefetch and readd the stream buffer.
-				addPrefetch(prefetch_address);
-				stream_buffers[next_page] = currentClockCycle;
+				uint64_t evicted;
+				stream_buffers.insert(next_page, max(prefetched, prefetch_address), evicted);
+			}
+		}
+
+	}
+
+	void HybridSystem::loadOracle(string tracefile)
+	{
+		oracle.load(tracefile);
+		oracle_loaded = true;
+		oracle_position.clear();
+
+		// Key the lines that are already valid (prefilled or restored) by the first use of their pages.
+		opt_next.assign(CACHE_PAGES, OPT_EVICT_FIRST);
+		for (uint64_t i=0; i < CACHE_PAGES; i++)
+		{
+			cache_line &line = cache.line(i);
+			if (line.valid)
+				opt_next[i] = oracle_peek(FLASH_ADDRESS(line.tag, i % NUM_SETS));
+		}
+
+		opt_queue.assign(NUM_SETS, priority_queue<pair<uint64_t, uint64_t> >());
+		for (uint64_t i=0; i < NUM_SETS; i++)
+			opt_rebuild(i);
+	}
+
+	uint64_t HybridSystem::oracle_peek(uint64_t page_addr)
+	{
+		// Position of the next access to this page (the current one if it hasn't been accessed yet).
+		uint64_t set_index = SET_INDEX(page_addr);
+		unordered_map<uint64_t, uint32_t>::iterator it = oracle_position.find(page_addr);
+		if (it == oracle_position.end())
+			return oracle.first_use(set_index, TAG(page_addr));
+		if (it->second == OracleTrace::NEVER)
+			return OracleTrace::NEVER;
+		return oracle.next_use(set_index, it->second);
+	}
+
+	uint64_t HybridSystem::oracle_access(uint64_t page_addr)
+	{
+		// Accesses are matched to the trace per page, so reordering between pages in the
+		// transaction queue does not throw the oracle off.
+		if (!oracle_loaded)
+		{
+			cerr << "ERROR: REPLACEMENT_POLICY=OPT but no oracle trace was loaded (set ORACLE_TRACE_FILE).\n";
+			abort();
+		}
+
+		uint64_t position = oracle_peek(page_addr);
+		oracle_position[page_addr] = position;
+		if (position == OracleTrace::NEVER)
+			return OracleTrace::NEVER;
+		return oracle.next_use(SET_INDEX(page_addr), position);
+	}
+
+	void HybridSystem::opt_update(uint64_t cache_addr, uint64_t next_use)
+	{
+		uint64_t set_index = SET_INDEX(cache_addr);
+		opt_next[cache_addr / PAGE_SIZE] = next_use;
+		opt_queue[set_index].push(make_pair(next_use, cache_addr));
+
+		if (opt_queue[set_index].size() > OPT_QUEUE_COMPACT * SET_SIZE)
+			opt_rebuild(set_index);
+	}
+
+	void HybridSystem::opt_rebuild(uint64_t set_index)
+	{
+		vector<pair<uint64_t, uint64_t> > entries(SET_SIZE);
+		for (uint64_t i=0; i < SET_SIZE; i++)
+		{
+			uint64_t cache_addr = (i * NUM_SETS + set_index) * PAGE_SIZE;
+			entries[i] = make_pair(opt_next[cache_addr / PAGE_SIZE], cache_addr);
+		}
+		opt_queue[set_index] = priority_queue<pair<uint64_t, uint64_t> >(entries.begin(), entries.end());
+	}
+
+	uint64_t HybridSystem::opt_victim(uint64_t set_index)
+	{
+		if (!oracle_loaded)
+		{
+			cerr << "ERROR: REPLACEMENT_POLICY=OPT but no oracle trace was loaded (set ORACLE_TRACE_FILE).\n";
+			abort();
+		}
+
+		// If every line is locked, fall back to the first line in the set like LRU does.
+		uint64_t victim = set_index * PAGE_SIZE;
+		priority_queue<pair<uint64_t, uint64_t> > &queue = opt_queue[set_index];
+		vector<pair<uint64_t, uint64_t> > locked;
+		while (!queue.empty())
+		{
+			pair<uint64_t, uint64_t> top = queue.top();
+			queue.pop();
+
+			// Skip stale entries.
+			if (top.first != opt_next[top.second / PAGE_SIZE])
+				continue;
+
+			// Locked lines can't be evicted now, but keep them for later misses.
+			if (cache[top.second].locked)
+			{
+				locked.push_back(top);
+				continue;
 			}
+
+			// The victim is rekeyed by opt_update() right after this, so its entry is not put back.
+			victim = top.second;
+			break;
 		}
 
+		for (uint64_t i=0; i < locked.size(); i++)
+			queue.push(locked[i]);
+
+		return victim;
 	}
 
 
@@ -34,12 +34,25 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <queue>
 
 #include "config.h"
 #include "util.h"
 #include "CallbackHybrid.h"
 #include "Logger.h"
 #include "IniReader.h"
+#include "TraceFile.h"
+#include "Profiler.h"
+#include "MemoryBackend.h"
+#include "CacheTable.h"
+#include "Checkpoint.h"
+#include "PrefetchSchedule.h"
+#include "OracleTrace.h"
+#include "LRUTable.h"
+#include "DirtyIndex.h"
+#include "StridePrefetcher.h"
+#include "PrefetchThrottle.h"
+#include "BackendQueue.h"
 
 using std::string;
 typedef unsigned int uint;
@@ -65,9 +78,9 @@ namespace HybridSim
 		void DRAMReadCallback(uint id, uint64_t addr, uint64_t cycle);
 		void DRAMWriteCallback(uint id, uint64_t addr, uint64_t cycle);
 		void DRAMPowerCallback(double a, double b, double c, double d);
-		void FlashReadCallback(uint id, uint64_t addr, uint64_t cycle, bool unmapped);
-		void FlashCriticalLineCallback(uint id, uint64_t addr, uint64_t cycle, bool unmapped);
-		void FlashWriteCallback(uint id, uint64_t addr, uint64_t cycle, bool unmapped);
+		void FlashReadCallback(uint id, uint64_t addr, uint64_t cycle);
+		void FlashCriticalLineCallback(uint id, uint64_t addr, uint64_t cycle);
+		void FlashWriteCallback(uint id, uint64_t addr, uint64_t cycle);
 
 		// Functions to run the callbacks to the module using HybridSim.
 		void ReadDoneCallback(uint systemID, uint64_t orig_addr, uint64_t cycle);
@@ -83,19 +96,50 @@ namespace HybridSim
 		void restoreCacheTable();
 		void saveCacheTable();
 
+		// Full system checkpoint functions (cache table plus all in-flight state).
+		// A restored system continues exactly as the saved one would have.
+		void saveSystemState(string filename);
+		void restoreSystemState(string filename);
+		void saveSystemState(StateWriter &w);
+		void restoreSystemState(StateReader &r);
+
+		// Apply the settings in inifile on top of the current ones (e.g. after a shared warmup).
+		// Only settings that can change mid-run are allowed; the geometry and the backends must stay the same.
+		void reconfigure(string inifile);
+
+		// Validate SECTOR_SIZE and SECTOR_FILL.
+		void check_sector_config();
+
+		// Validate BACKEND_QUEUE_POLICY and apply it to the DRAM and flash queues.
+		void set_backend_queue_policy();
+
+		// Validate the WRITEBACK_BUFFER_* settings and resize the write-back buffer.
+		void set_writeback_buffer_size();
+
+		// Validate EAGER_CLEAN_THRESHOLD and compute the number of dirty pages allowed.
+		void set_eager_cleaning();
+
 
 		// Helper functions
 		void ProcessTransaction(Transaction &trans);
+		void note_data_access(Transaction &trans, uint64_t set_index, bool hit);
 
 		void VictimRead(Pending p);
 		void VictimReadFinish(uint64_t addr, Pending p);
 
 		void VictimWrite(Pending p);
+		void VictimWriteIssue(uint64_t victim_flash_addr, uint32_t sectors);
 
-		void LineRead(Pending p);
+		void LineRead(Pending p, uint32_t buffered_sectors);
 		void LineReadFinish(uint64_t addr, Pending p);
 
 		void LineWrite(Pending p);
+		void FillLineWrite(uint64_t addr, QueueClass queue_class);
+
+		void SectorRead(Pending p);
+		void SectorReadFinish(uint64_t addr, Pending p);
+		void FlashSectorRead(uint64_t page_addr, uint32_t sectors, QueueClass queue_class);
+		void BufferSectorRead(uint64_t page_addr, uint32_t sectors);
 
 		void CacheRead(uint64_t orig_addr, uint64_t flash_addr, uint64_t cache_addr);
 		void CacheReadFinish(uint64_t addr, Pending p);
@@ -112,6 +156,7 @@ namespace HybridSim
 		void contention_unlock(uint64_t flash_addr, uint64_t orig_addr, string operation, bool victim_valid, uint64_t victim_page, 
 				bool cache_line_valid, uint64_t cache_addr);
 		bool contention_is_unlocked(uint64_t flash_addr);
+		bool contention_is_cached(uint64_t page_addr);
 		void contention_increment(uint64_t flash_addr);
 		void contention_decrement(uint64_t flash_addr);
 		void contention_victim_lock(uint64_t page_addr);
@@ -122,6 +167,7 @@ namespace HybridSim
 
 		// Prefetch Functions
 		void issue_sequential_prefetches(uint64_t page_addr);
+		void issue_stride_prefetches(uint64_t page_addr);
 
 		// Sync functions
 		void sync(uint64_t addr, uint64_t cache_address, Transaction trans);
@@ -132,9 +178,27 @@ namespace HybridSim
 		// TLB functions
 		void check_tlb(uint64_t page_addr);
 
+		// Write-back buffer functions
+		void writeback_buffer_drain();
+
+		// Eager cleaning functions
+		bool eager_clean();
+
+		// Miss merging functions
+		bool merge_secondary_miss(Transaction &trans);
+		void finish_merged_accesses(uint64_t page_addr, uint64_t burst_addr);
+
 		// Stream Buffer Functions
 		void stream_buffer_miss_handler(uint64_t miss_page);
 		void stream_buffer_hit_handler(uint64_t hit_page);
+
+		// OPT replacement functions
+		void loadOracle(string tracefile);
+		uint64_t oracle_peek(uint64_t page_addr);
+		uint64_t oracle_access(uint64_t page_addr);
+		void opt_update(uint64_t cache_addr, uint64_t next_use);
+		void opt_rebuild(uint64_t set_index);
+		uint64_t opt_victim(uint64_t set_index);
 		
 
 		// State
@@ -145,11 +209,11 @@ namespace HybridSim
 		TransactionCompleteCB *WriteDone;
 		uint systemID;
 
-		DRAMSim::MultiChannelMemorySystem *dram;
+		MemoryBackend *dram;
 
-		NVDSim::NVDIMM *flash;
+		MemoryBackend *flash;
 
-		unordered_map<uint64_t, cache_line> cache;
+		CacheTable cache;
 
 		unordered_map<uint64_t, Pending> dram_pending;
 		unordered_map<uint64_t, Pending> flash_pending;
@@ -161,7 +225,7 @@ namespace HybridSim
 		
 		unordered_map<uint64_t, uint64_t> pending_flash_addr; // If a page is in the pending_flash_addr , then skip subsequent transactions to the flash address.
 		unordered_map<uint64_t, uint64_t> pending_pages; // If a page is in the pending_pages, then skip subsequent transactions to the page.
-		unordered_map<uint64_t, uint64_t> set_counter; // Counts the number of outstanding transactions to each set.
+		unordered_map<uint64_t, uint64_t> set_counter; // Counts the number of locked lines in each set.
 
 		bool check_queue; // If there is nothing to do, don't check the queue until the next event occurs that will make new work.
 
@@ -177,25 +241,27 @@ namespace HybridSim
 		uint64_t trans_queue_max;
 		uint64_t trans_queue_size;
 
+		// Admission control (INPUT_QUEUE_DEPTH > 0).
+		uint64_t accepted_accesses; // Accesses accepted by addTransaction() that have not completed yet.
+		uint64_t accepted_accesses_max;
+		uint64_t rejected_accesses; // addTransaction() calls that returned false.
+
 		list<Transaction> trans_queue; // Entry queue for the cache controller.
-		list<Transaction> dram_queue; // Buffer to wait for DRAM
-		list<Transaction> flash_queue; // Buffer to wait for Flash
+		BackendQueue dram_queue; // Buffer to wait for DRAM
+		BackendQueue flash_queue; // Buffer to wait for Flash
 
 		// Logger is used to store HybridSim-specific logging events.
 		Logger log;
 
-		// Prefetch data stores the prefetch sets from the prefetch file.
-		// This is stored as a map of lists. It could be stored more compactly as an array of pointers to pointers,
-		// but I chose not to since random access is not needed and this makes the code simpler.
-		// If space becomes a problem, I'm just going to switch this to loading the data from a file per set at runtime.
-		unordered_map<uint64_t, list<uint64_t>> prefetch_access_number;
-		unordered_map<uint64_t, list<uint64_t>> prefetch_flush_addr;
-		unordered_map<uint64_t, list<uint64_t>> prefetch_new_addr;
-		unordered_map<uint64_t, uint64_t> prefetch_counter;
+		// Profiler measures the host time spent in each phase of update().
+		Profiler profiler;
+
+		// Perfect prefetching schedule (mmapped from PREFETCH_FILE, consumed with a cursor per set).
+		PrefetchSchedule prefetch_schedule;
 
 		ofstream debug_victim;
-		ofstream debug_nvdimm_trace;
-		ofstream debug_full_trace;
+		TraceWriter debug_nvdimm_trace;
+		TraceWriter debug_full_trace;
 
 		// TLB state
 		unordered_map<uint64_t, uint64_t> tlb_base_set; 
@@ -207,16 +273,86 @@ namespace HybridSim
 		uint64_t unused_prefetches; // Count of unused prefetched pages in the DRAM cache.
 		uint64_t unused_prefetch_victims; // Count of unused prefetched pages that were never used before being evicted.
 		uint64_t prefetch_hit_nops; // Count the number of prefetch hits that are nops.
+		uint64_t demand_misses; // Count of data accesses that missed (for prefetch coverage).
 
 		// Stream buffer state.
-		list<pair<uint64_t, uint64_t> > one_miss_table; // pair is (address, cycle)
-		unordered_map<uint64_t, uint64_t> stream_buffers; // address -> cycle
+		LRUTable one_miss_table; // page -> cycle of the miss
+		LRUTable stream_buffers; // next page expected in each stream -> last page prefetched for it
 
 		// Stream buffer tracking.
 		uint64_t unique_one_misses;
 		uint64_t unique_stream_buffers;
 		uint64_t stream_buffer_hits;
 
+		// Sectored caching state (SECTOR_SIZE > 0).
+		unordered_set<uint64_t> sector_fill_pages; // pages with a SECTOR_READ in flight
+
+		// NVM traffic tracking.
+		uint64_t data_accesses;
+		uint64_t nvm_bytes_read;
+		uint64_t nvm_bytes_written;
+		uint64_t sector_misses; // hits to a page whose accessed sector was not in the DRAM
+
+		// Dirty page state.
+		DirtyIndex dirty_index; // dirty pages that are not already being written back
+		uint64_t sync_alls;
+		uint64_t sync_all_pages; // SYNCs issued by syncAll()
+		uint64_t syncs_written; // SYNCs that wrote a dirty page back
+		uint64_t syncs_clean; // SYNCs that found their page already clean or evicted
+		uint64_t dirty_pages_max;
+
+		// Eager cleaning state (EAGER_CLEAN_THRESHOLD < 1).
+		uint64_t eager_clean_limit; // clean while more pages than this are dirty
+		uint64_t eager_clean_set; // next set to look for a dirty page in
+		bool eager_clean_active; // a page is being read out of the DRAM to be cleaned
+		uint64_t eager_clean_addr; // its cache address
+		uint64_t eager_cleans;
+
+		// Fill buffer state (DRAM_CRITICAL_LINE_FIRST).
+		unordered_map<uint64_t, uint64_t> fill_lines; // DRAM line with a LINE_WRITE in flight -> writes to it left until that one is done
+		unordered_map<uint64_t, uint64_t> fill_waiting; // DRAM line -> class of its LINE_WRITE, waiting for the line's victim read
+		unordered_map<uint64_t, uint64_t> dram_writes; // DRAM line -> writes queued or in flight
+		list<pair<uint64_t, uint64_t> > fill_buffer_reads; // (cycle it is done, DRAM line address), oldest first
+		uint64_t fill_buffer_hits; // reads served from the fill buffer
+		uint64_t fill_writes_deferred; // LINE_WRITE lines that waited for their victim read
+
+		// Miss merging state (MSHR_TARGETS > 0).
+		unordered_map<uint64_t, list<Transaction> > merged_accesses; // page being filled -> accesses waiting for their lines
+		unordered_map<uint64_t, uint32_t> merged_pages; // page being filled -> sectors written by merged accesses
+		unordered_set<uint64_t> merge_blocked_pages; // pages with an access left in the queue during this scan
+		uint64_t merged_reads;
+		uint64_t merged_writes;
+
+		// Write-back buffer state (WRITEBACK_BUFFER_SIZE > 0).
+		// Dirty victims of misses wait here, oldest first, after being read out of the DRAM.
+		LRUTable writeback_buffer; // victim flash page -> its dirty sectors
+		uint64_t writeback_buffer_inserts;
+		uint64_t writeback_buffer_idle_drains; // pages written out while the NVM was idle
+		uint64_t writeback_buffer_forced_drains; // pages written out at the high watermark or to make room
+		uint64_t writeback_buffer_hits; // misses that read their page back out of the buffer
+		uint64_t writeback_buffer_max;
+		unordered_map<uint64_t, uint32_t> buffered_fills; // page being filled -> sectors read from the buffer
+		list<pair<uint64_t, uint64_t> > buffer_reads; // (cycle it is done, line address), oldest first
+
+		// Stride prefetcher state (ENABLE_STRIDE_PREFETCHER).
+		StridePrefetcher stride_prefetcher;
+		vector<uint64_t> stride_prefetches; // scratch space for issue_stride_prefetches
+
+		// Prefetch throttling state (ENABLE_PREFETCH_THROTTLE).
+		PrefetchThrottle prefetch_throttle;
+
+		// OPT replacement state (REPLACEMENT_POLICY=OPT).
+		// Every cache line is keyed by the next use of the page it holds, as a position in its set's access
+		// sequence in the oracle trace. Invalid and flushed lines have the key OPT_EVICT_FIRST. Each set has a
+		// max-heap of (key, cache address) entries; entries whose key no longer matches the line are stale and
+		// skipped when picking a victim.
+		bool opt_replacement;
+		bool oracle_loaded;
+		OracleTrace oracle;
+		unordered_map<uint64_t, uint32_t> oracle_position; // page -> position of its latest access in its set
+		vector<uint64_t> opt_next; // key of each cache page
+		vector<priority_queue<pair<uint64_t, uint64_t> > > opt_queue; // per set
+
 	};
 
 	HybridSystem *getMemorySystemInstance(uint id, string ini);
@@ -43,6 +43,11 @@ uint64_t ENABLE_LOGGER = 1;
 uint64_t EPOCH_LENGTH = 200000;
 uint64_t HISTOGRAM_BIN = 100;
 uint64_t HISTOGRAM_MAX = 20000;
+uint64_t ENABLE_TEXT_STATS = 1;
+uint64_t ENABLE_JSON_STATS = 0;
+uint64_t ENABLE_CSV_STATS = 0;
+uint64_t ENABLE_PROFILER = 0;
+uint64_t PROFILER_SAMPLE_PERIOD = 1;
 
 // these values are also specified in the ini file of the nvdimm but have a different name
 uint64_t PAGE_SIZE = 4096; // in bytes, so divide this by 64 to get the number of DDR3 transfers per page
@@ -58,6 +63,51 @@ uint64_t FLASH_BURST_SIZE = 4096; // number of bytes in a single flash transacti
 uint64_t TOTAL_PAGES = 2097152/4; // 2 GB
 uint64_t CACHE_PAGES = 1048576/4; // 1 GB
 
+// Replacement policy
+string REPLACEMENT_POLICY = "LRU";
+string ORACLE_TRACE_FILE = "none";
+
+// Stream buffer prefetcher
+uint64_t ONE_MISS_TABLE_SIZE = 10;
+uint64_t NUM_STREAM_BUFFERS = 10;
+uint64_t STREAM_BUFFER_LENGTH = 4;
+
+// Stride prefetcher
+uint64_t STRIDE_NUM_STREAMS = 16;
+uint64_t STRIDE_MAX_DISTANCE = 16;
+uint64_t STRIDE_CONFIDENCE_THRESHOLD = 2;
+uint64_t STRIDE_MIN_DEPTH = 1;
+uint64_t STRIDE_MAX_DEPTH = 8;
+
+// Prefetch throttling
+uint64_t PREFETCH_THROTTLE_EPOCH = 1000000;
+double PREFETCH_ACCURACY_HIGH = 0.75;
+double PREFETCH_ACCURACY_LOW = 0.40;
+double PREFETCH_LATENESS_THRESHOLD = 0.01;
+double PREFETCH_POLLUTION_THRESHOLD = 0.005;
+uint64_t PREFETCH_POLLUTION_FILTER_SIZE = 4096;
+
+// Sectored caching
+uint64_t SECTOR_SIZE = 0;
+string SECTOR_FILL = "DEMAND";
+
+// Write-back buffer
+uint64_t WRITEBACK_BUFFER_SIZE = 0;
+uint64_t WRITEBACK_BUFFER_HIGH_WATERMARK = 12;
+uint64_t BUFFER_READ_DELAY = 10;
+
+// Eager cleaning
+double EAGER_CLEAN_THRESHOLD = 1.0;
+
+// DRAM critical line first
+uint64_t DRAM_CRITICAL_LINE_FIRST = 0;
+
+// Miss merging
+uint64_t MSHR_TARGETS = 0;
+
+// Admission control
+uint64_t INPUT_QUEUE_DEPTH = 0;
+
 
 // Defined in marss memoryHierachy.cpp.
 // Need to confirm this and make it more flexible later.
@@ -68,6 +118,29 @@ string dram_ini = "ini/DDR3_micron_8M_8B_x8_sg15.ini";
 string flash_ini = "ini/samsung_K9XXG08UXM(mod).ini";
 string sys_ini = "ini/system.ini";
 
+// Memory backends
+string DRAM_BACKEND = "dramsim2";
+string FLASH_BACKEND = "nvdimmsim";
+
+// Backend queue order
+string BACKEND_QUEUE_POLICY = "FIFO";
+uint64_t QUEUE_STARVATION_LIMIT = 50000;
+
+// Simple backend parameters (defaults approximate the DDR3-1333 and NVDIMM ini files at 667 MHz)
+uint64_t DRAM_SIMPLE_READ_LATENCY = 24; // tRCD + CL + BL/2
+uint64_t DRAM_SIMPLE_WRITE_LATENCY = 14; // WL + BL/2
+uint64_t DRAM_SIMPLE_QUEUE_DEPTH = 512;
+uint64_t DRAM_SIMPLE_BUS_CYCLES = 4; // BL/2
+uint64_t DRAM_SIMPLE_NUM_BANKS = 8;
+uint64_t DRAM_SIMPLE_BANK_CYCLES = 34; // tRC
+uint64_t FLASH_SIMPLE_READ_LATENCY = 16678;
+uint64_t FLASH_SIMPLE_WRITE_LATENCY = 133420;
+uint64_t FLASH_SIMPLE_QUEUE_DEPTH = 512;
+uint64_t FLASH_SIMPLE_BUS_CYCLES = 171; // 4 KB page over a 32 bit 4 GHz channel
+uint64_t FLASH_SIMPLE_NUM_BANKS = 16;
+uint64_t FLASH_SIMPLE_BANK_CYCLES = 0; // busy for the read/write time
+uint64_t FLASH_SIMPLE_CRIT_LINE_FIRST = 0;
+
 // Save/Restore options
 uint64_t ENABLE_RESTORE = 0;
 uint64_t ENABLE_SAVE = 0;
@@ -138,6 +211,16 @@ string NVDIMM_SAVE_FILE = "none";
 				convert_uint64_t(HISTOGRAM_BIN, value, key);
 			else if (key.compare("HISTOGRAM_MAX") == 0)
 				convert_uint64_t(HISTOGRAM_MAX, value, key);
+			else if (key.compare("ENABLE_TEXT_STATS") == 0)
+				convert_uint64_t(ENABLE_TEXT_STATS, value, key);
+			else if (key.compare("ENABLE_JSON_STATS") == 0)
+				convert_uint64_t(ENABLE_JSON_STATS, value, key);
+			else if (key.compare("ENABLE_CSV_STATS") == 0)
+				convert_uint64_t(ENABLE_CSV_STATS, value, key);
+			else if (key.compare("ENABLE_PROFILER") == 0)
+				convert_uint64_t(ENABLE_PROFILER, value, key);
+			else if (key.compare("PROFILER_SAMPLE_PERIOD") == 0)
+				convert_uint64_t(PROFILER_SAMPLE_PERIOD, value, key);
 			else if (key.compare("PAGE_SIZE") == 0)
 				convert_uint64_t(PAGE_SIZE, value, key);
 			else if (key.compare("SET_SIZE") == 0)
@@ -158,6 +241,90 @@ string NVDIMM_SAVE_FILE = "none";
 				flash_ini = value;
 			else if (key.compare("sys_ini") == 0)
 				sys_ini = value;
+			else if (key.compare("DRAM_BACKEND") == 0)
+				DRAM_BACKEND = value;
+			else if (key.compare("FLASH_BACKEND") == 0)
+				FLASH_BACKEND = value;
+			else if (key.compare("BACKEND_QUEUE_POLICY") == 0)
+				BACKEND_QUEUE_POLICY = value;
+			else if (key.compare("QUEUE_STARVATION_LIMIT") == 0)
+				convert_uint64_t(QUEUE_STARVATION_LIMIT, value, key);
+			else if (key.compare("DRAM_SIMPLE_READ_LATENCY") == 0)
+				convert_uint64_t(DRAM_SIMPLE_READ_LATENCY, value, key);
+			else if (key.compare("DRAM_SIMPLE_WRITE_LATENCY") == 0)
+				convert_uint64_t(DRAM_SIMPLE_WRITE_LATENCY, value, key);
+			else if (key.compare("DRAM_SIMPLE_QUEUE_DEPTH") == 0)
+				convert_uint64_t(DRAM_SIMPLE_QUEUE_DEPTH, value, key);
+			else if (key.compare("DRAM_SIMPLE_BUS_CYCLES") == 0)
+				convert_uint64_t(DRAM_SIMPLE_BUS_CYCLES, value, key);
+			else if (key.compare("DRAM_SIMPLE_NUM_BANKS") == 0)
+				convert_uint64_t(DRAM_SIMPLE_NUM_BANKS, value, key);
+			else if (key.compare("DRAM_SIMPLE_BANK_CYCLES") == 0)
+				convert_uint64_t(DRAM_SIMPLE_BANK_CYCLES, value, key);
+			else if (key.compare("FLASH_SIMPLE_READ_LATENCY") == 0)
+				convert_uint64_t(FLASH_SIMPLE_READ_LATENCY, value, key);
+			else if (key.compare("FLASH_SIMPLE_WRITE_LATENCY") == 0)
+				convert_uint64_t(FLASH_SIMPLE_WRITE_LATENCY, value, key);
+			else if (key.compare("FLASH_SIMPLE_QUEUE_DEPTH") == 0)
+				convert_uint64_t(FLASH_SIMPLE_QUEUE_DEPTH, value, key);
+			else if (key.compare("FLASH_SIMPLE_BUS_CYCLES") == 0)
+				convert_uint64_t(FLASH_SIMPLE_BUS_CYCLES, value, key);
+			else if (key.compare("FLASH_SIMPLE_NUM_BANKS") == 0)
+				convert_uint64_t(FLASH_SIMPLE_NUM_BANKS, value, key);
+			else if (key.compare("FLASH_SIMPLE_BANK_CYCLES") == 0)
+				convert_uint64_t(FLASH_SIMPLE_BANK_CYCLES, value, key);
+			else if (key.compare("FLASH_SIMPLE_CRIT_LINE_FIRST") == 0)
+				convert_uint64_t(FLASH_SIMPLE_CRIT_LINE_FIRST, value, key);
+			else if (key.compare("REPLACEMENT_POLICY") == 0)
+				REPLACEMENT_POLICY = value;
+			else if (key.compare("ORACLE_TRACE_FILE") == 0)
+				ORACLE_TRACE_FILE = value;
+			else if (key.compare("ONE_MISS_TABLE_SIZE") == 0)
+				convert_uint64_t(ONE_MISS_TABLE_SIZE, value, key);
+			else if (key.compare("NUM_STREAM_BUFFERS") == 0)
+				convert_uint64_t(NUM_STREAM_BUFFERS, value, key);
+			else if (key.compare("STREAM_BUFFER_LENGTH") == 0)
+				convert_uint64_t(STREAM_BUFFER_LENGTH, value, key);
+			else if (key.compare("STRIDE_NUM_STREAMS") == 0)
+				convert_uint64_t(STRIDE_NUM_STREAMS, value, key);
+			else if (key.compare("STRIDE_MAX_DISTANCE") == 0)
+				convert_uint64_t(STRIDE_MAX_DISTANCE, value, key);
+			else if (key.compare("STRIDE_CONFIDENCE_THRESHOLD") == 0)
+				convert_uint64_t(STRIDE_CONFIDENCE_THRESHOLD, value, key);
+			else if (key.compare("STRIDE_MIN_DEPTH") == 0)
+				convert_uint64_t(STRIDE_MIN_DEPTH, value, key);
+			else if (key.compare("STRIDE_MAX_DEPTH") == 0)
+				convert_uint64_t(STRIDE_MAX_DEPTH, value, key);
+			else if (key.compare("PREFETCH_THROTTLE_EPOCH") == 0)
+				convert_uint64_t(PREFETCH_THROTTLE_EPOCH, value, key);
+			else if (key.compare("PREFETCH_ACCURACY_HIGH") == 0)
+				convert_double(PREFETCH_ACCURACY_HIGH, value, key);
+			else if (key.compare("PREFETCH_ACCURACY_LOW") == 0)
+				convert_double(PREFETCH_ACCURACY_LOW, value, key);
+			else if (key.compare("PREFETCH_LATENESS_THRESHOLD") == 0)
+				convert_double(PREFETCH_LATENESS_THRESHOLD, value, key);
+			else if (key.compare("PREFETCH_POLLUTION_THRESHOLD") == 0)
+				convert_double(PREFETCH_POLLUTION_THRESHOLD, value, key);
+			else if (key.compare("PREFETCH_POLLUTION_FILTER_SIZE") == 0)
+				convert_uint64_t(PREFETCH_POLLUTION_FILTER_SIZE, value, key);
+			else if (key.compare("SECTOR_SIZE") == 0)
+				convert_uint64_t(SECTOR_SIZE, value, key);
+			else if (key.compare("SECTOR_FILL") == 0)
+				SECTOR_FILL = value;
+			else if (key.compare("WRITEBACK_BUFFER_SIZE") == 0)
+				convert_uint64_t(WRITEBACK_BUFFER_SIZE, value, key);
+			else if (key.compare("WRITEBACK_BUFFER_HIGH_WATERMARK") == 0)
+				convert_uint64_t(WRITEBACK_BUFFER_HIGH_WATERMARK, value, key);
+			else if (key.compare("BUFFER_READ_DELAY") == 0)
+				convert_uint64_t(BUFFER_READ_DELAY, value, key);
+			else if (key.compare("EAGER_CLEAN_THRESHOLD") == 0)
+				convert_double(EAGER_CLEAN_THRESHOLD, value, key);
+			else if (key.compare("DRAM_CRITICAL_LINE_FIRST") == 0)
+				convert_uint64_t(DRAM_CRITICAL_LINE_FIRST, value, key);
+			else if (key.compare("MSHR_TARGETS") == 0)
+				convert_uint64_t(MSHR_TARGETS, value, key);
+			else if (key.compare("INPUT_QUEUE_DEPTH") == 0)
+				convert_uint64_t(INPUT_QUEUE_DEPTH, value, key);
 			else if (key.compare("ENABLE_RESTORE") == 0)
 				convert_uint64_t(ENABLE_RESTORE, value, key);
 			else if (key.compare("ENABLE_SAVE") == 0)
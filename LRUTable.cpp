@@ -0,0 +1,166 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "LRUTable.h"
+
+#include <cstddef>
+
+using namespace std;
+
+namespace HybridSim
+{
+	const uint64_t LRU_TABLE_NONE = (uint64_t) 18446744073709551615U;
+
+	LRUTable::LRUTable()
+	{
+		init(0);
+	}
+
+	void LRUTable::init(uint64_t capacity)
+	{
+		nodes.assign(capacity + 1, Node());
+		nodes[0].prev = 0;
+		nodes[0].next = 0;
+
+		free_list = LRU_TABLE_NONE;
+		for (uint64_t n=capacity; n > 0; n--)
+		{
+			nodes[n].next = free_list;
+			free_list = n;
+		}
+
+		index.clear();
+		index.reserve(capacity);
+	}
+
+	void LRUTable::set_capacity(uint64_t capacity)
+	{
+		vector<pair<uint64_t, uint64_t> > old;
+		entries(old);
+
+		// Keep the newest entries that fit.
+		init(capacity);
+		uint64_t first = (old.size() > capacity) ? old.size() - capacity : 0;
+		uint64_t evicted;
+		for (uint64_t i=first; i < old.size(); i++)
+			insert(old[i].first, old[i].second, evicted);
+	}
+
+	uint64_t *LRUTable::find(uint64_t key)
+	{
+		unordered_map<uint64_t, uint64_t>::iterator it = index.find(key);
+		if (it == index.end())
+			return NULL;
+		return &nodes[it->second].value;
+	}
+
+	bool LRUTable::insert(uint64_t key, uint64_t value, uint64_t &evicted_key)
+	{
+		unordered_map<uint64_t, uint64_t>::iterator it = index.find(key);
+		if (it != index.end())
+		{
+			// Already there, so just make it the newest entry.
+			uint64_t n = it->second;
+			nodes[n].value = value;
+			unlink(n);
+			link_newest(n);
+			return false;
+		}
+
+		if (capacity() == 0)
+			return false;
+
+		bool evicted = false;
+		if (free_list == LRU_TABLE_NONE)
+		{
+			evicted_key = nodes[nodes[0].next].key;
+			evict_oldest();
+			evicted = true;
+		}
+
+		uint64_t n = free_list;
+		free_list = nodes[n].next;
+		nodes[n].key = key;
+		nodes[n].value = value;
+		link_newest(n);
+		index[key] = n;
+
+		return evicted;
+	}
+
+	void LRUTable::erase(uint64_t key)
+	{
+		unordered_map<uint64_t, uint64_t>::iterator it = index.find(key);
+		if (it == index.end())
+			return;
+
+		uint64_t n = it->second;
+		index.erase(it);
+		unlink(n);
+		nodes[n].next = free_list;
+		free_list = n;
+	}
+
+	bool LRUTable::oldest(uint64_t &key, uint64_t &value) const
+	{
+		if (index.empty())
+			return false;
+
+		key = nodes[nodes[0].next].key;
+		value = nodes[nodes[0].next].value;
+		return true;
+	}
+
+	void LRUTable::entries(vector<pair<uint64_t, uint64_t> > &out) const
+	{
+		out.clear();
+		for (uint64_t n=nodes[0].next; n != 0; n = nodes[n].next)
+			out.push_back(make_pair(nodes[n].key, nodes[n].value));
+	}
+
+	void LRUTable::unlink(uint64_t n)
+	{
+		nodes[nodes[n].prev].next = nodes[n].next;
+		nodes[nodes[n].next].prev = nodes[n].prev;
+	}
+
+	void LRUTable::link_newest(uint64_t n)
+	{
+		nodes[n].prev = nodes[0].prev;
+		nodes[n].next = 0;
+		nodes[nodes[0].prev].next = n;
+		nodes[0].prev = n;
+	}
+
+	void LRUTable::evict_oldest()
+	{
+		erase(nodes[nodes[0].next].key);
+	}
+}
@@ -0,0 +1,100 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_LRUTABLE_H
+#define HYBRIDSIM_LRUTABLE_H
+
+// Fixed capacity table of (key, value) entries kept in insertion order, oldest first.
+//
+// The entries live in a preallocated node array linked into a list, with a hash index from key to node, so
+// lookups, inserts, erases and evicting the oldest entry are all O(1) and nothing is allocated per entry
+// after init(). Used for the stream buffer tables (the one miss table and the stream buffers) and the
+// write-back buffer.
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+using namespace std;
+
+namespace HybridSim
+{
+	class LRUTable
+	{
+		public:
+		LRUTable();
+
+		// Empty the table and set its capacity.
+		void init(uint64_t capacity);
+
+		// Change the capacity, evicting the oldest entries if the table no longer fits.
+		void set_capacity(uint64_t capacity);
+
+		uint64_t size() const { return index.size(); }
+		uint64_t capacity() const { return nodes.size() - 1; }
+		bool contains(uint64_t key) const { return index.count(key) != 0; }
+
+		// Returns the value for key, or NULL if key is not in the table.
+		uint64_t *find(uint64_t key);
+
+		// Insert key (or update it if it is already there) as the newest entry. If the table is full, the
+		// oldest entry is evicted first. Returns true if an entry was evicted and sets evicted_key to it.
+		bool insert(uint64_t key, uint64_t value, uint64_t &evicted_key);
+
+		void erase(uint64_t key);
+
+		// Sets key and value to the oldest entry. Returns false if the table is empty.
+		bool oldest(uint64_t &key, uint64_t &value) const;
+
+		// The entries from oldest to newest (for checkpoints and debug output).
+		void entries(vector<pair<uint64_t, uint64_t> > &out) const;
+
+		private:
+		struct Node
+		{
+			uint64_t key;
+			uint64_t value;
+			uint64_t prev;
+			uint64_t next;
+		};
+
+		void unlink(uint64_t n);
+		void link_newest(uint64_t n);
+		void evict_oldest();
+
+		// nodes[0] is the list head: its next is the oldest entry and its prev the newest.
+		// Unused nodes are chained through next starting at free_list.
+		vector<Node> nodes;
+		uint64_t free_list;
+		unordered_map<uint64_t, uint64_t> index; // key -> node
+	};
+}
+
+#endif
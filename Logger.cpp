@@ -82,6 +82,16 @@ namespace HybridSim
 		num_mmio_dropped = 0;
 		num_mmio_remapped = 0;
 
+		for (uint64_t d = 0; d < 2; d++)
+		{
+			for (uint64_t c = 0; c < NUM_QUEUE_CLASSES; c++)
+			{
+				backend_queue_count[d][c] = 0;
+				backend_queue_sum[d][c] = 0;
+				backend_queue_max[d][c] = 0;
+			}
+		}
+
 
 		// Init the latency histogram.
 		for (uint64_t i = 0; i <= HISTOGRAM_MAX; i += HISTOGRAM_BIN)
@@ -331,6 +341,14 @@ namespace HybridSim
 		cur_num_mmio_remapped++;
 	}
 
+	void Logger::backend_queue_delay(bool flash, QueueClass queue_class, uint64_t cycles)
+	{
+		backend_queue_count[flash][queue_class]++;
+		backend_queue_sum[flash][queue_class] += cycles;
+		if (cycles > backend_queue_max[flash][queue_class])
+			backend_queue_max[flash][queue_class] = cycles;
+	}
+
 
 	void Logger::read()
 	{
@@ -539,125 +557,41 @@ namespace HybridSim
 
 	void Logger::epoch_reset(bool init)
 	{
-		// If this is not initialization, then save the epoch state to the lists.
 		if (init)
 		{
-			// Open up the hybridsim_epoch.log
-			ofstream savefile;
-			savefile.open("hybridsim_epoch.log", ios_base::out | ios_base::trunc);
-			if (!savefile.is_open())
+			if (ENABLE_TEXT_STATS)
 			{
-				cerr << "ERROR: HybridSim Logger epoch output file failed to open.\n";
-				abort();
+				// Open up the hybridsim_epoch.log
+				ofstream savefile;
+				savefile.open("hybridsim_epoch.log", ios_base::out | ios_base::trunc);
+				if (!savefile.is_open())
+				{
+					cerr << "ERROR: HybridSim Logger epoch output file failed to open.\n";
+					abort();
+				}
+
+				savefile << "================================================================================\n\n";
+				savefile << "Epoch data:\n\n";
+
+				savefile.close();
 			}
 
-			savefile << "================================================================================\n\n";
-			savefile << "Epoch data:\n\n";
-
-			savefile.close();
+			// Start the CSV file with the header row.
+			if (ENABLE_CSV_STATS)
+				print_epoch_csv(true);
 		}
 
+		// If this is not initialization, then save the epoch state to the output files.
 		if (!init)
 		{
-			// Open up the hybridsim_epoch.log
-			ofstream savefile;
-			savefile.open("hybridsim_epoch.log", ios_base::out | ios_base::app);
-			if (!savefile.is_open())
-			{
-				cerr << "ERROR: HybridSim Logger epoch output file failed to open.\n";
-				abort();
-			}
+			if (ENABLE_TEXT_STATS)
+				print_epoch_text();
 
-			// Output the current epoch data.
-			savefile << "---------------------------------------------------\n";
-			savefile << "Epoch number: " << epoch_count << "\n";
-
-			// Print everything out.
-			savefile << "total accesses: " << cur_num_accesses << "\n";
-			savefile << "cycles: " << EPOCH_LENGTH << "\n";
-			savefile << "execution time: " << (EPOCH_LENGTH / (double)CYCLES_PER_SECOND) * 1000000 << " us\n";
-			savefile << "misses: " << cur_num_misses << "\n";
-			savefile << "hits: " << cur_num_hits << "\n";
-			savefile << "miss rate: " << this->divide(cur_num_misses, cur_num_accesses) << "\n";
-			savefile << "average latency: " << this->latency_cycles(cur_sum_latency, cur_num_accesses) << " cycles";
-			savefile << " (" << this->latency_us(cur_sum_latency, cur_num_accesses) << " us)\n";
-			savefile << "average queue latency: " << this->latency_cycles(cur_sum_queue_latency, cur_num_accesses) << " cycles";
-			savefile << " (" << this->latency_us(cur_sum_queue_latency, cur_num_accesses) << " us)\n";
-			savefile << "average miss latency: " << this->latency_cycles(cur_sum_miss_latency, cur_num_misses) << " cycles";
-			savefile << " (" << this->latency_us(cur_sum_miss_latency, cur_num_misses) << " us)\n";
-			savefile << "average hit latency: " << this->latency_cycles(cur_sum_hit_latency, cur_num_hits) << " cycles";
-			savefile << " (" << this->latency_us(cur_sum_hit_latency, cur_num_hits) << " us)\n";
-			savefile << "throughput: " << this->compute_throughput(EPOCH_LENGTH, cur_num_accesses) << " KB/s\n";
-			savefile << "working set size in pages: " << cur_pages_used.size() << "\n";
-			savefile << "working set size in bytes: " << cur_pages_used.size() * PAGE_SIZE << " bytes\n";
-			savefile << "current queue length: " << access_queue.size() << "\n";
-			savefile << "max queue length: " << cur_max_queue_length << "\n";
-			savefile << "average queue length: " << this->divide(cur_sum_queue_length, EPOCH_LENGTH) << "\n";
-			savefile << "idle counter: " << cur_idle_counter << "\n";
-			savefile << "idle percentage: " << this->divide(cur_idle_counter, EPOCH_LENGTH) << "\n";
-			savefile << "flash idle counter: " << cur_flash_idle_counter << "\n";
-			savefile << "flash idle percentage: " << this->divide(cur_flash_idle_counter, EPOCH_LENGTH) << "\n";
-			savefile << "dram idle counter: " << cur_dram_idle_counter << "\n";
-			savefile << "dram idle percentage: " << this->divide(cur_dram_idle_counter, EPOCH_LENGTH) << "\n";
-			savefile << "MMIO Accesses Dropped: " << cur_num_mmio_dropped << "\n";
-			savefile << "MMIO Accesses Remapped: " << cur_num_mmio_remapped << "\n";
-			savefile << "\n";
-
-			savefile << "reads: " << cur_num_reads << "\n";
-			savefile << "misses: " << cur_num_read_misses << "\n";
-			savefile << "hits: " << cur_num_read_hits << "\n";
-			savefile << "miss rate: " << this->divide(cur_num_read_misses, cur_num_reads) << "\n";
-			savefile << "average latency: " << this->latency_cycles(cur_sum_read_latency, cur_num_reads) << " cycles";
-			savefile << " (" << this->latency_us(cur_sum_read_latency, cur_num_reads) << " us)\n";
-			savefile << "average miss latency: " << this->latency_cycles(cur_sum_read_miss_latency, cur_num_read_misses) << " cycles";
-			savefile << " (" << this->latency_us(cur_sum_read_miss_latency, cur_num_read_misses) << " us)\n";
-			savefile << "average hit latency: " << this->latency_cycles(cur_sum_read_hit_latency, cur_num_read_hits) << " cycles";
-			savefile << " (" << this->latency_us(cur_sum_read_hit_latency, cur_num_read_hits) << " us)\n";
-			savefile << "throughput: " << this->compute_throughput(EPOCH_LENGTH, cur_num_reads) << " KB/s\n";
-			savefile << "\n";
-
-			savefile << "writes: " << cur_num_writes << "\n";
-			savefile << "misses: " << cur_num_write_misses << "\n";
-			savefile << "hits: " << cur_num_write_hits << "\n";
-			savefile << "miss rate: " << this->divide(cur_num_write_misses, cur_num_writes) << "\n";
-			savefile << "average latency: " << this->latency_cycles(cur_sum_write_latency, cur_num_writes) << " cycles";
-			savefile << " (" << this->latency_us(cur_sum_write_latency, cur_num_writes) << " us)\n";
-			savefile << "average miss latency: " << this->latency_cycles(cur_sum_write_miss_latency, cur_num_write_misses) << " cycles";
-			savefile << " (" << this->latency_us(cur_sum_write_miss_latency, cur_num_write_misses) << " us)\n";
-			savefile << "average hit latency: " << this->latency_cycles(cur_sum_write_hit_latency, cur_num_write_hits) << " cycles";
-			savefile << " (" << this->latency_us(cur_sum_write_hit_latency, cur_num_write_hits) << " us)\n";
-			savefile << "throughput: " << this->compute_throughput(EPOCH_LENGTH, cur_num_writes) << " KB/s\n";
-			savefile << "\n\n";
-
-			// Output the missed page data.
-			savefile << "Missed Page Data:\n";
-
-			list<MissedPageEntry>::iterator mit;
-			for (mit = missed_page_list.begin(); mit != missed_page_list.end(); mit++)
-			{
-				uint64_t cycle = (*mit).cycle;
-				uint64_t missed_page = (*mit).missed_page;
-				uint64_t victim_page = (*mit).victim_page;
-				uint64_t cache_set = (*mit).cache_set;
-				uint64_t cache_page = (*mit).cache_page;
-				bool dirty = (*mit).dirty;
-				bool valid = (*mit).valid;
-
-				savefile << cycle << ": missed= 0x" << hex << missed_page << "; victim= 0x" << victim_page 
-						<< "; set= " << dec << cache_set << "; missed_tag= " << TAG(missed_page) << "; victim_tag= " << TAG(victim_page)
-						<< "; cache_page= 0x" << hex << cache_page << dec <<"; dirty = " << dirty
-						<< "; valid= " << valid << ";\n";
-			}
-
-			savefile << "\n\n";
+			if (ENABLE_CSV_STATS)
+				print_epoch_csv(false);
 
 			// Clear the missed page data.
 			missed_page_list.clear();
-			
-
-
-			// Close the output file.
-			savefile.close();
 
 			epoch_count++;
 		}
@@ -702,7 +636,233 @@ namespace HybridSim
 		cur_pages_used.clear();
 	}
 
+	void Logger::register_counter(string name, uint64_t *counter)
+	{
+		external_counters.push_back(make_pair(name, counter));
+	}
+
+	void Logger::checkpoint(StateWriter &w)
+	{
+		w.section("logger");
+		w.put(currentClockCycle);
+
+		// Overall state
+		w.put(num_accesses);
+		w.put(num_reads);
+		w.put(num_writes);
+		w.put(num_misses);
+		w.put(num_hits);
+		w.put(num_read_misses);
+		w.put(num_read_hits);
+		w.put(num_write_misses);
+		w.put(num_write_hits);
+		w.put(sum_latency);
+		w.put(sum_read_latency);
+		w.put(sum_write_latency);
+		w.put(sum_queue_latency);
+		w.put(sum_hit_latency);
+		w.put(sum_miss_latency);
+		w.put(sum_read_hit_latency);
+		w.put(sum_read_miss_latency);
+		w.put(sum_write_hit_latency);
+		w.put(sum_write_miss_latency);
+		w.put(max_queue_length);
+		w.put(sum_queue_length);
+		w.put(idle_counter);
+		w.put(flash_idle_counter);
+		w.put(dram_idle_counter);
+		w.put(num_mmio_dropped);
+		w.put(num_mmio_remapped);
+		w.put(pages_used);
+		for (uint64_t d = 0; d < 2; d++)
+		{
+			for (uint64_t c = 0; c < NUM_QUEUE_CLASSES; c++)
+			{
+				w.put(backend_queue_count[d][c]);
+				w.put(backend_queue_sum[d][c]);
+				w.put(backend_queue_max[d][c]);
+			}
+		}
+
+		// Epoch state
+		w.put(epoch_count);
+		w.put(cur_num_accesses);
+		w.put(cur_num_reads);
+		w.put(cur_num_writes);
+		w.put(cur_num_misses);
+		w.put(cur_num_hits);
+		w.put(cur_num_read_misses);
+		w.put(cur_num_read_hits);
+		w.put(cur_num_write_misses);
+		w.put(cur_num_write_hits);
+		w.put(cur_sum_latency);
+		w.put(cur_sum_read_latency);
+		w.put(cur_sum_write_latency);
+		w.put(cur_sum_queue_latency);
+		w.put(cur_sum_hit_latency);
+		w.put(cur_sum_miss_latency);
+		w.put(cur_sum_read_hit_latency);
+		w.put(cur_sum_read_miss_latency);
+		w.put(cur_sum_write_hit_latency);
+		w.put(cur_sum_write_miss_latency);
+		w.put(cur_max_queue_length);
+		w.put(cur_sum_queue_length);
+		w.put(cur_idle_counter);
+		w.put(cur_flash_idle_counter);
+		w.put(cur_dram_idle_counter);
+		w.put(cur_num_mmio_dropped);
+		w.put(cur_num_mmio_remapped);
+		w.put(cur_pages_used);
+
+		w.put(latency_histogram);
+		w.put(set_conflicts);
+		w.put(access_queue);
+
+		w.put((uint64_t)missed_page_list.size());
+		list<MissedPageEntry>::iterator mit;
+		for (mit = missed_page_list.begin(); mit != missed_page_list.end(); mit++)
+		{
+			w.put(mit->cycle);
+			w.put(mit->missed_page);
+			w.put(mit->victim_page);
+			w.put(mit->cache_set);
+			w.put(mit->cache_page);
+			w.put(mit->dirty);
+			w.put(mit->valid);
+		}
+
+		w.put((uint64_t)access_map.size());
+		unordered_map<uint64_t, AccessMapEntry>::iterator ait;
+		for (ait = access_map.begin(); ait != access_map.end(); ait++)
+		{
+			w.put(ait->first);
+			w.put(ait->second.start);
+			w.put(ait->second.process);
+			w.put(ait->second.stop);
+			w.put(ait->second.read_op);
+			w.put(ait->second.hit);
+		}
+	}
+
+	void Logger::restore(StateReader &r)
+	{
+		r.section("logger");
+		r.get(currentClockCycle);
+
+		// Overall state
+		r.get(num_accesses);
+		r.get(num_reads);
+		r.get(num_writes);
+		r.get(num_misses);
+		r.get(num_hits);
+		r.get(num_read_misses);
+		r.get(num_read_hits);
+		r.get(num_write_misses);
+		r.get(num_write_hits);
+		r.get(sum_latency);
+		r.get(sum_read_latency);
+		r.get(sum_write_latency);
+		r.get(sum_queue_latency);
+		r.get(sum_hit_latency);
+		r.get(sum_miss_latency);
+		r.get(sum_read_hit_latency);
+		r.get(sum_read_miss_latency);
+		r.get(sum_write_hit_latency);
+		r.get(sum_write_miss_latency);
+		r.get(max_queue_length);
+		r.get(sum_queue_length);
+		r.get(idle_counter);
+		r.get(flash_idle_counter);
+		r.get(dram_idle_counter);
+		r.get(num_mmio_dropped);
+		r.get(num_mmio_remapped);
+		r.get(pages_used);
+		for (uint64_t d = 0; d < 2; d++)
+		{
+			for (uint64_t c = 0; c < NUM_QUEUE_CLASSES; c++)
+			{
+				r.get(backend_queue_count[d][c]);
+				r.get(backend_queue_sum[d][c]);
+				r.get(backend_queue_max[d][c]);
+			}
+		}
+
+		// Epoch state
+		r.get(epoch_count);
+		r.get(cur_num_accesses);
+		r.get(cur_num_reads);
+		r.get(cur_num_writes);
+		r.get(cur_num_misses);
+		r.get(cur_num_hits);
+		r.get(cur_num_read_misses);
+		r.get(cur_num_read_hits);
+		r.get(cur_num_write_misses);
+		r.get(cur_num_write_hits);
+		r.get(cur_sum_latency);
+		r.get(cur_sum_read_latency);
+		r.get(cur_sum_write_latency);
+		r.get(cur_sum_queue_latency);
+		r.get(cur_sum_hit_latency);
+		r.get(cur_sum_miss_latency);
+		r.get(cur_sum_read_hit_latency);
+		r.get(cur_sum_read_miss_latency);
+		r.get(cur_sum_write_hit_latency);
+		r.get(cur_sum_write_miss_latency);
+		r.get(cur_max_queue_length);
+		r.get(cur_sum_queue_length);
+		r.get(cur_idle_counter);
+		r.get(cur_flash_idle_counter);
+		r.get(cur_dram_idle_counter);
+		r.get(cur_num_mmio_dropped);
+		r.get(cur_num_mmio_remapped);
+		r.get(cur_pages_used);
+
+		r.get(latency_histogram);
+		r.get(set_conflicts);
+		r.get(access_queue);
+
+		uint64_t n;
+		r.get(n);
+		missed_page_list.clear();
+		for (uint64_t i=0; i < n; i++)
+		{
+			MissedPageEntry e(0, 0, 0, 0, 0, false, false);
+			r.get(e.cycle);
+			r.get(e.missed_page);
+			r.get(e.victim_page);
+			r.get(e.cache_set);
+			r.get(e.cache_page);
+			r.get(e.dirty);
+			r.get(e.valid);
+			missed_page_list.push_back(e);
+		}
+
+		r.get(n);
+		access_map.clear();
+		for (uint64_t i=0; i < n; i++)
+		{
+			uint64_t addr;
+			AccessMapEntry e;
+			r.get(addr);
+			r.get(e.start);
+			r.get(e.process);
+			r.get(e.stop);
+			r.get(e.read_op);
+			r.get(e.hit);
+			access_map[addr] = e;
+		}
+	}
+
 	void Logger::print()
+	{
+		if (ENABLE_TEXT_STATS)
+			print_text();
+
+		if (ENABLE_JSON_STATS)
+			print_json();
+	}
+
+	void Logger::print_text()
 	{
 		ofstream savefile;
 		savefile.open("hybridsim.log", ios_base::out | ios_base::trunc);
@@ -743,6 +903,18 @@ namespace HybridSim
 		savefile << "MMIO Accesses Remapped: " << num_mmio_remapped << "\n";
 		savefile << "\n";
 
+		savefile << "backend queueing delay (" << BACKEND_QUEUE_POLICY << "):\n";
+		for (uint64_t d = 0; d < 2; d++)
+		{
+			for (uint64_t c = 0; c < NUM_QUEUE_CLASSES; c++)
+			{
+				savefile << (d ? "flash " : "dram ") << QUEUE_CLASS_NAMES[c] << ": " << backend_queue_count[d][c] << " transactions, average "
+					<< this->latency_cycles(backend_queue_sum[d][c], backend_queue_count[d][c]) << " cycles, max "
+					<< backend_queue_max[d][c] << " cycles\n";
+			}
+		}
+		savefile << "\n";
+
 		savefile << "reads: " << num_reads << "\n";
 		savefile << "misses: " << num_read_misses << "\n";
 		savefile << "hits: " << num_read_hits << "\n";
@@ -775,8 +947,10 @@ namespace HybridSim
 
 		savefile << flush;
 
-		unordered_map<uint64_t, uint64_t>::iterator it; 
-		for (it = pages_used.begin(); it != pages_used.end(); it++)
+		// Sorted by address, so the output doesn't depend on the hash table's iteration order.
+		map<uint64_t, uint64_t> sorted_pages(pages_used.begin(), pages_used.end());
+		map<uint64_t, uint64_t>::iterator it;
+		for (it = sorted_pages.begin(); it != sorted_pages.end(); it++)
 		{
 			uint64_t page_addr = (*it).first;
 			uint64_t num_accesses = (*it).second;
@@ -809,5 +983,323 @@ namespace HybridSim
 
 		savefile.close();
 	}
-}
 
+	void Logger::print_epoch_text()
+	{
+		// Open up the hybridsim_epoch.log
+		ofstream savefile;
+		savefile.open("hybridsim_epoch.log", ios_base::out | ios_base::app);
+		if (!savefile.is_open())
+		{
+			cerr << "ERROR: HybridSim Logger epoch output file failed to open.\n";
+			abort();
+		}
+
+		// Output the current epoch data.
+		savefile << "---------------------------------------------------\n";
+		savefile << "Epoch number: " << epoch_count << "\n";
+
+		// Print everything out.
+		savefile << "total accesses: " << cur_num_accesses << "\n";
+		savefile << "cycles: " << EPOCH_LENGTH << "\n";
+		savefile << "execution time: " << (EPOCH_LENGTH / (double)CYCLES_PER_SECOND) * 1000000 << " us\n";
+		savefile << "misses: " << cur_num_misses << "\n";
+		savefile << "hits: " << cur_num_hits << "\n";
+		savefile << "miss rate: " << this->divide(cur_num_misses, cur_num_accesses) << "\n";
+		savefile << "average latency: " << this->latency_cycles(cur_sum_latency, cur_num_accesses) << " cycles";
+		savefile << " (" << this->latency_us(cur_sum_latency, cur_num_accesses) << " us)\n";
+		savefile << "average queue latency: " << this->latency_cycles(cur_sum_queue_latency, cur_num_accesses) << " cycles";
+		savefile << " (" << this->latency_us(cur_sum_queue_latency, cur_num_accesses) << " us)\n";
+		savefile << "average miss latency: " << this->latency_cycles(cur_sum_miss_latency, cur_num_misses) << " cycles";
+		savefile << " (" << this->latency_us(cur_sum_miss_latency, cur_num_misses) << " us)\n";
+		savefile << "average hit latency: " << this->latency_cycles(cur_sum_hit_latency, cur_num_hits) << " cycles";
+		savefile << " (" << this->latency_us(cur_sum_hit_latency, cur_num_hits) << " us)\n";
+		savefile << "throughput: " << this->compute_throughput(EPOCH_LENGTH, cur_num_accesses) << " KB/s\n";
+		savefile << "working set size in pages: " << cur_pages_used.size() << "\n";
+		savefile << "working set size in bytes: " << cur_pages_used.size() * PAGE_SIZE << " bytes\n";
+		savefile << "current queue length: " << access_queue.size() << "\n";
+		savefile << "max queue length: " << cur_max_queue_length << "\n";
+		savefile << "average queue length: " << this->divide(cur_sum_queue_length, EPOCH_LENGTH) << "\n";
+		savefile << "idle counter: " << cur_idle_counter << "\n";
+		savefile << "idle percentage: " << this->divide(cur_idle_counter, EPOCH_LENGTH) << "\n";
+		savefile << "flash idle counter: " << cur_flash_idle_counter << "\n";
+		savefile << "flash idle percentage: " << this->divide(cur_flash_idle_counter, EPOCH_LENGTH) << "\n";
+		savefile << "dram idle counter: " << cur_dram_idle_counter << "\n";
+		savefile << "dram idle percentage: " << this->divide(cur_dram_idle_counter, EPOCH_LENGTH) << "\n";
+		savefile << "MMIO Accesses Dropped: " << cur_num_mmio_dropped << "\n";
+		savefile << "MMIO Accesses Remapped: " << cur_num_mmio_remapped << "\n";
+		savefile << "\n";
+
+		savefile << "reads: " << cur_num_reads << "\n";
+		savefile << "misses: " << cur_num_read_misses << "\n";
+		savefile << "hits: " << cur_num_read_hits << "\n";
+		savefile << "miss rate: " << this->divide(cur_num_read_misses, cur_num_reads) << "\n";
+		savefile << "average latency: " << this->latency_cycles(cur_sum_read_latency, cur_num_reads) << " cycles";
+		savefile << " (" << this->latency_us(cur_sum_read_latency, cur_num_reads) << " us)\n";
+		savefile << "average miss latency: " << this->latency_cycles(cur_sum_read_miss_latency, cur_num_read_misses) << " cycles";
+		savefile << " (" << this->latency_us(cur_sum_read_miss_latency, cur_num_read_misses) << " us)\n";
+		savefile << "average hit latency: " << this->latency_cycles(cur_sum_read_hit_latency, cur_num_read_hits) << " cycles";
+		savefile << " (" << this->latency_us(cur_sum_read_hit_latency, cur_num_read_hits) << " us)\n";
+		savefile << "throughput: " << this->compute_throughput(EPOCH_LENGTH, cur_num_reads) << " KB/s\n";
+		savefile << "\n";
+
+		savefile << "writes: " << cur_num_writes << "\n";
+		savefile << "misses: " << cur_num_write_misses << "\n";
+		savefile << "hits: " << cur_num_write_hits << "\n";
+		savefile << "miss rate: " << this->divide(cur_num_write_misses, cur_num_writes) << "\n";
+		savefile << "average latency: " << this->latency_cycles(cur_sum_write_latency, cur_num_writes) << " cycles";
+		savefile << " (" << this->latency_us(cur_sum_write_latency, cur_num_writes) << " us)\n";
+		savefile << "average miss latency: " << this->latency_cycles(cur_sum_write_miss_latency, cur_num_write_misses) << " cycles";
+		savefile << " (" << this->latency_us(cur_sum_write_miss_latency, cur_num_write_misses) << " us)\n";
+		savefile << "average hit latency: " << this->latency_cycles(cur_sum_write_hit_latency, cur_num_write_hits) << " cycles";
+		savefile << " (" << this->latency_us(cur_sum_write_hit_latency, cur_num_write_hits) << " us)\n";
+		savefile << "throughput: " << this->compute_throughput(EPOCH_LENGTH, cur_num_writes) << " KB/s\n";
+		savefile << "\n\n";
+
+		// Output the missed page data.
+		savefile << "Missed Page Data:\n";
+
+		list<MissedPageEntry>::iterator mit;
+		for (mit = missed_page_list.begin(); mit != missed_page_list.end(); mit++)
+		{
+			uint64_t cycle = (*mit).cycle;
+			uint64_t missed_page = (*mit).missed_page;
+			uint64_t victim_page = (*mit).victim_page;
+			uint64_t cache_set = (*mit).cache_set;
+			uint64_t cache_page = (*mit).cache_page;
+			bool dirty = (*mit).dirty;
+			bool valid = (*mit).valid;
+
+			savefile << cycle << ": missed= 0x" << hex << missed_page << "; victim= 0x" << victim_page 
+					<< "; set= " << dec << cache_set << "; missed_tag= " << TAG(missed_page) << "; victim_tag= " << TAG(victim_page)
+					<< "; cache_page= 0x" << hex << cache_page << dec <<"; dirty = " << dirty
+					<< "; valid= " << valid << ";\n";
+		}
+
+		savefile << "\n\n";
+
+		// Close the output file.
+		savefile.close();
+	}
+
+	// Helper for building the name/value lists used by the JSON and CSV output.
+	// Keeping the names and values together guarantees the CSV header matches each row.
+	template <typename T>
+	static void add_field(list<pair<string, string> > &fields, string name, T value)
+	{
+		stringstream out;
+		out << value;
+		fields.push_back(make_pair(name, out.str()));
+	}
+
+	static void print_json_object(ofstream &savefile, string name, list<pair<string, string> > &fields, bool last)
+	{
+		savefile << "\t\"" << name << "\": {\n";
+		list<pair<string, string> >::iterator it;
+		for (it = fields.begin(); it != fields.end(); )
+		{
+			savefile << "\t\t\"" << (*it).first << "\": " << (*it).second;
+			it++;
+			savefile << ((it != fields.end()) ? ",\n" : "\n");
+		}
+		savefile << "\t}" << (last ? "\n" : ",\n");
+	}
+
+	void Logger::print_json()
+	{
+		ofstream savefile;
+		savefile.open("hybridsim_stats.json", ios_base::out | ios_base::trunc);
+		if (!savefile.is_open())
+		{
+			cerr << "ERROR: HybridSim Logger JSON output file failed to open.\n";
+			abort();
+		}
+
+		list<pair<string, string> > config;
+		add_field(config, "cycles", currentClockCycle);
+		add_field(config, "frequency", CYCLES_PER_SECOND);
+		add_field(config, "page_size", PAGE_SIZE);
+		add_field(config, "set_size", SET_SIZE);
+		add_field(config, "cache_pages", CACHE_PAGES);
+		add_field(config, "total_pages", TOTAL_PAGES);
+		add_field(config, "epoch_length", EPOCH_LENGTH);
+		add_field(config, "histogram_bin", HISTOGRAM_BIN);
+		add_field(config, "histogram_max", HISTOGRAM_MAX);
+
+		list<pair<string, string> > totals;
+		add_field(totals, "num_accesses", num_accesses);
+		add_field(totals, "num_reads", num_reads);
+		add_field(totals, "num_writes", num_writes);
+		add_field(totals, "num_misses", num_misses);
+		add_field(totals, "num_hits", num_hits);
+		add_field(totals, "num_read_misses", num_read_misses);
+		add_field(totals, "num_read_hits", num_read_hits);
+		add_field(totals, "num_write_misses", num_write_misses);
+		add_field(totals, "num_write_hits", num_write_hits);
+		add_field(totals, "sum_latency", sum_latency);
+		add_field(totals, "sum_read_latency", sum_read_latency);
+		add_field(totals, "sum_write_latency", sum_write_latency);
+		add_field(totals, "sum_queue_latency", sum_queue_latency);
+		add_field(totals, "sum_hit_latency", sum_hit_latency);
+		add_field(totals, "sum_miss_latency", sum_miss_latency);
+		add_field(totals, "sum_read_hit_latency", sum_read_hit_latency);
+		add_field(totals, "sum_read_miss_latency", sum_read_miss_latency);
+		add_field(totals, "sum_write_hit_latency", sum_write_hit_latency);
+		add_field(totals, "sum_write_miss_latency", sum_write_miss_latency);
+		add_field(totals, "max_queue_length", max_queue_length);
+		add_field(totals, "sum_queue_length", sum_queue_length);
+		add_field(totals, "idle_counter", idle_counter);
+		add_field(totals, "flash_idle_counter", flash_idle_counter);
+		add_field(totals, "dram_idle_counter", dram_idle_counter);
+		add_field(totals, "num_mmio_dropped", num_mmio_dropped);
+		add_field(totals, "num_mmio_remapped", num_mmio_remapped);
+		add_field(totals, "working_set_pages", pages_used.size());
+		add_field(totals, "epoch_count", epoch_count);
+
+		list<pair<string, string> > derived;
+		add_field(derived, "miss_rate", miss_rate());
+		add_field(derived, "read_miss_rate", read_miss_rate());
+		add_field(derived, "write_miss_rate", write_miss_rate());
+		add_field(derived, "average_latency", latency_cycles(sum_latency, num_accesses));
+		add_field(derived, "average_queue_latency", latency_cycles(sum_queue_latency, num_accesses));
+		add_field(derived, "average_miss_latency", latency_cycles(sum_miss_latency, num_misses));
+		add_field(derived, "average_hit_latency", latency_cycles(sum_hit_latency, num_hits));
+		add_field(derived, "average_read_latency", latency_cycles(sum_read_latency, num_reads));
+		add_field(derived, "average_read_miss_latency", latency_cycles(sum_read_miss_latency, num_read_misses));
+		add_field(derived, "average_read_hit_latency", latency_cycles(sum_read_hit_latency, num_read_hits));
+		add_field(derived, "average_write_latency", latency_cycles(sum_write_latency, num_writes));
+		add_field(derived, "average_write_miss_latency", latency_cycles(sum_write_miss_latency, num_write_misses));
+		add_field(derived, "average_write_hit_latency", latency_cycles(sum_write_hit_latency, num_write_hits));
+		add_field(derived, "average_latency_us", latency_us(sum_latency, num_accesses));
+		add_field(derived, "throughput_kbps", compute_throughput(currentClockCycle, num_accesses));
+		add_field(derived, "read_throughput_kbps", compute_throughput(currentClockCycle, num_reads));
+		add_field(derived, "write_throughput_kbps", compute_throughput(currentClockCycle, num_writes));
+		add_field(derived, "average_queue_length", divide(sum_queue_length, currentClockCycle));
+		add_field(derived, "idle_percentage", divide(idle_counter, currentClockCycle));
+		add_field(derived, "flash_idle_percentage", divide(flash_idle_counter, currentClockCycle));
+		add_field(derived, "dram_idle_percentage", divide(dram_idle_counter, currentClockCycle));
+
+		list<pair<string, string> > backend_queues;
+		add_field(backend_queues, "policy", "\"" + BACKEND_QUEUE_POLICY + "\"");
+		for (uint64_t d = 0; d < 2; d++)
+		{
+			for (uint64_t c = 0; c < NUM_QUEUE_CLASSES; c++)
+			{
+				string name = string(d ? "flash_" : "dram_") + QUEUE_CLASS_NAMES[c];
+				add_field(backend_queues, name + "_count", backend_queue_count[d][c]);
+				add_field(backend_queues, name + "_average_delay", latency_cycles(backend_queue_sum[d][c], backend_queue_count[d][c]));
+				add_field(backend_queues, name + "_max_delay", backend_queue_max[d][c]);
+			}
+		}
+
+		list<pair<string, string> > controller;
+		list<pair<string, uint64_t *> >::iterator cit;
+		for (cit = external_counters.begin(); cit != external_counters.end(); cit++)
+			add_field(controller, (*cit).first, *((*cit).second));
+
+		list<pair<string, string> > histogram;
+		for (uint64_t bin = 0; bin <= HISTOGRAM_MAX; bin += HISTOGRAM_BIN)
+		{
+			stringstream bin_name;
+			bin_name << bin;
+			add_field(histogram, bin_name.str(), latency_histogram[bin]);
+		}
+
+		// Only output the sets that have greater than 0 conflicts.
+		list<pair<string, string> > conflicts;
+		for (uint64_t set = 0; set < NUM_SETS; set++)
+		{
+			if (set_conflicts[set])
+			{
+				stringstream set_name;
+				set_name << set;
+				add_field(conflicts, set_name.str(), set_conflicts[set]);
+			}
+		}
+
+		list<pair<string, string> > pages;
+		map<uint64_t, uint64_t> sorted_pages(pages_used.begin(), pages_used.end());
+		map<uint64_t, uint64_t>::iterator it;
+		for (it = sorted_pages.begin(); it != sorted_pages.end(); it++)
+		{
+			stringstream page_name;
+			page_name << (*it).first;
+			add_field(pages, page_name.str(), (*it).second);
+		}
+
+		savefile << "{\n";
+		print_json_object(savefile, "config", config, false);
+		print_json_object(savefile, "totals", totals, false);
+		print_json_object(savefile, "derived", derived, false);
+		print_json_object(savefile, "backend_queues", backend_queues, false);
+		print_json_object(savefile, "controller", controller, false);
+		print_json_object(savefile, "latency_histogram", histogram, false);
+		print_json_object(savefile, "set_conflicts", conflicts, false);
+		print_json_object(savefile, "pages_used", pages, true);
+		savefile << "}\n";
+
+		savefile.close();
+	}
+
+	void Logger::print_epoch_csv(bool header)
+	{
+		ofstream savefile;
+		if (header)
+			savefile.open("hybridsim_epoch.csv", ios_base::out | ios_base::trunc);
+		else
+			savefile.open("hybridsim_epoch.csv", ios_base::out | ios_base::app);
+		if (!savefile.is_open())
+		{
+			cerr << "ERROR: HybridSim Logger epoch CSV output file failed to open.\n";
+			abort();
+		}
+
+		list<pair<string, string> > fields;
+		add_field(fields, "epoch", epoch_count);
+		add_field(fields, "cycle", currentClockCycle);
+		add_field(fields, "num_accesses", cur_num_accesses);
+		add_field(fields, "num_reads", cur_num_reads);
+		add_field(fields, "num_writes", cur_num_writes);
+		add_field(fields, "num_misses", cur_num_misses);
+		add_field(fields, "num_hits", cur_num_hits);
+		add_field(fields, "num_read_misses", cur_num_read_misses);
+		add_field(fields, "num_read_hits", cur_num_read_hits);
+		add_field(fields, "num_write_misses", cur_num_write_misses);
+		add_field(fields, "num_write_hits", cur_num_write_hits);
+		add_field(fields, "sum_latency", cur_sum_latency);
+		add_field(fields, "sum_read_latency", cur_sum_read_latency);
+		add_field(fields, "sum_write_latency", cur_sum_write_latency);
+		add_field(fields, "sum_queue_latency", cur_sum_queue_latency);
+		add_field(fields, "sum_hit_latency", cur_sum_hit_latency);
+		add_field(fields, "sum_miss_latency", cur_sum_miss_latency);
+		add_field(fields, "sum_read_hit_latency", cur_sum_read_hit_latency);
+		add_field(fields, "sum_read_miss_latency", cur_sum_read_miss_latency);
+		add_field(fields, "sum_write_hit_latency", cur_sum_write_hit_latency);
+		add_field(fields, "sum_write_miss_latency", cur_sum_write_miss_latency);
+		add_field(fields, "max_queue_length", cur_max_queue_length);
+		add_field(fields, "sum_queue_length", cur_sum_queue_length);
+		add_field(fields, "current_queue_length", access_queue.size());
+		add_field(fields, "idle_counter", cur_idle_counter);
+		add_field(fields, "flash_idle_counter", cur_flash_idle_counter);
+		add_field(fields, "dram_idle_counter", cur_dram_idle_counter);
+		add_field(fields, "num_mmio_dropped", cur_num_mmio_dropped);
+		add_field(fields, "num_mmio_remapped", cur_num_mmio_remapped);
+		add_field(fields, "working_set_pages", cur_pages_used.size());
+		add_field(fields, "num_missed_pages", missed_page_list.size());
+
+		list<pair<string, uint64_t *> >::iterator cit;
+		for (cit = external_counters.begin(); cit != external_counters.end(); cit++)
+			add_field(fields, (*cit).first, *((*cit).second));
+
+		list<pair<string, string> >::iterator it;
+		for (it = fields.begin(); it != fields.end(); it++)
+		{
+			if (it != fields.begin())
+				savefile << ",";
+			savefile << (header ? (*it).first : (*it).second);
+		}
+		savefile << "\n";
+
+		savefile.close();
+	}
+}
@@ -35,6 +35,8 @@
 #include <fstream>
 
 #include "config.h"
+#include "Checkpoint.h"
+#include "BackendQueue.h"
 
 
 namespace HybridSim
@@ -87,6 +89,11 @@ namespace HybridSim
 
 		unordered_map<uint64_t, uint64_t> pages_used; // maps page_addr to num_accesses
 
+		// Time spent in dram_queue (0) and flash_queue (1) by each class of transaction (see BackendQueue.h).
+		uint64_t backend_queue_count[2][NUM_QUEUE_CLASSES];
+		uint64_t backend_queue_sum[2][NUM_QUEUE_CLASSES];
+		uint64_t backend_queue_max[2][NUM_QUEUE_CLASSES];
+
 		// Epoch state (reset at the beginning of each epoch)
 		uint64_t epoch_count;
 
@@ -128,6 +135,10 @@ namespace HybridSim
 
 		unordered_map<uint64_t, uint64_t> cur_pages_used; // maps page_addr to num_accesses
 
+		// Counters owned by other modules (e.g. HybridSystem's TLB and prefetch counters).
+		// These are included in the JSON and CSV output. The values are cumulative, not per epoch.
+		list<pair<string, uint64_t *> > external_counters;
+
 
 		// -----------------------------------------------------------
 		// Missed Page Record
@@ -215,6 +226,14 @@ namespace HybridSim
 		void mmio_dropped();
 		void mmio_remapped();
 
+		void backend_queue_delay(bool flash, QueueClass queue_class, uint64_t cycles);
+
+		void register_counter(string name, uint64_t *counter);
+
+		// Save/restore all of the counters and in-flight access tracking for a full system checkpoint.
+		void checkpoint(StateWriter &w);
+		void restore(StateReader &r);
+
 		void print();
 
 		// -----------------------------------------------------------
@@ -254,6 +273,11 @@ namespace HybridSim
 		double latency_us(uint64_t sum, uint64_t accesses);
 
 		void epoch_reset(bool init);
+
+		void print_text();
+		void print_json();
+		void print_epoch_text();
+		void print_epoch_csv(bool header);
 	};
 
 }
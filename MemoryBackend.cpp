@@ -0,0 +1,486 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "MemoryBackend.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	// -----------------------------------------------------------
+	// MemoryBackend
+
+	MemoryBackend::MemoryBackend()
+	{
+		read_done = NULL;
+		critical_line_done = NULL;
+		write_done = NULL;
+	}
+
+	void MemoryBackend::RegisterCallbacks(BackendCallback *readDone, BackendCallback *criticalLineDone, BackendCallback *writeDone)
+	{
+		read_done = readDone;
+		critical_line_done = criticalLineDone;
+		write_done = writeDone;
+	}
+
+	void MemoryBackend::loadState(string filename)
+	{
+		cerr << "ERROR: This memory backend does not support restoring state.\n";
+		abort();
+	}
+
+	void MemoryBackend::saveState(string filename)
+	{
+		cerr << "ERROR: This memory backend does not support saving state.\n";
+		abort();
+	}
+
+	void MemoryBackend::checkpoint(StateWriter &w)
+	{
+		cerr << "ERROR: This memory backend does not support full system checkpoints (use the simple backend).\n";
+		abort();
+	}
+
+	void MemoryBackend::restore(StateReader &r)
+	{
+		cerr << "ERROR: This memory backend does not support full system checkpoints (use the simple backend).\n";
+		abort();
+	}
+
+
+	// -----------------------------------------------------------
+	// SimpleBackend
+
+	SimpleBackend::SimpleBackend(string name, const SimpleBackendConfig &config, SimpleBackendConfig (*ini_config)())
+	{
+		this->name = name;
+		this->ini_config = ini_config;
+
+		cycle = 0;
+		seq = 0;
+		outstanding = 0;
+		bus_free = 0;
+
+		set_config(config);
+
+		num_reads = 0;
+		num_writes = 0;
+		num_rejected = 0;
+		sum_read_latency = 0;
+		sum_write_latency = 0;
+	}
+
+	void SimpleBackend::set_config(const SimpleBackendConfig &config)
+	{
+		this->config = config;
+
+		if (this->config.num_banks == 0)
+			this->config.num_banks = 1;
+		if (this->config.queue_depth == 0)
+		{
+			cerr << "ERROR: " << name << " simple backend QUEUE_DEPTH must be at least 1.\n";
+			abort();
+		}
+		if (this->config.transaction_size == 0)
+		{
+			cerr << "ERROR: " << name << " simple backend transaction size must be at least 1.\n";
+			abort();
+		}
+
+		// If the number of banks changes, every new bank starts out busy until the last busy bank is free.
+		if (bank_free.size() != this->config.num_banks)
+		{
+			uint64_t busy_until = 0;
+			for (uint64_t i=0; i < bank_free.size(); i++)
+				busy_until = max(busy_until, bank_free[i]);
+			bank_free.assign(this->config.num_banks, busy_until);
+		}
+
+		// Bank hashing is only used if the number of banks is a power of two.
+		bank_bits = 0;
+		if ((this->config.num_banks > 1) && ((this->config.num_banks & (this->config.num_banks - 1)) == 0))
+		{
+			while ((1ULL << bank_bits) < this->config.num_banks)
+				bank_bits++;
+		}
+	}
+
+	void SimpleBackend::reconfigure()
+	{
+		// Transactions already issued keep their completion times. The new config applies to new ones.
+		if (ini_config != NULL)
+			set_config(ini_config());
+	}
+
+	bool SimpleBackend::addTransaction(bool isWrite, uint64_t addr)
+	{
+		if (outstanding >= config.queue_depth)
+		{
+			num_rejected++;
+			return false;
+		}
+
+		uint64_t latency = isWrite ? config.write_latency : config.read_latency;
+
+		// Wait for the bank. The bank is busy for the access latency or BANK_CYCLES, whichever is longer.
+		uint64_t bank = bank_index(addr);
+		uint64_t start = max(cycle, bank_free[bank]);
+		bank_free[bank] = start + max(latency, config.bank_cycles);
+
+		// Then wait for the data bus.
+		uint64_t transfer_start = max(start + latency, bus_free);
+		uint64_t finish = transfer_start + config.bus_cycles;
+		bus_free = finish;
+
+		// Every completion is at least one cycle after the transaction is added.
+		finish = max(finish, cycle + 1);
+
+		if (!isWrite && config.critical_line_first && (critical_line_done != NULL))
+		{
+			// The first line is ready after it has crossed the bus.
+			uint64_t line_cycles = (config.bus_cycles * BURST_SIZE + config.transaction_size - 1) / config.transaction_size;
+			uint64_t critical = max(transfer_start + line_cycles, cycle + 1);
+			completions.push(Completion(min(critical, finish), seq++, addr, false, true));
+		}
+		completions.push(Completion(finish, seq++, addr, isWrite, false));
+
+		if (isWrite)
+		{
+			num_writes++;
+			sum_write_latency += finish - cycle;
+		}
+		else
+		{
+			num_reads++;
+			sum_read_latency += finish - cycle;
+		}
+
+		outstanding++;
+		return true;
+	}
+
+	uint64_t SimpleBackend::bank_index(uint64_t addr)
+	{
+		uint64_t n = addr / config.transaction_size;
+
+		if (bank_bits == 0)
+			return n % config.num_banks;
+
+		// XOR all bank_bits wide fields of the transaction number together, like the bank hashing in
+		// memory controllers. Consecutive transactions still go to different banks, but large power of
+		// two strides (e.g. every page in one cache set) are spread over the banks too.
+		uint64_t bank = 0;
+		for (; n != 0; n >>= bank_bits)
+			bank ^= n;
+		return bank & (config.num_banks - 1);
+	}
+
+	void SimpleBackend::update()
+	{
+		while (!completions.empty() && (completions.top().cycle <= cycle))
+		{
+			Completion c = completions.top();
+			completions.pop();
+
+			if (c.critical)
+			{
+				(*critical_line_done)(0, c.addr, cycle);
+				continue;
+			}
+
+			outstanding--;
+
+			if (c.isWrite)
+			{
+				if (write_done != NULL)
+					(*write_done)(0, c.addr, cycle);
+			}
+			else
+			{
+				if (read_done != NULL)
+					(*read_done)(0, c.addr, cycle);
+			}
+		}
+
+		cycle++;
+	}
+
+	void SimpleBackend::saveStats()
+	{
+		cerr << name << " simple backend: reads=" << num_reads << " writes=" << num_writes
+			<< " rejected=" << num_rejected
+			<< " avg_read_latency=" << (num_reads ? (double)sum_read_latency / num_reads : 0.0)
+			<< " avg_write_latency=" << (num_writes ? (double)sum_write_latency / num_writes : 0.0) << "\n";
+	}
+
+	void SimpleBackend::checkpoint(StateWriter &w)
+	{
+		w.section("simple backend " + name);
+		w.put(config.num_banks);
+		w.put(cycle);
+		w.put(seq);
+		w.put(outstanding);
+		w.put(bus_free);
+		for (uint64_t i=0; i < bank_free.size(); i++)
+			w.put(bank_free[i]);
+
+		// Drain a copy of the heap so the completions are saved in the order they will fire.
+		priority_queue<Completion, vector<Completion>, greater<Completion> > tmp = completions;
+		w.put((uint64_t)tmp.size());
+		while (!tmp.empty())
+		{
+			const Completion &c = tmp.top();
+			w.put(c.cycle);
+			w.put(c.seq);
+			w.put(c.addr);
+			w.put(c.isWrite);
+			w.put(c.critical);
+			tmp.pop();
+		}
+
+		w.put(num_reads);
+		w.put(num_writes);
+		w.put(num_rejected);
+		w.put(sum_read_latency);
+		w.put(sum_write_latency);
+	}
+
+	void SimpleBackend::restore(StateReader &r)
+	{
+		r.section("simple backend " + name);
+		uint64_t num_banks;
+		r.get(num_banks);
+		if (num_banks != config.num_banks)
+		{
+			cerr << "ERROR: " << name << " simple backend NUM_BANKS does not match the checkpoint.\n";
+			abort();
+		}
+		r.get(cycle);
+		r.get(seq);
+		r.get(outstanding);
+		r.get(bus_free);
+		for (uint64_t i=0; i < bank_free.size(); i++)
+			r.get(bank_free[i]);
+
+		uint64_t n;
+		r.get(n);
+		completions = priority_queue<Completion, vector<Completion>, greater<Completion> >();
+		for (uint64_t i=0; i < n; i++)
+		{
+			Completion c(0, 0, 0, false, false);
+			r.get(c.cycle);
+			r.get(c.seq);
+			r.get(c.addr);
+			r.get(c.isWrite);
+			r.get(c.critical);
+			completions.push(c);
+		}
+
+		r.get(num_reads);
+		r.get(num_writes);
+		r.get(num_rejected);
+		r.get(sum_read_latency);
+		r.get(sum_write_latency);
+	}
+
+
+#ifndef HYBRIDSIM_STANDALONE
+	// -----------------------------------------------------------
+	// DRAMSim2 adapter
+
+	class DRAMSimBackend : public MemoryBackend
+	{
+		public:
+		DRAMSimBackend(string inipathPrefix, uint64_t dram_size)
+		{
+			dram = DRAMSim::getMemorySystemInstance(dram_ini, sys_ini, inipathPrefix, "resultsfilename", dram_size);
+
+			typedef DRAMSim::Callback <DRAMSimBackend, void, uint, uint64_t, uint64_t> dramsim_callback_t;
+			DRAMSim::TransactionCompleteCB *read_cb = new dramsim_callback_t(this, &DRAMSimBackend::ReadCallback);
+			DRAMSim::TransactionCompleteCB *write_cb = new dramsim_callback_t(this, &DRAMSimBackend::WriteCallback);
+			dram->RegisterCallbacks(read_cb, write_cb, NULL);
+		}
+
+		bool addTransaction(bool isWrite, uint64_t addr) { return dram->addTransaction(isWrite, addr); }
+		void update() { dram->update(); }
+
+		void ReadCallback(uint id, uint64_t addr, uint64_t cycle)
+		{
+			if (read_done != NULL)
+				(*read_done)(id, addr, cycle);
+		}
+
+		void WriteCallback(uint id, uint64_t addr, uint64_t cycle)
+		{
+			if (write_done != NULL)
+				(*write_done)(id, addr, cycle);
+		}
+
+		private:
+		DRAMSim::MultiChannelMemorySystem *dram;
+	};
+
+
+	// -----------------------------------------------------------
+	// NVDIMMSim adapter
+
+	class NVDIMMBackend : public MemoryBackend
+	{
+		public:
+		NVDIMMBackend(string inipathPrefix)
+		{
+			flash = NVDSim::getNVDIMMInstance(1,flash_ini,"ini/def_system.ini",inipathPrefix,"");
+
+			typedef NVDSim::Callback <NVDIMMBackend, void, uint, uint64_t, uint64_t, bool> nvdsim_callback_t;
+			NVDSim::Callback_t *nv_read_cb = new nvdsim_callback_t(this, &NVDIMMBackend::ReadCallback);
+			NVDSim::Callback_t *nv_write_cb = new nvdsim_callback_t(this, &NVDIMMBackend::WriteCallback);
+			NVDSim::Callback_t *nv_crit_cb = new nvdsim_callback_t(this, &NVDIMMBackend::CriticalLineCallback);
+			flash->RegisterCallbacks(nv_read_cb, nv_crit_cb, nv_write_cb, NULL);
+		}
+
+		bool addTransaction(bool isWrite, uint64_t addr) { return flash->addTransaction(isWrite, addr); }
+		void update() { flash->update(); }
+
+		void saveStats() { flash->saveStats(); }
+		void loadState(string filename) { flash->loadNVState(filename); }
+		void saveState(string filename) { flash->saveNVState(filename); }
+
+		void ReadCallback(uint id, uint64_t addr, uint64_t cycle, bool unmapped)
+		{
+			if (read_done != NULL)
+				(*read_done)(id, addr, cycle);
+		}
+
+		void CriticalLineCallback(uint id, uint64_t addr, uint64_t cycle, bool unmapped)
+		{
+			if (critical_line_done != NULL)
+				(*critical_line_done)(id, addr, cycle);
+		}
+
+		void WriteCallback(uint id, uint64_t addr, uint64_t cycle, bool unmapped)
+		{
+			if (write_done != NULL)
+				(*write_done)(id, addr, cycle);
+		}
+
+		private:
+		NVDSim::NVDIMM *flash;
+	};
+#endif
+
+
+	// -----------------------------------------------------------
+	// Factories
+
+	SimpleBackendConfig dramSimpleConfig()
+	{
+		SimpleBackendConfig config;
+		config.read_latency = DRAM_SIMPLE_READ_LATENCY;
+		config.write_latency = DRAM_SIMPLE_WRITE_LATENCY;
+		config.queue_depth = DRAM_SIMPLE_QUEUE_DEPTH;
+		config.bus_cycles = DRAM_SIMPLE_BUS_CYCLES;
+		config.num_banks = DRAM_SIMPLE_NUM_BANKS;
+		config.bank_cycles = DRAM_SIMPLE_BANK_CYCLES;
+		config.transaction_size = BURST_SIZE;
+		config.critical_line_first = false;
+		return config;
+	}
+
+	SimpleBackendConfig flashSimpleConfig()
+	{
+		SimpleBackendConfig config;
+		config.read_latency = FLASH_SIMPLE_READ_LATENCY;
+		config.write_latency = FLASH_SIMPLE_WRITE_LATENCY;
+		config.queue_depth = FLASH_SIMPLE_QUEUE_DEPTH;
+		config.bus_cycles = FLASH_SIMPLE_BUS_CYCLES;
+		config.num_banks = FLASH_SIMPLE_NUM_BANKS;
+		config.bank_cycles = FLASH_SIMPLE_BANK_CYCLES;
+		config.transaction_size = FLASH_BURST_SIZE;
+		config.critical_line_first = (FLASH_SIMPLE_CRIT_LINE_FIRST != 0);
+		return config;
+	}
+
+	MemoryBackend *createDRAMBackend(string inipathPrefix, uint64_t dram_size)
+	{
+		string backend = DRAM_BACKEND;
+
+#ifdef HYBRIDSIM_STANDALONE
+		if (backend == "dramsim2")
+		{
+			cerr << "WARNING: HybridSim was built without DRAMSim2, using the simple DRAM backend.\n";
+			backend = "simple";
+		}
+#else
+		if (backend == "dramsim2")
+		{
+			cerr << "Creating DRAM with " << dram_ini << "\n";
+			return new DRAMSimBackend(inipathPrefix, dram_size);
+		}
+#endif
+
+		if (backend == "simple")
+		{
+			cerr << "Creating DRAM with the simple backend\n";
+			return new SimpleBackend("DRAM", dramSimpleConfig(), dramSimpleConfig);
+		}
+
+		cerr << "ERROR: Unknown DRAM_BACKEND: " << DRAM_BACKEND << "\n";
+		abort();
+	}
+
+	MemoryBackend *createFlashBackend(string inipathPrefix)
+	{
+		string backend = FLASH_BACKEND;
+
+#ifdef HYBRIDSIM_STANDALONE
+		if (backend == "nvdimmsim")
+		{
+			cerr << "WARNING: HybridSim was built without NVDIMMSim, using the simple Flash backend.\n";
+			backend = "simple";
+		}
+#else
+		if (backend == "nvdimmsim")
+		{
+			cerr << "Creating Flash with " << flash_ini << "\n";
+			return new NVDIMMBackend(inipathPrefix);
+		}
+#endif
+
+		if (backend == "simple")
+		{
+			cerr << "Creating Flash with the simple backend\n";
+			return new SimpleBackend("Flash", flashSimpleConfig(), flashSimpleConfig);
+		}
+
+		cerr << "ERROR: Unknown FLASH_BACKEND: " << FLASH_BACKEND << "\n";
+		abort();
+	}
+}
@@ -0,0 +1,188 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_MEMORYBACKEND_H
+#define HYBRIDSIM_MEMORYBACKEND_H
+
+// Memory backends for the DRAM cache and the NVDIMM.
+//
+// HybridSystem talks to its DRAM and NVDIMM only through MemoryBackend. The backend for each is selected
+// with DRAM_BACKEND and FLASH_BACKEND in the ini file:
+//
+// dramsim2/nvdimmsim: adapters around the cycle accurate DRAMSim2 and NVDIMMSim libraries.
+// simple: SimpleBackend, a built-in analytical model with a fixed read/write latency, a limit on outstanding
+//         transactions, a shared data bus (bandwidth) and optionally independent banks. It has no external
+//         dependencies and is much faster than the cycle accurate simulators, so it is useful for functional
+//         runs and first order timing studies.
+//
+// A standalone build (HYBRIDSIM_STANDALONE) only has the simple backends.
+
+#include <queue>
+#include <vector>
+#include <stdint.h>
+
+#include "config.h"
+#include "CallbackHybrid.h"
+#include "Checkpoint.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	// Backend completion callback: (id, address, cycle)
+	typedef CallbackBase<void, uint, uint64_t, uint64_t> BackendCallback;
+
+	class MemoryBackend
+	{
+		public:
+		MemoryBackend();
+		virtual ~MemoryBackend() {}
+
+		// Returns false if the backend cannot accept the transaction this cycle.
+		virtual bool addTransaction(bool isWrite, uint64_t addr) = 0;
+		virtual void update() = 0;
+
+		// criticalLineDone may be NULL. If it is set, the backend calls it as soon as the first line of
+		// a read is available and then calls readDone when the whole transaction is done.
+		void RegisterCallbacks(BackendCallback *readDone, BackendCallback *criticalLineDone, BackendCallback *writeDone);
+
+		// Optional stats and state save/restore (only supported by NVDIMMSim).
+		virtual void saveStats() {}
+		virtual void loadState(string filename);
+		virtual void saveState(string filename);
+
+		// Save/restore the complete timing state, including in-flight transactions, for a full system
+		// checkpoint (see HybridSystem::saveSystemState). Only the simple backend supports this.
+		virtual void checkpoint(StateWriter &w);
+		virtual void restore(StateReader &r);
+
+		// Pick up ini file changes made after the backend was created (see HybridSystem::reconfigure).
+		virtual void reconfigure() {}
+
+		protected:
+		BackendCallback *read_done;
+		BackendCallback *critical_line_done;
+		BackendCallback *write_done;
+	};
+
+
+	// Parameters for SimpleBackend (all times are in HybridSim cycles).
+	struct SimpleBackendConfig
+	{
+		uint64_t read_latency;
+		uint64_t write_latency;
+		uint64_t queue_depth;
+		uint64_t bus_cycles; // data bus cycles per transaction
+		uint64_t num_banks;
+		uint64_t bank_cycles;
+		uint64_t transaction_size; // bytes per transaction (used for bank interleaving and critical line timing)
+		bool critical_line_first; // make the critical line callback for reads
+	};
+
+	class SimpleBackend : public MemoryBackend
+	{
+		public:
+		// ini_config (optional) reads the current config from the ini globals for reconfigure().
+		SimpleBackend(string name, const SimpleBackendConfig &config, SimpleBackendConfig (*ini_config)() = NULL);
+
+		bool addTransaction(bool isWrite, uint64_t addr);
+		void update();
+		void saveStats();
+
+		// The simple model keeps no persistent state (e.g. no FTL mapping), so checkpoints are no-ops.
+		void loadState(string filename) {}
+		void saveState(string filename) {}
+
+		void checkpoint(StateWriter &w);
+		void restore(StateReader &r);
+
+		void reconfigure();
+
+		private:
+		void set_config(const SimpleBackendConfig &config);
+		uint64_t bank_index(uint64_t addr);
+
+		class Completion
+		{
+			public:
+			uint64_t cycle;
+			uint64_t seq; // Keeps completions in the same cycle in issue order.
+			uint64_t addr;
+			bool isWrite;
+			bool critical; // Critical line callback (the read callback follows separately).
+
+			Completion(uint64_t c, uint64_t s, uint64_t a, bool w, bool crit)
+			{
+				cycle = c;
+				seq = s;
+				addr = a;
+				isWrite = w;
+				critical = crit;
+			}
+
+			bool operator>(const Completion &other) const
+			{
+				return (cycle > other.cycle) || ((cycle == other.cycle) && (seq > other.seq));
+			}
+		};
+
+		string name;
+		SimpleBackendConfig config;
+		SimpleBackendConfig (*ini_config)();
+
+		uint64_t cycle;
+		uint64_t seq;
+		uint64_t outstanding;
+
+		uint64_t bus_free; // Cycle when the data bus is next free.
+		vector<uint64_t> bank_free; // Cycle when each bank is next free.
+		uint64_t bank_bits; // log2(num_banks) if it is a power of two, otherwise 0 (plain interleaving).
+
+		priority_queue<Completion, vector<Completion>, greater<Completion> > completions;
+
+		// Stats
+		uint64_t num_reads;
+		uint64_t num_writes;
+		uint64_t num_rejected;
+		uint64_t sum_read_latency;
+		uint64_t sum_write_latency;
+	};
+
+
+	// The simple backend configs given by the DRAM_SIMPLE_* and FLASH_SIMPLE_* ini settings.
+	SimpleBackendConfig dramSimpleConfig();
+	SimpleBackendConfig flashSimpleConfig();
+
+	// Create the backends selected in the ini file.
+	MemoryBackend *createDRAMBackend(string inipathPrefix, uint64_t dram_size);
+	MemoryBackend *createFlashBackend(string inipathPrefix);
+}
+
+#endif
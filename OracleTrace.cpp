@@ -0,0 +1,122 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "OracleTrace.h"
+#include "TraceFile.h"
+
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+namespace HybridSim
+{
+	void OracleTrace::load(string tracefile)
+	{
+		sets.clear();
+		sets.resize(NUM_SETS);
+		total = 0;
+
+		TraceReader trace;
+		trace.open(tracefile);
+		TraceRecord rec;
+		while (trace.next(rec))
+		{
+			uint64_t addr = ALIGN(rec.address);
+			uint64_t tag = TAG(addr);
+			SetTrace &s = sets[SET_INDEX(addr)];
+			if ((tag >= NEVER) || (s.tags.size() >= NEVER))
+			{
+				cerr << "ERROR: Trace is too large for the oracle index (tag " << tag << ", " << s.tags.size() 
+					<< " accesses in set " << SET_INDEX(addr) << ").\n";
+				abort();
+			}
+			s.tags.push_back(tag);
+			total++;
+		}
+		trace.close();
+
+		for_each_set(bind(&OracleTrace::index_set, this, placeholders::_1));
+	}
+
+	void OracleTrace::index_set(uint64_t set)
+	{
+		// Walk the set backwards, remembering where each page is next used.
+		SetTrace &s = sets[set];
+		s.next.resize(s.tags.size());
+		unordered_map<uint32_t, uint32_t> &next_seen = s.first;
+		next_seen.clear();
+		for (uint64_t i=s.tags.size(); i > 0; i--)
+		{
+			uint32_t tag = s.tags[i-1];
+			unordered_map<uint32_t, uint32_t>::iterator it = next_seen.find(tag);
+			if (it == next_seen.end())
+			{
+				s.next[i-1] = NEVER;
+				next_seen[tag] = i-1;
+			}
+			else
+			{
+				s.next[i-1] = it->second;
+				it->second = i-1;
+			}
+		}
+
+		// What is left in next_seen is the first access of each page.
+	}
+
+	uint32_t OracleTrace::first_use(uint64_t set, uint64_t tag) const
+	{
+		unordered_map<uint32_t, uint32_t>::const_iterator it = sets[set].first.find(tag);
+		return (it == sets[set].first.end()) ? NEVER : it->second;
+	}
+
+	void OracleTrace::for_each_set(function<void (uint64_t)> fn)
+	{
+		// Sets vary a lot in size, so the threads take one set at a time instead of fixed chunks.
+		atomic<uint64_t> next_set(0);
+		uint64_t count = sets.size();
+		function<void ()> worker = [&]()
+		{
+			for (uint64_t set = next_set++; set < count; set = next_set++)
+				fn(set);
+		};
+
+		uint64_t num_threads = max(1U, thread::hardware_concurrency());
+		num_threads = min(num_threads, count);
+		vector<thread> workers;
+		for (uint64_t t=1; t < num_threads; t++)
+			workers.push_back(thread(worker));
+		worker();
+		for (uint64_t t=0; t < workers.size(); t++)
+			workers[t].join();
+	}
+}
@@ -0,0 +1,96 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_ORACLETRACE_H
+#define HYBRIDSIM_ORACLETRACE_H
+
+// Future knowledge of a trace for offline-optimal (Belady/OPT) studies.
+//
+// load() reads a trace (ASCII or binary) once and splits it into one access sequence per cache set, using the
+// geometry of the loaded ini file and the same address math as HybridSystem (ALIGN, SET_INDEX, TAG). It then
+// indexes every access with the position of the next access to the same page in that set. Each access takes
+// 8 bytes (a 32 bit tag and a 32 bit next use) plus one hash entry per distinct page, so traces with billions of
+// accesses still fit in memory.
+//
+// Sets are independent, so the indexing and anything else done per set (for_each_set()) is spread across
+// all hardware threads.
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "config.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	class OracleTrace
+	{
+		public:
+		// next_use() of an access whose page is never used again in its set.
+		static const uint32_t NEVER = 0xffffffff;
+
+		// Read tracefile and build the per set next use index.
+		void load(string tracefile);
+
+		uint64_t num_sets() const { return sets.size(); }
+		uint64_t total_accesses() const { return total; }
+
+		// Access i of a set (in trace order).
+		uint64_t accesses(uint64_t set) const { return sets[set].tags.size(); }
+		uint64_t tag(uint64_t set, uint64_t i) const { return sets[set].tags[i]; }
+		uint64_t page(uint64_t set, uint64_t i) const { return FLASH_ADDRESS(tag(set, i), set); }
+		uint32_t next_use(uint64_t set, uint64_t i) const { return sets[set].next[i]; }
+
+		// Index of the first access to the page with tag in set (NEVER if it is not in the trace).
+		uint32_t first_use(uint64_t set, uint64_t tag) const;
+
+		// Run fn(set) for every set, with the sets handed out dynamically to one thread per core.
+		void for_each_set(function<void (uint64_t)> fn);
+
+		private:
+		struct SetTrace
+		{
+			vector<uint32_t> tags;
+			vector<uint32_t> next;
+			unordered_map<uint32_t, uint32_t> first; // tag -> index of its first access
+		};
+
+		void index_set(uint64_t set);
+
+		vector<SetTrace> sets;
+		uint64_t total;
+	};
+}
+
+#endif
@@ -0,0 +1,295 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "PrefetchSchedule.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace HybridSim
+{
+	void savePrefetchSchedule(string filename, const vector<vector<PrefetchEntry> > &sets)
+	{
+		ofstream outFile;
+		outFile.open(filename.c_str(), ios::out | ios::binary | ios::trunc);
+		if (!outFile.is_open())
+		{
+			cerr << "ERROR: Failed to open prefetch file for writing: " << filename << "\n";
+			abort();
+		}
+
+		// The index is cumulative, so it goes out before any of the entries.
+		vector<uint64_t> offsets(sets.size()+1);
+		offsets[0] = 0;
+		for (uint64_t i=0; i < sets.size(); i++)
+			offsets[i+1] = offsets[i] + sets[i].size();
+
+		PrefetchScheduleHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, PREFETCH_SCHEDULE_MAGIC, 8);
+		header.version = PREFETCH_SCHEDULE_VERSION;
+		header.entry_size = sizeof(PrefetchEntry);
+		header.num_sets = sets.size();
+		header.num_entries = offsets[sets.size()];
+
+		outFile.write((const char *)&header, sizeof(header));
+		outFile.write((const char *)&offsets[0], offsets.size() * sizeof(uint64_t));
+		for (uint64_t i=0; i < sets.size(); i++)
+			if (!sets[i].empty())
+				outFile.write((const char *)&sets[i][0], sets[i].size() * sizeof(PrefetchEntry));
+
+		if (!outFile.good())
+		{
+			cerr << "ERROR: Failed to write prefetch file: " << filename << "\n";
+			abort();
+		}
+		outFile.close();
+	}
+
+	bool isBinaryPrefetchSchedule(string filename)
+	{
+		ifstream inFile;
+		inFile.open(filename.c_str(), ios::in | ios::binary);
+		if (!inFile.is_open())
+			return false;
+
+		char magic[8];
+		inFile.read(magic, 8);
+		return (inFile.gcount() == 8) && (memcmp(magic, PREFETCH_SCHEDULE_MAGIC, 8) == 0);
+	}
+
+
+	PrefetchSchedule::PrefetchSchedule() : offsets(NULL), entries(NULL), map(NULL), map_size(0)
+	{
+	}
+
+	PrefetchSchedule::~PrefetchSchedule()
+	{
+		release();
+	}
+
+	void PrefetchSchedule::release()
+	{
+		if (map != NULL)
+			munmap(map, map_size);
+		map = NULL;
+		map_size = 0;
+		offsets = NULL;
+		entries = NULL;
+		text_offsets.clear();
+		text_entries.clear();
+	}
+
+	void PrefetchSchedule::load(string filename, uint64_t num_sets)
+	{
+		release();
+
+		if (isBinaryPrefetchSchedule(filename))
+			load_binary(filename, num_sets);
+		else
+			load_text(filename, num_sets);
+
+		counter.assign(num_sets, 0);
+		cursor.assign(offsets, offsets + num_sets);
+	}
+
+	void PrefetchSchedule::load_binary(string filename, uint64_t num_sets)
+	{
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			cerr << "ERROR: Failed to load prefetch file: " << filename << "\n";
+			abort();
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(PrefetchScheduleHeader))
+		{
+			cerr << "ERROR: Invalid prefetch file format. File is truncated: " << filename << "\n";
+			abort();
+		}
+
+		map_size = st.st_size;
+		map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (map == MAP_FAILED)
+		{
+			map = NULL;
+			cerr << "ERROR: Failed to mmap prefetch file: " << filename << "\n";
+			abort();
+		}
+
+		const PrefetchScheduleHeader *header = (const PrefetchScheduleHeader *)map;
+		if (header->version != PREFETCH_SCHEDULE_VERSION || header->entry_size != sizeof(PrefetchEntry))
+		{
+			cerr << "ERROR: Unsupported prefetch file version " << header->version << " (expected " 
+				<< PREFETCH_SCHEDULE_VERSION << "): " << filename << "\n";
+			abort();
+		}
+		if (header->num_sets != num_sets)
+		{
+			cerr << "ERROR: Prefetch file was generated for " << header->num_sets << " sets but the cache has " 
+				<< num_sets << " sets.\n";
+			abort();
+		}
+		uint64_t expected_size = sizeof(PrefetchScheduleHeader) + (num_sets+1) * sizeof(uint64_t) + 
+			header->num_entries * sizeof(PrefetchEntry);
+		if (map_size != expected_size)
+		{
+			cerr << "ERROR: Invalid prefetch file format. Expected " << expected_size << " bytes but found "
+				<< map_size << ": " << filename << "\n";
+			abort();
+		}
+
+		offsets = (const uint64_t *)((const char *)map + sizeof(PrefetchScheduleHeader));
+		entries = (const PrefetchEntry *)(offsets + num_sets + 1);
+
+		// Only the index is checked here. The entries are left to be paged in as each set reaches them.
+		if (offsets[0] != 0 || offsets[num_sets] != header->num_entries)
+		{
+			cerr << "ERROR: Invalid prefetch file format. Bad set index: " << filename << "\n";
+			abort();
+		}
+		for (uint64_t i=0; i < num_sets; i++)
+		{
+			if (offsets[i] > offsets[i+1])
+			{
+				cerr << "ERROR: Invalid prefetch file format. Bad set index at set " << i << ": " << filename << "\n";
+				abort();
+			}
+		}
+	}
+
+	void PrefetchSchedule::load_text(string filename, uint64_t num_sets)
+	{
+		ifstream prefetch_file;
+		prefetch_file.open(filename.c_str(), ifstream::in);
+		if (!prefetch_file.is_open())
+		{
+			cerr << "ERROR: Failed to load prefetch file: " << filename << "\n";
+			abort();
+		}
+
+		// Declare variables for parsing string and uint64_t.
+		string parse_string;
+		uint64_t file_sets, cur_set, set_size, tmp_num;
+
+		// Parse prefetch data.
+		prefetch_file >> parse_string;
+		if (parse_string != "NUM_SETS")
+		{
+			cerr << "ERROR: Invalid prefetch file format. NUM_SETS does not appear at beginning.\n";
+			abort();
+		}
+		
+		prefetch_file >> file_sets;
+		if (file_sets != num_sets)
+		{
+			cerr << "ERROR: Prefetch file was generated for " << file_sets << " sets but the cache has " 
+				<< num_sets << " sets.\n";
+			abort();
+		}
+
+		text_offsets.assign(1, 0);
+		for (cur_set = 0; cur_set < num_sets; cur_set++)
+		{
+			prefetch_file >> parse_string;
+			if (parse_string != "SET")
+			{
+				cerr << "ERROR: Invalid prefetch file format. SET does not appear at beginning of set " << cur_set << ".\n";
+				abort();
+			}
+
+			prefetch_file >> tmp_num;
+			if (tmp_num != cur_set)
+			{
+				cerr << "ERROR: Invalid prefetch file format. Sets not given in order. (" << cur_set << ")\n";
+				abort();
+			}
+			
+			// Read the size of this set.
+			prefetch_file >> set_size;
+
+			// Process each prefetch.
+			for (uint64_t i=0; i < set_size; i++)
+			{
+				PrefetchEntry e;
+				prefetch_file >> e.access_number >> e.flush_addr >> e.new_addr;
+				text_entries.push_back(e);
+			}
+
+			if (prefetch_file.fail())
+			{
+				cerr << "ERROR: Invalid prefetch file format. File ends in set " << cur_set << ".\n";
+				abort();
+			}
+
+			text_offsets.push_back(text_entries.size());
+		}
+
+		prefetch_file.close();
+
+		offsets = &text_offsets[0];
+		entries = text_entries.empty() ? NULL : &text_entries[0];
+	}
+
+	void PrefetchSchedule::checkpoint(StateWriter &w)
+	{
+		w.put(counter);
+		w.put(cursor);
+	}
+
+	void PrefetchSchedule::restore(StateReader &r)
+	{
+		vector<uint64_t> saved_counter, saved_cursor;
+		r.get(saved_counter);
+		r.get(saved_cursor);
+		if ((saved_counter.size() != counter.size()) || (saved_cursor.size() != cursor.size()))
+		{
+			cerr << "ERROR: Prefetch file does not match the perfect prefetching state in the checkpoint.\n";
+			abort();
+		}
+		for (uint64_t i=0; i < saved_cursor.size(); i++)
+		{
+			if ((saved_cursor[i] < offsets[i]) || (saved_cursor[i] > offsets[i+1]))
+			{
+				cerr << "ERROR: Prefetch file does not match the perfect prefetching state in the checkpoint.\n";
+				abort();
+			}
+		}
+		counter.swap(saved_counter);
+		cursor.swap(saved_cursor);
+	}
+}
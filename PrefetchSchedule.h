@@ -0,0 +1,134 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_PREFETCHSCHEDULE_H
+#define HYBRIDSIM_PREFETCHSCHEDULE_H
+
+// Perfect prefetching schedules.
+//
+// A schedule lists, for each cache set, the prefetches to issue in access order: after the set has seen more
+// than access_number accesses, flush_addr is flushed from the cache and new_addr is prefetched in its place.
+//
+// The binary format is a 64 byte PrefetchScheduleHeader (magic "HYBPREF", version, entry size, set count and
+// entry count), then num_sets+1 uint64_t offsets (set i owns entries [offset[i], offset[i+1])), then the
+// PrefetchEntry array sorted by set, all in host byte order. The file is mmapped and each set is consumed
+// through its own cursor, so nothing is parsed at startup and only the pages of the schedule that are
+// actually reached are ever read.
+//
+// The older ASCII format ("NUM_SETS n", then "SET i count" followed by count "access_number flush_addr
+// new_addr" lines per set) is still accepted and converted in memory. Schedules are generated from a trace
+// with tools/perfect_prefetching/PrefetchGen.
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "config.h"
+#include "Checkpoint.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	const char PREFETCH_SCHEDULE_MAGIC[8] = {'H', 'Y', 'B', 'P', 'R', 'E', 'F', '\0'};
+	const uint32_t PREFETCH_SCHEDULE_VERSION = 1;
+
+	struct PrefetchScheduleHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t entry_size;
+		uint64_t num_sets;
+		uint64_t num_entries;
+		uint64_t reserved[4];
+	};
+
+	struct PrefetchEntry
+	{
+		uint64_t access_number;
+		uint64_t flush_addr;
+		uint64_t new_addr;
+	};
+
+	// Write a binary schedule with one list of entries per set.
+	void savePrefetchSchedule(string filename, const vector<vector<PrefetchEntry> > &sets);
+
+	// Returns true if filename starts with the binary schedule magic.
+	bool isBinaryPrefetchSchedule(string filename);
+
+	class PrefetchSchedule
+	{
+		public:
+		PrefetchSchedule();
+		~PrefetchSchedule();
+
+		// Load filename (binary or ASCII). The schedule must have been generated for num_sets sets.
+		void load(string filename, uint64_t num_sets);
+
+		// Count an access to set and return the prefetch that is due after it (NULL if none is).
+		// At most one prefetch is issued per access, as the schedule is generated that way.
+		const PrefetchEntry *access(uint64_t set)
+		{
+			counter[set]++;
+			if ((cursor[set] < offsets[set+1]) && (counter[set] > entries[cursor[set]].access_number))
+				return &entries[cursor[set]++];
+			return NULL;
+		}
+
+		// Save/restore the per set access counters and cursors (the schedule itself is reloaded from the file).
+		void checkpoint(StateWriter &w);
+		void restore(StateReader &r);
+
+		private:
+		// Not copyable (the schedule may own a mapping).
+		PrefetchSchedule(const PrefetchSchedule &);
+		PrefetchSchedule &operator=(const PrefetchSchedule &);
+
+		void load_binary(string filename, uint64_t num_sets);
+		void load_text(string filename, uint64_t num_sets);
+		void release();
+
+		const uint64_t *offsets;
+		const PrefetchEntry *entries;
+
+		// Mapping of a binary schedule.
+		void *map;
+		uint64_t map_size;
+
+		// Storage for a converted ASCII schedule.
+		vector<uint64_t> text_offsets;
+		vector<PrefetchEntry> text_entries;
+
+		vector<uint64_t> counter; // accesses seen by each set
+		vector<uint64_t> cursor; // index of the next entry to issue for each set
+	};
+}
+
+#endif
@@ -0,0 +1,252 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "PrefetchThrottle.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+namespace HybridSim
+{
+	PrefetchThrottle::PrefetchThrottle()
+	{
+		level = PREFETCH_THROTTLE_START_LEVEL;
+		late_prefetches = 0;
+		pollution_misses = 0;
+		level_increases = 0;
+		level_decreases = 0;
+		next_epoch = 0;
+		epoch_filled = 0;
+		epoch_used = 0;
+		epoch_late = 0;
+		epoch_misses = 0;
+		epoch_pollution = 0;
+		accuracy = 0;
+		lateness = 0;
+		pollution = 0;
+	}
+
+	void PrefetchThrottle::init()
+	{
+		if (PREFETCH_THROTTLE_EPOCH == 0)
+		{
+			cerr << "ERROR: PREFETCH_THROTTLE_EPOCH must be greater than 0.\n";
+			abort();
+		}
+		if (PREFETCH_POLLUTION_FILTER_SIZE == 0)
+		{
+			cerr << "ERROR: PREFETCH_POLLUTION_FILTER_SIZE must be greater than 0.\n";
+			abort();
+		}
+
+		level = PREFETCH_THROTTLE_START_LEVEL;
+		next_epoch = PREFETCH_THROTTLE_EPOCH;
+		in_flight.clear();
+		pollution_filter.assign((PREFETCH_POLLUTION_FILTER_SIZE + 63) / 64, 0);
+	}
+
+	void PrefetchThrottle::update(uint64_t cycle)
+	{
+		if (cycle < next_epoch)
+			return;
+		next_epoch = cycle + PREFETCH_THROTTLE_EPOCH;
+
+		if (epoch_filled == 0)
+		{
+			// Nothing to measure. If prefetching was off, turn it back on at the lowest level to find out
+			// whether it would help now.
+			if (level == 0)
+			{
+				level = 1;
+				level_increases++;
+			}
+			epoch_misses = 0;
+			epoch_pollution = 0;
+			return;
+		}
+
+		accuracy = (accuracy + (double)epoch_used / epoch_filled) / 2;
+		if (epoch_used > 0)
+			lateness = (lateness + (double)epoch_late / epoch_used) / 2;
+		if (epoch_misses > 0)
+			pollution = (pollution + (double)epoch_pollution / epoch_misses) / 2;
+
+		bool late = (lateness > PREFETCH_LATENESS_THRESHOLD);
+		bool polluting = (pollution > PREFETCH_POLLUTION_THRESHOLD);
+
+		// Srinath et al. table 2, except that inaccurate prefetching is always turned down (the paper leaves it
+		// alone if it is neither late nor polluting). Wasted prefetches still take NVDIMM bandwidth from demand
+		// misses, which matters much more here than in an L2 cache.
+		int direction = 0;
+		if (accuracy >= PREFETCH_ACCURACY_HIGH)
+		{
+			if (late)
+				direction = 1;
+			else if (polluting)
+				direction = -1;
+		}
+		else if (accuracy >= PREFETCH_ACCURACY_LOW)
+		{
+			if (late && !polluting)
+				direction = 1;
+			else if (polluting)
+				direction = -1;
+		}
+		else
+		{
+			direction = -1;
+		}
+
+		if ((direction > 0) && (level < PREFETCH_THROTTLE_LEVELS - 1))
+		{
+			level++;
+			level_increases++;
+		}
+		else if ((direction < 0) && (level > 0))
+		{
+			level--;
+			level_decreases++;
+		}
+
+		epoch_filled = 0;
+		epoch_used = 0;
+		epoch_late = 0;
+		epoch_misses = 0;
+		epoch_pollution = 0;
+	}
+
+	uint64_t PrefetchThrottle::scale(uint64_t depth)
+	{
+		if ((level == 0) || (depth == 0))
+			return 0;
+		return max((depth << level) / (1 << PREFETCH_THROTTLE_START_LEVEL), (uint64_t)1);
+	}
+
+	void PrefetchThrottle::prefetch_issued(uint64_t page_addr)
+	{
+		in_flight.insert(page_addr);
+	}
+
+	void PrefetchThrottle::prefetch_dropped(uint64_t page_addr)
+	{
+		in_flight.erase(page_addr);
+	}
+
+	void PrefetchThrottle::prefetch_filled(uint64_t page_addr)
+	{
+		in_flight.erase(page_addr);
+		test_and_clear(page_addr);
+		epoch_filled++;
+	}
+
+	void PrefetchThrottle::prefetch_used()
+	{
+		epoch_used++;
+	}
+
+	void PrefetchThrottle::prefetch_evicted(uint64_t victim_page_addr)
+	{
+		uint64_t bit = (victim_page_addr / PAGE_SIZE) % PREFETCH_POLLUTION_FILTER_SIZE;
+		pollution_filter[bit / 64] |= (1ULL << (bit % 64));
+	}
+
+	void PrefetchThrottle::demand_access(uint64_t page_addr)
+	{
+		// A demand access that arrives while the prefetch of its page is still queued or being filled has to
+		// wait for it. Each prefetch is only counted as late once.
+		if (in_flight.erase(page_addr) > 0)
+		{
+			epoch_late++;
+			late_prefetches++;
+		}
+	}
+
+	void PrefetchThrottle::demand_miss(uint64_t page_addr)
+	{
+		epoch_misses++;
+		if (test_and_clear(page_addr))
+		{
+			epoch_pollution++;
+			pollution_misses++;
+		}
+	}
+
+	bool PrefetchThrottle::test_and_clear(uint64_t page_addr)
+	{
+		uint64_t bit = (page_addr / PAGE_SIZE) % PREFETCH_POLLUTION_FILTER_SIZE;
+		uint64_t mask = 1ULL << (bit % 64);
+		bool set = (pollution_filter[bit / 64] & mask) != 0;
+		pollution_filter[bit / 64] &= ~mask;
+		return set;
+	}
+
+	void PrefetchThrottle::checkpoint(StateWriter &w)
+	{
+		w.put(level);
+		w.put(late_prefetches);
+		w.put(pollution_misses);
+		w.put(level_increases);
+		w.put(level_decreases);
+		w.put(next_epoch);
+		w.put(epoch_filled);
+		w.put(epoch_used);
+		w.put(epoch_late);
+		w.put(epoch_misses);
+		w.put(epoch_pollution);
+		w.put(accuracy);
+		w.put(lateness);
+		w.put(pollution);
+		w.put(in_flight);
+		w.put(pollution_filter);
+	}
+
+	void PrefetchThrottle::restore(StateReader &r)
+	{
+		r.get(level);
+		r.get(late_prefetches);
+		r.get(pollution_misses);
+		r.get(level_increases);
+		r.get(level_decreases);
+		r.get(next_epoch);
+		r.get(epoch_filled);
+		r.get(epoch_used);
+		r.get(epoch_late);
+		r.get(epoch_misses);
+		r.get(epoch_pollution);
+		r.get(accuracy);
+		r.get(lateness);
+		r.get(pollution);
+		r.get(in_flight);
+		r.get(pollution_filter);
+	}
+}
@@ -0,0 +1,117 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_PREFETCHTHROTTLE_H
+#define HYBRIDSIM_PREFETCHTHROTTLE_H
+
+// Feedback directed prefetch throttling (ENABLE_PREFETCH_THROTTLE).
+//
+// Every PREFETCH_THROTTLE_EPOCH cycles, the throttle looks at how the prefetches did:
+//   accuracy: prefetched pages that were used before being evicted / prefetched pages
+//   lateness: used prefetches that a demand access had to wait for / used prefetches
+//   pollution: demand misses to pages that a prefetch evicted / demand misses
+// Each metric is averaged with its value from the previous epochs, and the throttle level is moved up or
+// down one step following Srinath et al., "Feedback Directed Prefetching" (HPCA 2007). The level scales the
+// depth of the sequential and stream buffer prefetchers (see scale()); level 0 turns them off. Neither one
+// keeps enough state to tell its streams apart, so they share the level. The stride prefetcher does, and
+// adjusts the depth of each stream from that stream's own accuracy and lateness (see StridePrefetcher.h).
+// Perfect prefetching is not throttled.
+
+#include <vector>
+#include <unordered_set>
+#include <stdint.h>
+
+#include "config.h"
+#include "Checkpoint.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	const uint64_t PREFETCH_THROTTLE_LEVELS = 5;
+	const uint64_t PREFETCH_THROTTLE_START_LEVEL = 3; // the configured depths
+
+	class PrefetchThrottle
+	{
+		public:
+		PrefetchThrottle();
+
+		void init();
+
+		// Called every cycle. Adjusts the level at the end of each epoch.
+		void update(uint64_t cycle);
+
+		// Scale a configured prefetch depth by the current level (0, 1/4, 1/2, 1 or 2 times, but at least 1
+		// while prefetching is on).
+		uint64_t scale(uint64_t depth);
+
+		// Events from the controller.
+		void prefetch_issued(uint64_t page_addr);
+		void prefetch_dropped(uint64_t page_addr); // the page was already in the cache
+		void prefetch_filled(uint64_t page_addr);
+		void prefetch_used();
+		void prefetch_evicted(uint64_t victim_page_addr); // a prefetch fill evicted this page
+		void demand_access(uint64_t page_addr);
+		void demand_miss(uint64_t page_addr);
+
+		void checkpoint(StateWriter &w);
+		void restore(StateReader &r);
+
+		uint64_t level;
+
+		// Stats
+		uint64_t late_prefetches;
+		uint64_t pollution_misses;
+		uint64_t level_increases;
+		uint64_t level_decreases;
+
+		private:
+		bool test_and_clear(uint64_t page_addr);
+
+		uint64_t next_epoch;
+
+		// Counts for the current epoch.
+		uint64_t epoch_filled;
+		uint64_t epoch_used;
+		uint64_t epoch_late;
+		uint64_t epoch_misses;
+		uint64_t epoch_pollution;
+
+		// Averages over the previous epochs.
+		double accuracy;
+		double lateness;
+		double pollution;
+
+		unordered_set<uint64_t> in_flight; // pages with a prefetch queued or being filled
+		vector<uint64_t> pollution_filter; // one bit per page hash, set when a prefetch evicts the page
+	};
+}
+
+#endif
@@ -0,0 +1,267 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "Profiler.h"
+
+#include <cstring>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+namespace HybridSim
+{
+	static const char *phase_names[NUM_PROFILE_PHASES] =
+	{
+		"update_other",
+		"add_transaction",
+		"queue_scan",
+		"tag_lookup",
+		"backend_issue",
+		"logger",
+		"dram_update",
+		"flash_update",
+		"callback"
+	};
+
+	Profiler::Profiler()
+	{
+		ticks_per_ns = 1.0;
+		tsc_overhead = 0;
+		depth = 0;
+		last_tsc = 0;
+		sample_countdown = 0;
+	}
+
+	Profiler::~Profiler()
+	{
+		if (savefile.is_open())
+			savefile.close();
+	}
+
+	void Profiler::init()
+	{
+		calibrate();
+
+		depth = 0;
+		last_tsc = read_tsc();
+		sample_countdown = 0;
+
+		if (PROFILER_SAMPLE_PERIOD == 0)
+		{
+			cerr << "ERROR: PROFILER_SAMPLE_PERIOD must be at least 1\n";
+			abort();
+		}
+
+		memset(cur_ticks, 0, sizeof(cur_ticks));
+		memset(total_ticks, 0, sizeof(total_ticks));
+		cur_cycles = 0;
+		total_cycles = 0;
+		cur_accesses = 0;
+		total_accesses = 0;
+		epoch_count = 0;
+
+		savefile.open("hybridsim_profile.log", ios_base::out | ios_base::trunc);
+		if (!savefile.is_open())
+		{
+			cerr << "ERROR: HybridSim Profiler unable to open hybridsim_profile.log\n";
+			abort();
+		}
+		savefile << "HybridSim host time profile\n";
+		savefile << "tsc ticks per ns: " << ticks_per_ns << "\n";
+		savefile << "tsc read overhead: " << tsc_overhead << " ticks\n";
+		savefile << "sample period: " << PROFILER_SAMPLE_PERIOD << " cycles\n\n";
+	}
+
+	uint64_t Profiler::read_tsc()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		// No timestamp counter, so fall back to the monotonic clock (1 tick = 1 ns).
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+	}
+
+	void Profiler::calibrate()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		// Measure the TSC rate against the monotonic clock over about 10 ms.
+		struct timespec start, now;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		uint64_t tsc_start = read_tsc();
+		uint64_t elapsed_ns = 0;
+		while (elapsed_ns < 10000000)
+		{
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			elapsed_ns = (uint64_t)(now.tv_sec - start.tv_sec) * 1000000000 + now.tv_nsec - start.tv_nsec;
+		}
+		uint64_t tsc_stop = read_tsc();
+		ticks_per_ns = (double)(tsc_stop - tsc_start) / elapsed_ns;
+#else
+		ticks_per_ns = 1.0;
+#endif
+
+		// Measure the smallest interval between two back to back reads. Every interval that is charged to
+		// a phase includes one read, so this is subtracted again in charge().
+		tsc_overhead = (uint64_t)-1;
+		for (unsigned i = 0; i < 1000; i++)
+		{
+			uint64_t a = read_tsc();
+			uint64_t b = read_tsc();
+			if (b - a < tsc_overhead)
+				tsc_overhead = b - a;
+		}
+	}
+
+	void Profiler::charge(ProfilePhase phase, uint64_t now)
+	{
+		uint64_t elapsed = now - last_tsc;
+		if (elapsed > tsc_overhead)
+			cur_ticks[phase] += elapsed - tsc_overhead;
+		last_tsc = now;
+	}
+
+	void Profiler::enter(ProfilePhase phase)
+	{
+		uint64_t now = read_tsc();
+
+		// Charge the time so far to the enclosing phase.
+		if (depth > 0)
+			charge(stack[depth-1], now);
+
+		if (depth == PROFILE_STACK_DEPTH)
+		{
+			cerr << "ERROR: HybridSim Profiler phase stack overflow\n";
+			abort();
+		}
+		stack[depth] = phase;
+		depth++;
+		last_tsc = now;
+	}
+
+	void Profiler::exit()
+	{
+		uint64_t now = read_tsc();
+
+		assert(depth > 0);
+		depth--;
+		charge(stack[depth], now);
+	}
+
+	void Profiler::next(ProfilePhase phase)
+	{
+		uint64_t now = read_tsc();
+
+		assert(depth > 0);
+		charge(stack[depth-1], now);
+		stack[depth-1] = phase;
+	}
+
+	void Profiler::update()
+	{
+		cur_cycles++;
+
+		if (sample_countdown == 0)
+			sample_countdown = PROFILER_SAMPLE_PERIOD - 1;
+		else
+			sample_countdown--;
+
+		if (cur_cycles == EPOCH_LENGTH)
+			epoch_reset();
+	}
+
+	void Profiler::epoch_reset()
+	{
+		savefile << "---------------------------------------------------\n";
+		savefile << "Epoch " << epoch_count << "\n";
+		print_phases(savefile, cur_ticks, cur_cycles, cur_accesses);
+		savefile << "\n";
+
+		for (unsigned i = 0; i < NUM_PROFILE_PHASES; i++)
+		{
+			total_ticks[i] += cur_ticks[i];
+			cur_ticks[i] = 0;
+		}
+		total_cycles += cur_cycles;
+		cur_cycles = 0;
+		cur_accesses = 0;
+		epoch_count++;
+	}
+
+	void Profiler::print_phases(ofstream &out, uint64_t *ticks, uint64_t cycles, uint64_t accesses)
+	{
+		uint64_t sum = 0;
+		for (unsigned i = 0; i < NUM_PROFILE_PHASES; i++)
+			sum += ticks[i];
+
+		// Scale the sampled cycles up to the whole interval.
+		double scale = (double)PROFILER_SAMPLE_PERIOD / ticks_per_ns;
+
+		out << "cycles: " << cycles << "\n";
+		out << "accesses: " << accesses << "\n";
+		out << "host time: " << (sum * scale) / 1000000.0 << " ms\n";
+		out << "phase\tns/cycle\tns/access\tpercent\n";
+		for (unsigned i = 0; i < NUM_PROFILE_PHASES; i++)
+		{
+			double ns = ticks[i] * scale;
+			out << phase_names[i] << "\t"
+				<< (cycles ? ns / cycles : 0.0) << "\t"
+				<< (accesses ? ns / accesses : 0.0) << "\t"
+				<< (sum ? (100.0 * ticks[i]) / sum : 0.0) << "\n";
+		}
+
+		// Group the phases by simulator so it is easy to see which one dominates.
+		double hybridsim = 0.0;
+		for (unsigned i = 0; i < NUM_PROFILE_PHASES; i++)
+			if ((i != PROFILE_DRAM_UPDATE) && (i != PROFILE_FLASH_UPDATE))
+				hybridsim += ticks[i];
+		out << "HybridSim: " << (sum ? (100.0 * hybridsim) / sum : 0.0) << "%\t"
+			<< "DRAMSim2: " << (sum ? (100.0 * ticks[PROFILE_DRAM_UPDATE]) / sum : 0.0) << "%\t"
+			<< "NVDIMMSim: " << (sum ? (100.0 * ticks[PROFILE_FLASH_UPDATE]) / sum : 0.0) << "%\n";
+	}
+
+	void Profiler::print()
+	{
+		uint64_t ticks[NUM_PROFILE_PHASES];
+		for (unsigned i = 0; i < NUM_PROFILE_PHASES; i++)
+			ticks[i] = total_ticks[i] + cur_ticks[i];
+
+		savefile << "===================================================\n";
+		savefile << "Total\n";
+		print_phases(savefile, ticks, total_cycles + cur_cycles, total_accesses);
+		savefile.flush();
+	}
+}
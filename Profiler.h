@@ -0,0 +1,157 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_PROFILER_H
+#define HYBRIDSIM_PROFILER_H
+
+// Self-profiling of HybridSim's host time.
+//
+// The Profiler splits the host time spent inside HybridSystem into phases using the CPU timestamp counter.
+// Phases nest, and each phase is charged only its exclusive time. For example, the time spent in the
+// HybridSim callbacks is not charged to the DRAMSim2/NVDIMMSim update that called them. Any time in
+// update() not covered by a more specific phase is charged to PROFILE_UPDATE_OTHER.
+//
+// The results are written to hybridsim_profile.log every epoch and at the end of the run, as host
+// nanoseconds per simulated cycle and per access. Profiling is enabled with ENABLE_PROFILER in the ini
+// file and is compiled out entirely in a fast build.
+//
+// Reading the timestamp counter takes a few ns on bare metal but can be much slower in a virtual
+// machine. PROFILER_SAMPLE_PERIOD=N times only one cycle in every N and scales the results by N.
+
+#include <fstream>
+#include <stdint.h>
+
+#include "config.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	enum ProfilePhase
+	{
+		PROFILE_UPDATE_OTHER, // Everything in update() not covered below
+		PROFILE_ADD_TRANSACTION, // addTransaction() calls from the driver
+		PROFILE_QUEUE_SCAN, // Scanning trans_queue for an unlocked page
+		PROFILE_TAG_LOOKUP, // ProcessTransaction (tag lookup, hit/miss handling)
+		PROFILE_BACKEND_ISSUE, // Moving dram_queue/flash_queue entries into the backends
+		PROFILE_LOGGER, // Logger::update
+		PROFILE_DRAM_UPDATE, // DRAMSim2 update (excluding HybridSim callbacks)
+		PROFILE_FLASH_UPDATE, // NVDIMMSim update (excluding HybridSim callbacks)
+		PROFILE_CALLBACK, // HybridSim callbacks from DRAMSim2 and NVDIMMSim
+		NUM_PROFILE_PHASES
+	};
+
+	// Maximum nesting depth of phases.
+	const unsigned PROFILE_STACK_DEPTH = 16;
+
+	class Profiler
+	{
+		public:
+		Profiler();
+		~Profiler();
+
+		void init();
+
+		// Enter and exit a phase. These must be strictly nested.
+		void enter(ProfilePhase phase);
+		void exit();
+
+		// Switch the current phase to another one at the same nesting level.
+		// This is the same as exit() followed by enter(), but only reads the timestamp counter once.
+		void next(ProfilePhase phase);
+
+		// Count an access (used for the per access numbers).
+		void access() { cur_accesses++; total_accesses++; }
+
+		// Is the current cycle being timed?
+		bool sampling() const { return sample_countdown == 0; }
+
+		// Count a simulated cycle and roll over the epoch every EPOCH_LENGTH cycles.
+		void update();
+
+		void print();
+
+		private:
+		static uint64_t read_tsc();
+		void calibrate();
+		void epoch_reset();
+		void charge(ProfilePhase phase, uint64_t now);
+		void print_phases(ofstream &out, uint64_t *ticks, uint64_t cycles, uint64_t accesses);
+
+		double ticks_per_ns;
+		uint64_t tsc_overhead; // Cost of reading the timestamp counter (subtracted from each interval)
+
+		// Phase stack.
+		ProfilePhase stack[PROFILE_STACK_DEPTH];
+		unsigned depth;
+		uint64_t last_tsc;
+
+		// Cycles left until the next sampled cycle.
+		uint64_t sample_countdown;
+
+		// Per epoch and cumulative state.
+		uint64_t cur_ticks[NUM_PROFILE_PHASES];
+		uint64_t total_ticks[NUM_PROFILE_PHASES];
+		uint64_t cur_cycles;
+		uint64_t total_cycles;
+		uint64_t cur_accesses;
+		uint64_t total_accesses;
+		uint64_t epoch_count;
+
+		ofstream savefile;
+	};
+
+	// Scoped phase timer. Does nothing unless profiling is compiled in and enabled and this cycle is sampled.
+	class ProfileScope
+	{
+		public:
+		ProfileScope(Profiler &p, ProfilePhase phase) : profiler(p)
+		{
+			is_active = Instrumentation::profiling() && profiler.sampling();
+			if (is_active)
+				profiler.enter(phase);
+		}
+
+		~ProfileScope()
+		{
+			if (is_active)
+				profiler.exit();
+		}
+
+		// Is this scope being timed? Phase switches inside the scope should check this.
+		bool active() const { return is_active; }
+
+		private:
+		Profiler &profiler;
+		bool is_active;
+	};
+}
+
+#endif
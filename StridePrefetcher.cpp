@@ -0,0 +1,440 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "StridePrefetcher.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+namespace HybridSim
+{
+	// Confidence saturates here, so a long stream recovers quickly after a misprediction.
+	const uint64_t STRIDE_MAX_CONFIDENCE = 3;
+
+	// A confident stream has just passed the pages up to this many strides behind it.
+	const uint64_t STRIDE_TRAILING_STRIDES = 2;
+
+	// Prefetches of a stream that are judged together by feedback().
+	const uint64_t STRIDE_FEEDBACK_WINDOW = 8;
+
+	StridePrefetcher::StridePrefetcher()
+	{
+		streams_allocated = 0;
+		stride_confirmations = 0;
+		stride_mispredictions = 0;
+		feedback_increases = 0;
+		feedback_decreases = 0;
+		clock = 0;
+		next_id = 0;
+	}
+
+	void StridePrefetcher::init()
+	{
+		if ((STRIDE_MIN_DEPTH == 0) || (STRIDE_MIN_DEPTH > STRIDE_MAX_DEPTH))
+		{
+			cerr << "ERROR: Invalid stride prefetcher depth " << STRIDE_MIN_DEPTH << "-" << STRIDE_MAX_DEPTH
+				<< " (STRIDE_MIN_DEPTH must be at least 1 and at most STRIDE_MAX_DEPTH).\n";
+			abort();
+		}
+
+		Stream empty;
+		empty.valid = false;
+		empty.last_page = 0;
+		empty.stride = 0;
+		empty.confidence = 0;
+		empty.depth = STRIDE_MIN_DEPTH;
+		empty.prefetched_to = 0;
+		empty.lru = 0;
+		empty.id = 0;
+		empty.limit = STRIDE_MAX_DEPTH;
+		empty.resolved = 0;
+		empty.used = 0;
+		empty.late = 0;
+		table.assign(STRIDE_NUM_STREAMS, empty);
+		by_last.clear();
+		clock = 0;
+		prefetched_by.clear();
+		in_flight.clear();
+		late_pages.clear();
+		next_id = 0;
+	}
+
+	static bool more_recent(const pair<uint64_t, uint64_t> &a, const pair<uint64_t, uint64_t> &b)
+	{
+		return a.first > b.first;
+	}
+
+	void StridePrefetcher::reconfigure()
+	{
+		// Keep the most recently used streams that still fit.
+		vector<Stream> old = table;
+		vector<pair<uint64_t, uint64_t> > order; // (lru, index)
+		for (uint64_t i=0; i < old.size(); i++)
+		{
+			if (old[i].valid)
+				order.push_back(make_pair(old[i].lru, i));
+		}
+		sort(order.begin(), order.end(), more_recent);
+
+		uint64_t saved_clock = clock;
+		uint64_t saved_id = next_id;
+		unordered_map<uint64_t, uint64_t> saved_prefetched_by = prefetched_by;
+		unordered_set<uint64_t> saved_in_flight = in_flight;
+		unordered_set<uint64_t> saved_late_pages = late_pages;
+		init();
+		clock = saved_clock;
+		next_id = saved_id;
+		prefetched_by = saved_prefetched_by;
+		in_flight = saved_in_flight;
+		late_pages = saved_late_pages;
+		for (uint64_t i=0; (i < order.size()) && (i < table.size()); i++)
+		{
+			table[i] = old[order[i].second];
+			table[i].depth = min(max(table[i].depth, STRIDE_MIN_DEPTH), STRIDE_MAX_DEPTH);
+			table[i].limit = min(table[i].limit, STRIDE_MAX_DEPTH);
+			by_last[table[i].last_page] = i;
+		}
+	}
+
+	void StridePrefetcher::access(uint64_t page_addr, vector<uint64_t> &prefetches)
+	{
+		prefetches.clear();
+		if (table.empty())
+			return;
+
+		uint64_t page = page_addr / PAGE_SIZE;
+
+		// The first demand access to a prefetched page uses the prefetch.
+		if (!prefetched_by.empty())
+			resolve(page, true);
+
+		// Repeated accesses within the last page of a stream don't move it.
+		unordered_map<uint64_t, uint64_t>::iterator it = by_last.find(page);
+		if (it != by_last.end())
+		{
+			table[it->second].lru = ++clock;
+			return;
+		}
+
+		// Find the stream that predicted this page, or else the nearest one.
+		uint64_t predicted = table.size();
+		uint64_t nearest = table.size();
+		uint64_t nearest_distance = STRIDE_MAX_DISTANCE + 1;
+		uint64_t lru = 0;
+		for (uint64_t i=0; i < table.size(); i++)
+		{
+			Stream &s = table[i];
+			if (!s.valid)
+			{
+				if (table[lru].valid)
+					lru = i;
+				continue;
+			}
+			if (table[lru].valid && (s.lru < table[lru].lru))
+				lru = i;
+
+			if ((s.stride != 0) && ((int64_t)s.last_page + s.stride == (int64_t)page))
+			{
+				predicted = i;
+				break;
+			}
+
+			uint64_t distance = (page > s.last_page) ? page - s.last_page : s.last_page - page;
+
+			// Farther behind a confident stream than its trailing pages, this is some other stream
+			// (e.g. one going the other way), so leave this one alone.
+			int64_t delta = (int64_t)page - (int64_t)s.last_page;
+			if ((s.confidence > 0) && ((delta < 0) != (s.stride < 0))
+				&& (distance > STRIDE_TRAILING_STRIDES * (uint64_t)llabs(s.stride)))
+				continue;
+
+			if (distance < nearest_distance)
+			{
+				nearest = i;
+				nearest_distance = distance;
+			}
+		}
+
+		// A confident stream ignores its trailing pages and accepts a jump of a few strides ahead. Accesses to
+		// a page are queued while it is being filled, so the lines of neighbouring pages are often seen out of order.
+		if ((predicted == table.size()) && (nearest < table.size()) && (table[nearest].confidence > 0))
+		{
+			Stream &s = table[nearest];
+			int64_t delta = (int64_t)page - (int64_t)s.last_page;
+			if ((delta < 0) != (s.stride < 0))
+			{
+				s.lru = ++clock;
+				return;
+			}
+			if ((delta % s.stride == 0) && (delta / s.stride <= (int64_t)s.depth + 1))
+				predicted = nearest;
+		}
+
+		uint64_t cur;
+		if (predicted < table.size())
+		{
+			cur = predicted;
+			Stream &s = table[cur];
+			stride_confirmations++;
+			if (s.confidence < STRIDE_MAX_CONFIDENCE)
+				s.confidence++;
+			else
+				s.depth = min(s.depth * 2, STRIDE_MAX_DEPTH);
+		}
+		else if (nearest < table.size())
+		{
+			cur = nearest;
+			Stream &s = table[cur];
+			stride_mispredictions++;
+			if (s.confidence > 0)
+			{
+				// Keep the stride for now (this could be a one-off), but back off.
+				s.confidence--;
+				s.depth = max(s.depth / 2, STRIDE_MIN_DEPTH);
+			}
+			else
+			{
+				s.stride = (int64_t)page - (int64_t)s.last_page;
+				s.depth = STRIDE_MIN_DEPTH;
+			}
+			s.prefetched_to = page;
+		}
+		else
+		{
+			// A new stream replaces the least recently used one.
+			cur = lru;
+			Stream &s = table[cur];
+			if (s.valid)
+				by_last.erase(s.last_page);
+			s.valid = true;
+			s.last_page = page;
+			s.stride = 0;
+			s.confidence = 0;
+			s.depth = STRIDE_MIN_DEPTH;
+			s.prefetched_to = page;
+			s.id = ++next_id;
+			s.limit = STRIDE_MAX_DEPTH;
+			s.resolved = 0;
+			s.used = 0;
+			s.late = 0;
+			streams_allocated++;
+		}
+
+		Stream &s = table[cur];
+		if (s.last_page != page)
+			by_last.erase(s.last_page);
+		s.last_page = page;
+		s.lru = ++clock;
+		by_last[page] = cur;
+
+		if ((s.stride == 0) || (s.confidence < STRIDE_CONFIDENCE_THRESHOLD))
+			return;
+
+		// A stream that feedback turned off tries again after a while.
+		if (s.limit == 0)
+		{
+			if ((predicted == cur) && (++s.resolved >= STRIDE_FEEDBACK_WINDOW))
+			{
+				s.limit = 1;
+				s.resolved = 0;
+				feedback_increases++;
+			}
+			return;
+		}
+
+		// Prefetch up to depth strides ahead, skipping what was already prefetched for this stride.
+		// If the stream has moved past the prefetched pages, start again from the current page.
+		int64_t ahead = ((int64_t)s.prefetched_to - (int64_t)page) / s.stride;
+		if (ahead < 0)
+			ahead = 0;
+		for (int64_t i=ahead+1; i <= (int64_t)min(s.depth, s.limit); i++)
+		{
+			int64_t next = (int64_t)page + i * s.stride;
+			if ((next < 0) || ((uint64_t)next >= TOTAL_PAGES))
+				break;
+			prefetches.push_back((uint64_t)next * PAGE_SIZE);
+			s.prefetched_to = next;
+			if (ENABLE_PREFETCH_THROTTLE)
+			{
+				prefetched_by[next] = s.id;
+				in_flight.insert(next);
+			}
+		}
+	}
+
+	void StridePrefetcher::prefetch_dropped(uint64_t page_addr)
+	{
+		uint64_t page = page_addr / PAGE_SIZE;
+		prefetched_by.erase(page);
+		in_flight.erase(page);
+		late_pages.erase(page);
+	}
+
+	void StridePrefetcher::prefetch_filled(uint64_t page_addr)
+	{
+		in_flight.erase(page_addr / PAGE_SIZE);
+	}
+
+	void StridePrefetcher::prefetch_evicted_unused(uint64_t page_addr)
+	{
+		resolve(page_addr / PAGE_SIZE, false);
+	}
+
+	void StridePrefetcher::demand_arrival(uint64_t page_addr)
+	{
+		uint64_t page = page_addr / PAGE_SIZE;
+		if (in_flight.erase(page) > 0)
+			late_pages.insert(page);
+	}
+
+	void StridePrefetcher::resolve(uint64_t page, bool used)
+	{
+		unordered_map<uint64_t, uint64_t>::iterator it = prefetched_by.find(page);
+		if (it == prefetched_by.end())
+			return;
+		uint64_t id = it->second;
+		prefetched_by.erase(it);
+		in_flight.erase(page);
+		bool late = (late_pages.erase(page) > 0);
+
+		// The stream may have been replaced since it issued the prefetch.
+		for (uint64_t i=0; i < table.size(); i++)
+		{
+			Stream &s = table[i];
+			if (!s.valid || (s.id != id) || (s.limit == 0))
+				continue;
+			s.resolved++;
+			if (used)
+				s.used++;
+			if (late)
+				s.late++;
+			if (s.resolved >= STRIDE_FEEDBACK_WINDOW)
+				feedback(s);
+			return;
+		}
+	}
+
+	void StridePrefetcher::feedback(Stream &s)
+	{
+		double accuracy = (double)s.used / s.resolved;
+		double lateness = (s.used > 0) ? (double)s.late / s.used : 0;
+
+		if (accuracy < PREFETCH_ACCURACY_LOW)
+		{
+			s.limit /= 2;
+			feedback_decreases++;
+		}
+		else if ((lateness > PREFETCH_LATENESS_THRESHOLD) && (s.limit < STRIDE_MAX_DEPTH))
+		{
+			s.limit = min(s.limit * 2, STRIDE_MAX_DEPTH);
+			feedback_increases++;
+		}
+
+		s.resolved = 0;
+		s.used = 0;
+		s.late = 0;
+	}
+
+	void StridePrefetcher::put(StateWriter &w, const Stream &s)
+	{
+		w.put(s.valid);
+		w.put(s.last_page);
+		w.put(s.stride);
+		w.put(s.confidence);
+		w.put(s.depth);
+		w.put(s.prefetched_to);
+		w.put(s.lru);
+		w.put(s.id);
+		w.put(s.limit);
+		w.put(s.resolved);
+		w.put(s.used);
+		w.put(s.late);
+	}
+
+	void StridePrefetcher::get(StateReader &r, Stream &s)
+	{
+		r.get(s.valid);
+		r.get(s.last_page);
+		r.get(s.stride);
+		r.get(s.confidence);
+		r.get(s.depth);
+		r.get(s.prefetched_to);
+		r.get(s.lru);
+		r.get(s.id);
+		r.get(s.limit);
+		r.get(s.resolved);
+		r.get(s.used);
+		r.get(s.late);
+	}
+
+	void StridePrefetcher::checkpoint(StateWriter &w)
+	{
+		w.put((uint64_t)table.size());
+		for (uint64_t i=0; i < table.size(); i++)
+			put(w, table[i]);
+		w.put(clock);
+		w.put(streams_allocated);
+		w.put(stride_confirmations);
+		w.put(stride_mispredictions);
+		w.put(feedback_increases);
+		w.put(feedback_decreases);
+		w.put(prefetched_by);
+		w.put(in_flight);
+		w.put(late_pages);
+		w.put(next_id);
+	}
+
+	void StridePrefetcher::restore(StateReader &r)
+	{
+		uint64_t n;
+		r.get(n);
+		table.resize(n);
+		by_last.clear();
+		for (uint64_t i=0; i < n; i++)
+		{
+			get(r, table[i]);
+			if (table[i].valid)
+				by_last[table[i].last_page] = i;
+		}
+		r.get(clock);
+		r.get(streams_allocated);
+		r.get(stride_confirmations);
+		r.get(stride_mispredictions);
+		r.get(feedback_increases);
+		r.get(feedback_decreases);
+		r.get(prefetched_by);
+		r.get(in_flight);
+		r.get(late_pages);
+		r.get(next_id);
+	}
+}
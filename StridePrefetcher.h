@@ -0,0 +1,131 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_STRIDEPREFETCHER_H
+#define HYBRIDSIM_STRIDEPREFETCHER_H
+
+// Stride prefetcher (ENABLE_STRIDE_PREFETCHER).
+//
+// A reference prediction table without program counters: each entry follows one stream of demand page
+// accesses, with its last page, its stride in pages (which may be negative) and a confidence counter. A page
+// that the table predicted (last + stride) confirms its stream. Otherwise the stream whose last page is
+// nearest (within STRIDE_MAX_DISTANCE pages) is retrained, and if there is none, the least recently used
+// entry is replaced with a new stream. A confident stream ignores the pages it has just passed, but a page
+// farther behind it belongs to some other stream (e.g. one going the other way). Once a stream reaches STRIDE_CONFIDENCE_THRESHOLD, every confirmation
+// prefetches up to depth strides ahead of it. The depth starts at STRIDE_MIN_DEPTH, doubles with each
+// confirmation up to STRIDE_MAX_DEPTH and halves on each misprediction.
+//
+// With ENABLE_PREFETCH_THROTTLE, each stream also gets feedback on its own prefetches (see feedback()).
+// Every STRIDE_FEEDBACK_WINDOW of its prefetches that are used or evicted unused, the stream's limit on
+// the depth is halved if fewer than PREFETCH_ACCURACY_LOW of them were used, and doubled (up to
+// STRIDE_MAX_DEPTH) if more than PREFETCH_LATENESS_THRESHOLD of the used ones were late. A stream whose
+// limit reaches 0 stops prefetching and tries again with a limit of 1 after STRIDE_FEEDBACK_WINDOW
+// more confirmations.
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <stdint.h>
+
+#include "config.h"
+#include "Checkpoint.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	class StridePrefetcher
+	{
+		public:
+		StridePrefetcher();
+
+		// Clear the table and apply the STRIDE_* settings.
+		void init();
+
+		// Apply changed STRIDE_* settings without losing the streams.
+		void reconfigure();
+
+		// Observe a demand access to page_addr. The pages to prefetch are returned in prefetches, nearest first.
+		void access(uint64_t page_addr, vector<uint64_t> &prefetches);
+
+		// Feedback events from the controller (ENABLE_PREFETCH_THROTTLE).
+		void prefetch_dropped(uint64_t page_addr); // the page was already in the cache
+		void prefetch_filled(uint64_t page_addr);
+		void prefetch_evicted_unused(uint64_t page_addr);
+		void demand_arrival(uint64_t page_addr); // addTransaction(), before the access waits in the queue
+
+		void checkpoint(StateWriter &w);
+		void restore(StateReader &r);
+
+		// Stats
+		uint64_t streams_allocated;
+		uint64_t stride_confirmations;
+		uint64_t stride_mispredictions;
+		uint64_t feedback_increases;
+		uint64_t feedback_decreases;
+
+		private:
+		struct Stream
+		{
+			bool valid;
+			uint64_t last_page; // page number
+			int64_t stride; // in pages
+			uint64_t confidence;
+			uint64_t depth;
+			uint64_t prefetched_to; // farthest page number prefetched for the current stride
+			uint64_t lru;
+
+			// Feedback (ENABLE_PREFETCH_THROTTLE).
+			uint64_t id; // tells the streams that used a table entry apart
+			uint64_t limit; // most strides ahead this stream may prefetch (0 = not prefetching)
+			uint64_t resolved; // prefetches used or evicted unused (confirmations while the limit is 0)
+			uint64_t used;
+			uint64_t late;
+		};
+
+		void resolve(uint64_t page, bool used);
+		void feedback(Stream &s);
+
+		void put(StateWriter &w, const Stream &s);
+		void get(StateReader &r, Stream &s);
+
+		vector<Stream> table;
+		unordered_map<uint64_t, uint64_t> by_last; // last page number -> stream
+		uint64_t clock;
+
+		// Prefetches that have not been used or evicted yet (page numbers).
+		unordered_map<uint64_t, uint64_t> prefetched_by; // page -> stream id
+		unordered_set<uint64_t> in_flight; // not filled yet
+		unordered_set<uint64_t> late_pages; // a demand access arrived before the fill
+		uint64_t next_id;
+	};
+}
+
+#endif
@@ -33,9 +33,13 @@
 
 #include "TraceBasedSim.h"
 
+#include <sys/wait.h>
+#include <unistd.h>
+
 using namespace HybridSim;
 using namespace std;
 
+// Throttling for ini files without an INPUT_QUEUE_DEPTH, where HybridSim accepts everything.
 const uint64_t MAX_PENDING = 36;
 const uint64_t MIN_PENDING = 35;
 uint64_t complete = 0;
@@ -50,6 +54,116 @@ uint64_t trace_cycles = 0;
 uint64_t last_clock = 0;
 uint64_t CLOCK_DELAY = 1000000;
 
+// Full system checkpoint options (see usage()).
+uint64_t save_cycle = 0;
+string save_file = "";
+string restore_file = "";
+
+// Warmup sharing options (see fork_variants()).
+uint64_t fork_cycle = 0;
+list<string> fork_inis;
+
+void usage()
+{
+	cout << "Usage: HybridSim [trace-file] [-save <cycle> <state-file>] [-restore <state-file>] [-fork <cycle> <ini-file> ...]\n";
+	cout << "  -save    saves the full system state when the trace reaches <cycle> and then keeps running\n";
+	cout << "  -restore restores the full system state and continues the trace from where it was saved\n";
+	cout << "  -fork    runs the trace up to <cycle> once, then finishes it once per ini file, each in its own\n";
+	cout << "           process and output directory (fork_<n>_<ini-name>) with that ini file applied\n";
+	exit(1);
+}
+
+void copy_file(string from, string to)
+{
+	ifstream in(from.c_str(), ios_base::in | ios_base::binary);
+	if (!in.is_open())
+		return;
+	ofstream out(to.c_str(), ios_base::out | ios_base::trunc | ios_base::binary);
+	out << in.rdbuf();
+}
+
+// Share one warmup between several configurations. The trace up to fork_cycle is simulated once, then one
+// child process is forked per ini file. Each child applies its ini file with HybridSystem::reconfigure()
+// and finishes the trace in its own directory. The warmed up state is shared copy-on-write, so only the
+// pages a child changes are copied. This returns in the children. The parent waits for them and exits.
+// records_read is the number of trace records read so far.
+void fork_variants(HybridSystem *mem, TraceReader &trace, string tracefile, uint64_t records_read)
+{
+	// Anything buffered now would otherwise be written once by every child.
+	TraceWriter::flush_all();
+	cout.flush();
+	cerr.flush();
+	fflush(NULL);
+
+	list<pair<pid_t, string> > children;
+	uint64_t n = 0;
+	for (list<string>::iterator it = fork_inis.begin(); it != fork_inis.end(); it++, n++)
+	{
+		string ini = *it;
+		string name = ini.substr(ini.rfind('/') + 1);
+		name = name.substr(0, name.rfind('.'));
+		stringstream dir;
+		dir << "fork_" << n << "_" << name;
+		confirm_directory_exists(dir.str());
+
+		pid_t pid = fork();
+		if (pid < 0)
+		{
+			cerr << "ERROR: fork failed for " << ini << "\n";
+			abort();
+		}
+		if (pid == 0)
+		{
+			// Read the ini file before changing directories so relative paths still work.
+			mem->reconfigure(ini);
+
+			// The children share the parent's trace file offset, so each one reopens the trace and
+			// skips to where the parent was.
+			trace.close();
+			trace.open(tracefile);
+			TraceRecord rec;
+			for (uint64_t i=0; i < records_read; i++)
+				trace.next(rec);
+
+			if (chdir(dir.str().c_str()) != 0)
+			{
+				cerr << "ERROR: Failed to change to directory " << dir.str() << "\n";
+				abort();
+			}
+			if ((freopen("hybridsim.out", "w", stdout) == NULL) || (freopen("hybridsim.out", "a", stderr) == NULL))
+				abort();
+
+			// The binary debug traces were flushed above and still point at the parent's files. Each
+			// child writes its own from the fork on.
+			TraceWriter::reopen_all();
+
+			// Start from the epoch logs of the shared warmup. Later epochs are appended to these copies.
+			copy_file("../hybridsim_epoch.log", "hybridsim_epoch.log");
+			copy_file("../hybridsim_epoch.csv", "hybridsim_epoch.csv");
+
+			cout << "Forked at trace cycle " << trace_cycles << " with " << ini << "\n";
+			fork_inis.clear();
+			return;
+		}
+		children.push_back(make_pair(pid, dir.str()));
+	}
+
+	cout << "Forked " << children.size() << " runs at trace cycle " << trace_cycles << "\n";
+
+	int failed = 0;
+	for (list<pair<pid_t, string> >::iterator it = children.begin(); it != children.end(); it++)
+	{
+		int status;
+		waitpid(it->first, &status, 0);
+		bool ok = WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+		cout << it->second << ": " << (ok ? "done" : "FAILED") << "\n";
+		if (!ok)
+			failed++;
+	}
+
+	exit(failed ? 1 : 0);
+}
+
 
 int main(int argc, char *argv[])
 {
@@ -67,6 +181,34 @@ int main(int argc, char *argv[])
 		cout << "Using default trace file (traces/test.txt)\n";
 	}
 
+	for (int i=2; i < argc; i++)
+	{
+		string arg = argv[i];
+		if ((arg == "-save") && (i+2 < argc))
+		{
+			save_cycle = strtoull(argv[i+1], NULL, 10);
+			save_file = argv[i+2];
+			i += 2;
+		}
+		else if ((arg == "-restore") && (i+1 < argc))
+		{
+			restore_file = argv[i+1];
+			i += 1;
+		}
+		else if ((arg == "-fork") && (i+2 < argc))
+		{
+			fork_cycle = strtoull(argv[i+1], NULL, 10);
+			i += 1;
+			while ((i+1 < argc) && (argv[i+1][0] != '-'))
+			{
+				fork_inis.push_back(argv[i+1]);
+				i += 1;
+			}
+		}
+		else
+			usage();
+	}
+
 	obj.run_trace(tracefile);
 }
 
@@ -114,92 +256,104 @@ int HybridSimTBS::run_trace(string tracefile)
 	Callback_t *write_cb = new Callback<HybridSimTBS, void, uint, uint64_t, uint64_t>(this, &HybridSimTBS::write_complete);
 	mem->RegisterCallbacks(read_cb, write_cb);
 
-	// Open input file
-	ifstream inFile;
-	inFile.open(tracefile, ifstream::in);
-	if (!inFile.is_open())
-	{
-		cout << "ERROR: Failed to load tracefile: " << tracefile << "\n";
-		abort();
-	}
-	
+	// The number of trace records that have been added to HybridSim.
+	uint64_t trace_position = 0;
 
-	char char_line[256];
-	string line;
+	// OPT replacement looks ahead in this trace unless the ini file names another one.
+	if ((REPLACEMENT_POLICY == "OPT") && (ORACLE_TRACE_FILE == "none"))
+		mem->loadOracle(tracefile);
 
-	while (inFile.good())
+	if (restore_file != "")
 	{
-		// Read the next line.
-		inFile.getline(char_line, 256);
-		line = (string)char_line;
-
-		// Filter comments out.
-		size_t pos = line.find("#");
-		line = line.substr(0, pos);
-
-		// Strip whitespace from the ends.
-		line = strip(line);
-
-		// Filter newlines out.
-		if (line.empty())
-			continue;
-
-		// Split and parse.
-		list<string> split_line = split(line);
-
-		if (split_line.size() != 3)
-		{
-			cout << "ERROR: Parsing trace failed on line:\n" << line << "\n";
-			cout << "There should be exactly three numbers per line\n";
-			cout << "There are " << split_line.size() << endl;
-			abort();
-		}
+		StateReader r;
+		r.open(restore_file);
+		r.section("tracebasedsim");
+		r.get(trace_position);
+		r.get(trace_cycles);
+		r.get(complete);
+		r.get(pending);
+		r.get(throttle_count);
+		r.get(throttle_cycles);
+		r.get(last_clock);
+		mem->restoreSystemState(r);
+		r.close();
+		cout << "Restored state from " << restore_file << " at trace cycle " << trace_cycles << "\n";
+	}
 
-		uint64_t line_vals[3];
+	// Open input file (ASCII or binary trace)
+	TraceReader trace;
+	trace.open(tracefile);
 
-		int i = 0;
-		for (list<string>::iterator it = split_line.begin(); it != split_line.end(); it++, i++)
+	TraceRecord rec;
+	uint64_t skip = trace_position;
+	while (trace.next(rec))
+	{
+		// Skip the part of the trace that was already run before the restored checkpoint.
+		if (skip > 0)
 		{
-			// convert string to integer
-			uint64_t tmp;
-			convert_uint64_t(tmp, (*it));
-			line_vals[i] = tmp;
+			skip--;
+			continue;
 		}
 
-		// Finish parsing.
-		uint64_t trans_cycle = line_vals[0];
-		bool write = line_vals[1] % 2;
-		uint64_t addr = line_vals[2];
+		uint64_t trans_cycle = rec.cycle;
+		bool write = rec.op;
+		uint64_t addr = rec.address;
 
 		// increment the counter until >= the clock cycle of cur transaction
 		// for each cycle, call the update() function.
 		while (trace_cycles < trans_cycle)
 		{
+			if ((save_file != "") && (trace_cycles == save_cycle))
+			{
+				// The current record has not been added yet, so a restore reads it again.
+				StateWriter w;
+				w.open(save_file);
+				w.section("tracebasedsim");
+				w.put(trace_position);
+				w.put(trace_cycles);
+				w.put(complete);
+				w.put(pending);
+				w.put(throttle_count);
+				w.put(throttle_cycles);
+				w.put(last_clock);
+				mem->saveSystemState(w);
+				w.close();
+				cout << "Saved state to " << save_file << " at trace cycle " << trace_cycles << "\n";
+			}
+
+			if (!fork_inis.empty() && (trace_cycles == fork_cycle))
+				fork_variants(mem, trace, tracefile, trace_position + 1);
+
 			mem->update();
 			trace_cycles++;
 		}
 
 		// add the transaction and continue
-		mem->addTransaction(write, addr);
+		while (!mem->addTransaction(write, addr))
+		{
+			mem->update();
+			throttle_cycles++;
+		}
 		pending++;
+		trace_position++;
 
-		// If the pending count goes above MAX_PENDING, wait until it goes back below MIN_PENDING before adding more 
-		// transactions. This throttling will prevent the memory system from getting overloaded.
-		if (pending >= MAX_PENDING)
+		// Once INPUT_QUEUE_DEPTH accesses are outstanding, HybridSim accepts no more until one completes.
+		// Stall the trace right away (not at the next record) so the memory system is not overloaded.
+		// With INPUT_QUEUE_DEPTH=0, wait from MAX_PENDING until pending is back down to MIN_PENDING instead.
+		bool unlimited = (INPUT_QUEUE_DEPTH == 0);
+		if (!mem->WillAcceptTransaction() || (unlimited && (pending >= MAX_PENDING)))
 		{
-			//cout << "MAX_PENDING REACHED! Throttling the trace until pending is back below MIN_PENDING.\t\tcycle= " << trace_cycles << "\n";
 			throttle_count++;
-			while (pending > MIN_PENDING)
+			while (!mem->WillAcceptTransaction() || (unlimited && (pending > MIN_PENDING)))
 			{
 				mem->update();
 				throttle_cycles++;
 			}
-			//cout << "Back to MIN_PENDING. Allowing transactions to be added again.\t\tcycle= " << trace_cycles << "\n";
 		}
 
 	}
 
-	inFile.close();
+	trace.close();
 
 
 	//mem->syncAll();
@@ -0,0 +1,313 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#include "TraceFile.h"
+
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace HybridSim
+{
+	list<TraceWriter *> TraceWriter::open_writers;
+	bool TraceWriter::exit_flush_registered = false;
+
+	TraceWriter::TraceWriter()
+	{
+		fd = -1;
+		buffer_count = 0;
+	}
+
+	TraceWriter::~TraceWriter()
+	{
+		close();
+	}
+
+	void TraceWriter::open(string filename)
+	{
+		this->filename = filename;
+
+		fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+		{
+			cerr << "ERROR: Failed to open binary trace file: " << filename << "\n";
+			abort();
+		}
+
+		buffer.resize(TRACE_BUFFER_RECORDS);
+		buffer_count = 0;
+
+		// Write the header.
+		char header[16];
+		uint32_t version = TRACE_VERSION;
+		uint32_t record_size = sizeof(TraceRecord);
+		memcpy(header, TRACE_MAGIC, 8);
+		memcpy(header+8, &version, 4);
+		memcpy(header+12, &record_size, 4);
+		if (::write(fd, header, 16) != 16)
+		{
+			cerr << "ERROR: Failed to write binary trace header: " << filename << "\n";
+			abort();
+		}
+
+		open_writers.push_back(this);
+
+		// Flush whatever is left when the process exits without closing the writer. Signal handlers
+		// are left to the program that owns the process (e.g. MARSS).
+		if (!exit_flush_registered)
+		{
+			atexit(TraceWriter::flush_all);
+			exit_flush_registered = true;
+		}
+	}
+
+	void TraceWriter::write(uint64_t cycle, bool isWrite, uint64_t address)
+	{
+		TraceRecord &rec = buffer[buffer_count];
+		rec.cycle = cycle;
+		rec.address = address;
+		rec.op = isWrite ? 1 : 0;
+		rec.reserved = 0;
+		buffer_count++;
+
+		if (buffer_count == TRACE_BUFFER_RECORDS)
+			flush();
+	}
+
+	void TraceWriter::flush()
+	{
+		if ((fd < 0) || (buffer_count == 0))
+			return;
+
+		const char *data = (const char *)&buffer[0];
+		size_t remaining = buffer_count * sizeof(TraceRecord);
+		while (remaining > 0)
+		{
+			ssize_t written = ::write(fd, data, remaining);
+			if (written < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				cerr << "ERROR: Failed to write binary trace file: " << filename << "\n";
+				abort();
+			}
+			data += written;
+			remaining -= written;
+		}
+
+		buffer_count = 0;
+	}
+
+	void TraceWriter::close()
+	{
+		if (fd < 0)
+			return;
+
+		flush();
+		::close(fd);
+		fd = -1;
+
+		open_writers.remove(this);
+	}
+
+	bool TraceWriter::is_open()
+	{
+		return (fd >= 0);
+	}
+
+	void TraceWriter::flush_all()
+	{
+		list<TraceWriter *>::iterator it;
+		for (it = open_writers.begin(); it != open_writers.end(); it++)
+			(*it)->flush();
+	}
+
+	void TraceWriter::reopen_all()
+	{
+		// open() pushes the writer back onto open_writers, so walk a copy.
+		list<TraceWriter *> writers = open_writers;
+		open_writers.clear();
+
+		list<TraceWriter *>::iterator it;
+		for (it = writers.begin(); it != writers.end(); it++)
+		{
+			TraceWriter *w = *it;
+			w->buffer_count = 0;
+			::close(w->fd);
+			w->fd = -1;
+			w->open(w->filename);
+		}
+	}
+
+
+	TraceReader::TraceReader()
+	{
+		binary = false;
+		buffer_count = 0;
+		buffer_pos = 0;
+	}
+
+	TraceReader::~TraceReader()
+	{
+		close();
+	}
+
+	void TraceReader::open(string filename)
+	{
+		this->filename = filename;
+
+		inFile.open(filename.c_str(), ifstream::in | ifstream::binary);
+		if (!inFile.is_open())
+		{
+			cerr << "ERROR: Failed to load tracefile: " << filename << "\n";
+			abort();
+		}
+
+		// Check for the binary trace header.
+		char header[16];
+		inFile.read(header, 16);
+		if ((inFile.gcount() == 16) && (memcmp(header, TRACE_MAGIC, 8) == 0))
+		{
+			uint32_t version, record_size;
+			memcpy(&version, header+8, 4);
+			memcpy(&record_size, header+12, 4);
+			if ((version != TRACE_VERSION) || (record_size != sizeof(TraceRecord)))
+			{
+				cerr << "ERROR: Unsupported binary trace version or record size in " << filename << "\n";
+				abort();
+			}
+
+			binary = true;
+			buffer.resize(TRACE_BUFFER_RECORDS);
+		}
+		else
+		{
+			// ASCII trace. Start over from the beginning.
+			binary = false;
+			inFile.clear();
+			inFile.seekg(0);
+		}
+	}
+
+	bool TraceReader::next(TraceRecord &rec)
+	{
+		if (binary)
+			return next_binary(rec);
+		else
+			return next_text(rec);
+	}
+
+	bool TraceReader::is_binary()
+	{
+		return binary;
+	}
+
+	void TraceReader::close()
+	{
+		if (inFile.is_open())
+			inFile.close();
+	}
+
+	bool TraceReader::next_binary(TraceRecord &rec)
+	{
+		if (buffer_pos == buffer_count)
+		{
+			// Refill the buffer.
+			inFile.read((char *)&buffer[0], TRACE_BUFFER_RECORDS * sizeof(TraceRecord));
+			buffer_count = inFile.gcount() / sizeof(TraceRecord);
+			buffer_pos = 0;
+
+			if (buffer_count == 0)
+				return false;
+		}
+
+		rec = buffer[buffer_pos];
+		buffer_pos++;
+		return true;
+	}
+
+	bool TraceReader::next_text(TraceRecord &rec)
+	{
+		char char_line[256];
+		string line;
+
+		while (inFile.good())
+		{
+			// Read the next line.
+			inFile.getline(char_line, 256);
+			line = (string)char_line;
+
+			// Filter comments out.
+			size_t pos = line.find("#");
+			line = line.substr(0, pos);
+
+			// Strip whitespace from the ends.
+			line = strip(line);
+
+			// Filter newlines out.
+			if (line.empty())
+				continue;
+
+			// Split and parse.
+			list<string> split_line = split(line);
+
+			if (split_line.size() != 3)
+			{
+				cout << "ERROR: Parsing trace failed on line:\n" << line << "\n";
+				cout << "There should be exactly three numbers per line\n";
+				cout << "There are " << split_line.size() << endl;
+				abort();
+			}
+
+			uint64_t line_vals[3] = {0, 0, 0};
+
+			int i = 0;
+			for (list<string>::iterator it = split_line.begin(); it != split_line.end(); it++, i++)
+			{
+				// convert string to integer
+				uint64_t tmp;
+				convert_uint64_t(tmp, (*it));
+				line_vals[i] = tmp;
+			}
+
+			rec.cycle = line_vals[0];
+			rec.op = line_vals[1] % 2;
+			rec.address = line_vals[2];
+			rec.reserved = 0;
+			return true;
+		}
+
+		return false;
+	}
+}
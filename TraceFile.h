@@ -0,0 +1,124 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+#ifndef HYBRIDSIM_TRACEFILE_H
+#define HYBRIDSIM_TRACEFILE_H
+
+// Trace file input and output.
+//
+// HybridSim traces are either ASCII (one "cycle op address" line per access, see the README) or binary.
+// A binary trace starts with an 8 byte magic string ("HYBTRACE"), a 32 bit version and a 32 bit
+// record size, followed by packed TraceRecord entries in host byte order.
+//
+// TraceWriter always writes the binary format, so any trace captured by HybridSim (e.g. with
+// DEBUG_FULL_TRACE) can be replayed directly by TraceBasedSim. TraceReader accepts both formats.
+
+#include <string>
+#include <fstream>
+#include <list>
+#include <vector>
+#include <stdint.h>
+
+#include "util.h"
+
+using namespace std;
+
+namespace HybridSim
+{
+	const char TRACE_MAGIC[8] = {'H', 'Y', 'B', 'T', 'R', 'A', 'C', 'E'};
+	const uint32_t TRACE_VERSION = 1;
+
+	// Number of records a TraceWriter buffers before writing them to the file.
+	const uint64_t TRACE_BUFFER_RECORDS = 262144;
+
+	struct TraceRecord
+	{
+		uint64_t cycle;
+		uint64_t address;
+		uint32_t op; // 0 = read, 1 = write
+		uint32_t reserved;
+	};
+
+	class TraceWriter
+	{
+		public:
+		TraceWriter();
+		~TraceWriter();
+
+		void open(string filename);
+		void write(uint64_t cycle, bool isWrite, uint64_t address);
+		void flush();
+		void close();
+		bool is_open();
+
+		// Flush every open writer. This is called on checkpoints, from printLogfile() and at exit
+		// so that the trace up to that point is not lost.
+		static void flush_all();
+
+		// Reopen every writer under the current directory, dropping anything still buffered. A
+		// forked child calls this after flush_all() in the parent and chdir() into its own output
+		// directory so it does not write through the parent's file descriptors.
+		static void reopen_all();
+
+		private:
+		int fd;
+		string filename;
+		vector<TraceRecord> buffer;
+		uint64_t buffer_count;
+
+		static list<TraceWriter *> open_writers;
+		static bool exit_flush_registered;
+	};
+
+	class TraceReader
+	{
+		public:
+		TraceReader();
+		~TraceReader();
+
+		void open(string filename);
+		bool next(TraceRecord &rec); // Returns false at the end of the trace.
+		bool is_binary();
+		void close();
+
+		private:
+		ifstream inFile;
+		string filename;
+		bool binary;
+		vector<TraceRecord> buffer;
+		uint64_t buffer_count;
+		uint64_t buffer_pos;
+
+		bool next_text(TraceRecord &rec);
+		bool next_binary(TraceRecord &rec);
+	};
+}
+
+#endif
@@ -0,0 +1,438 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+// HybridBench: simulation throughput benchmark for HybridSim.
+//
+// Runs a fixed set of synthetic workloads through HybridSystem and reports how fast the simulator itself
+// runs: simulated accesses per host second, host ns per access, peak RSS and heap allocations. Each
+// workload runs in a forked child so the peak RSS and allocation counts are per workload.
+//
+// Usage: bench/HybridBench [-n accesses] [-r runs] [-w workload] [-i ini_file] [-s startup_ini_file] [-o results.json]
+// Normally run with "make bench", which compares the results against bench/baseline.json.
+// Each workload is run several times (-r) and the fastest run is reported.
+//
+// The startup workload makes no accesses. It only times the construction of a HybridSystem with the much
+// larger cache in the startup ini file (4M pages in ini/bench_startup.ini), which is dominated by the
+// cache table setup.
+
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <atomic>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "../HybridSystem.h"
+
+using namespace HybridSim;
+using namespace std;
+
+// Cycles between accesses.
+const uint64_t ISSUE_GAP = 10;
+
+
+// -----------------------------------------------------------
+// Allocation counting (replaces the global operator new/delete for the whole process).
+
+static atomic<uint64_t> alloc_count(0);
+static atomic<uint64_t> alloc_bytes(0);
+
+void *operator new(size_t size)
+{
+	alloc_count.fetch_add(1, memory_order_relaxed);
+	alloc_bytes.fetch_add(size, memory_order_relaxed);
+	void *p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+
+// -----------------------------------------------------------
+// Workloads
+
+enum WorkloadType
+{
+	SEQUENTIAL, // 64 byte lines in order, starting just past the prefilled pages
+	STRIDED, // One line per page, stepping a page and a line at a time
+	RANDOM, // Uniformly random lines over the whole NVDIMM (reads)
+	SET_CONFLICT, // Every page maps to set 0 (like tools/trace_generators/set_0_abuse.py)
+	WRITE_HEAVY, // Random lines over twice the cache size, 90% writes
+	STARTUP, // No accesses, only setup with the startup ini file
+	NUM_WORKLOADS
+};
+
+static const char *workload_names[NUM_WORKLOADS] =
+{
+	"sequential",
+	"strided",
+	"random",
+	"set_conflict",
+	"write_heavy",
+	"startup"
+};
+
+class WorkloadGenerator
+{
+	public:
+	WorkloadGenerator(WorkloadType t)
+	{
+		type = t;
+		rng = 0x9E3779B97F4A7C15ULL;
+	}
+
+	// Returns the address of access i and sets isWrite.
+	uint64_t next(uint64_t i, bool &isWrite)
+	{
+		uint64_t total_lines = (TOTAL_PAGES * PAGE_SIZE) / BURST_SIZE;
+		uint64_t addr = 0;
+		isWrite = false;
+
+		switch (type)
+		{
+			case SEQUENTIAL:
+				addr = CACHE_PAGES * PAGE_SIZE + i * BURST_SIZE;
+				break;
+			case STRIDED:
+				addr = i * (PAGE_SIZE + BURST_SIZE);
+				break;
+			case RANDOM:
+				addr = (random() % total_lines) * BURST_SIZE;
+				break;
+			case SET_CONFLICT:
+				addr = FLASH_ADDRESS(i % (TOTAL_PAGES / NUM_SETS), 0);
+				isWrite = true;
+				break;
+			case WRITE_HEAVY:
+				addr = (random() % (2 * CACHE_PAGES * PAGE_SIZE / BURST_SIZE)) * BURST_SIZE;
+				isWrite = (random() % 10) != 0;
+				break;
+			default:
+				assert(0);
+		}
+
+		return addr % (TOTAL_PAGES * PAGE_SIZE);
+	}
+
+	private:
+	// xorshift64*, so every run sees the same sequence.
+	uint64_t random()
+	{
+		rng ^= rng >> 12;
+		rng ^= rng << 25;
+		rng ^= rng >> 27;
+		return rng * 2685821657736338717ULL;
+	}
+
+	WorkloadType type;
+	uint64_t rng;
+};
+
+
+// -----------------------------------------------------------
+// Benchmark driver
+
+// Plain struct so it can be sent from the child back to the parent through a pipe.
+struct BenchResult
+{
+	uint64_t accesses;
+	uint64_t sim_cycles;
+	double setup_ms;
+	double run_ms;
+	uint64_t peak_rss_kb;
+	uint64_t setup_allocations;
+	uint64_t run_allocations;
+	uint64_t run_allocated_bytes;
+};
+
+static double now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+class HybridBench
+{
+	public:
+	HybridBench() : pending(0) {}
+
+	void read_complete(uint id, uint64_t address, uint64_t clock_cycle) { pending--; }
+	void write_complete(uint id, uint64_t address, uint64_t clock_cycle) { pending--; }
+
+	BenchResult run(WorkloadType type, uint64_t num_accesses, string ini)
+	{
+		BenchResult r;
+		memset(&r, 0, sizeof(r));
+
+		// Setup (ini parsing, backend construction and cache prefill).
+		uint64_t start_allocs = alloc_count.load();
+		double start = now_ms();
+
+		HybridSystem *mem = new HybridSystem(1, ini);
+		typedef CallbackBase<void,uint,uint64_t,uint64_t> Callback_t;
+		Callback_t *read_cb = new Callback<HybridBench, void, uint, uint64_t, uint64_t>(this, &HybridBench::read_complete);
+		Callback_t *write_cb = new Callback<HybridBench, void, uint, uint64_t, uint64_t>(this, &HybridBench::write_complete);
+		mem->RegisterCallbacks(read_cb, write_cb);
+
+		r.setup_ms = now_ms() - start;
+		r.setup_allocations = alloc_count.load() - start_allocs;
+
+		// Main loop (same as TraceBasedSim).
+		WorkloadGenerator gen(type);
+		start_allocs = alloc_count.load();
+		uint64_t start_bytes = alloc_bytes.load();
+		start = now_ms();
+
+		for (uint64_t i = 0; i < num_accesses; i++)
+		{
+			bool isWrite;
+			uint64_t addr = gen.next(i, isWrite);
+
+			for (uint64_t j = 0; j < ISSUE_GAP; j++)
+				mem->update();
+
+			while (!mem->addTransaction(isWrite, addr))
+				mem->update();
+			pending++;
+
+			// Same throttling as TraceBasedSim (INPUT_QUEUE_DEPTH in the ini file).
+			while (!mem->WillAcceptTransaction())
+				mem->update();
+		}
+
+		while (pending > 0)
+			mem->update();
+
+		r.run_ms = now_ms() - start;
+		r.run_allocations = alloc_count.load() - start_allocs;
+		r.run_allocated_bytes = alloc_bytes.load() - start_bytes;
+		r.accesses = num_accesses;
+		r.sim_cycles = mem->currentClockCycle;
+
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		r.peak_rss_kb = usage.ru_maxrss;
+
+		return r;
+	}
+
+	private:
+	uint64_t pending;
+};
+
+// Run one workload in a child process and return its result.
+static bool run_workload(WorkloadType type, uint64_t num_accesses, string ini, BenchResult &result)
+{
+	int fds[2];
+	if (pipe(fds) != 0)
+	{
+		cerr << "ERROR: HybridBench failed to create pipe\n";
+		abort();
+	}
+
+	// Do not let the child inherit (and print again) anything still buffered.
+	fflush(stdout);
+	cout.flush();
+
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		cerr << "ERROR: HybridBench failed to fork\n";
+		abort();
+	}
+
+	if (pid == 0)
+	{
+		close(fds[0]);
+
+		// Keep HybridSim's output out of the benchmark report.
+		if ((freopen("/dev/null", "w", stdout) == NULL) || (freopen("/dev/null", "w", stderr) == NULL))
+			cerr << "WARNING: HybridBench could not redirect HybridSim output\n";
+
+		HybridBench bench;
+		BenchResult r = bench.run(type, num_accesses, ini);
+		ssize_t n = write(fds[1], &r, sizeof(r));
+		close(fds[1]);
+		_exit(n == sizeof(r) ? 0 : 1);
+	}
+
+	close(fds[1]);
+	ssize_t n = read(fds[0], &result, sizeof(result));
+	close(fds[0]);
+
+	int status;
+	waitpid(pid, &status, 0);
+
+	return (n == sizeof(result)) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+}
+
+static void print_usage()
+{
+	cerr << "Usage: HybridBench [-n accesses] [-r runs] [-w workload] [-i ini_file] [-s startup_ini_file] [-o results.json]\n";
+	cerr << "Workloads:";
+	for (int i = 0; i < NUM_WORKLOADS; i++)
+		cerr << " " << workload_names[i];
+	cerr << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t num_accesses = 100000;
+	uint64_t runs = 3;
+	string ini = "./ini/bench.ini";
+	string startup_ini = "./ini/bench_startup.ini";
+	string outfile = "bench/results.json";
+	string only = "";
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:r:w:i:s:o:h")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n':
+				convert_uint64_t(num_accesses, optarg, "-n");
+				break;
+			case 'r':
+				convert_uint64_t(runs, optarg, "-r");
+				break;
+			case 'w':
+				only = optarg;
+				break;
+			case 'i':
+				ini = optarg;
+				break;
+			case 's':
+				startup_ini = optarg;
+				break;
+			case 'o':
+				outfile = optarg;
+				break;
+			default:
+				print_usage();
+				return 1;
+		}
+	}
+
+	ofstream out;
+	out.open(outfile.c_str(), ios_base::out | ios_base::trunc);
+	if (!out.is_open())
+	{
+		cerr << "ERROR: HybridBench unable to open " << outfile << "\n";
+		abort();
+	}
+
+	printf("%-14s %10s %12s %12s %12s %10s %12s %12s\n", "workload", "accesses", "setup_ms", "acc/s", "ns/access",
+			"rss_kb", "allocs", "allocs/acc");
+
+	out << "{\n";
+	out << "\t\"accesses_per_workload\": " << num_accesses << ",\n";
+	out << "\t\"runs\": " << runs << ",\n";
+	out << "\t\"ini\": \"" << ini << "\",\n";
+	out << "\t\"workloads\": {\n";
+
+	bool first = true;
+	bool failed = false;
+	for (int i = 0; i < NUM_WORKLOADS; i++)
+	{
+		if ((only != "") && (only != workload_names[i]))
+			continue;
+
+		bool startup = (i == STARTUP);
+
+		// Keep the fastest run. Everything except the times is deterministic.
+		BenchResult r;
+		memset(&r, 0, sizeof(r));
+		bool ok = true;
+		for (uint64_t run = 0; (run < runs) && ok; run++)
+		{
+			BenchResult cur;
+			ok = run_workload((WorkloadType)i, startup ? 0 : num_accesses, startup ? startup_ini : ini, cur);
+			if (run == 0)
+				r = cur;
+			r.setup_ms = min(r.setup_ms, cur.setup_ms);
+			r.run_ms = min(r.run_ms, cur.run_ms);
+		}
+
+		if (!ok)
+		{
+			cerr << "ERROR: HybridBench workload " << workload_names[i] << " failed\n";
+			failed = true;
+			continue;
+		}
+
+		double ns_per_access = r.accesses ? (r.run_ms * 1000000.0) / r.accesses : 0.0;
+		double accesses_per_second = r.accesses ? r.accesses / (r.run_ms / 1000.0) : 0.0;
+		double allocs_per_access = r.accesses ? (double)r.run_allocations / r.accesses : 0.0;
+
+		printf("%-14s %10lu %12.1f %12.0f %12.1f %10lu %12lu %12.2f\n", workload_names[i], r.accesses, r.setup_ms,
+				accesses_per_second, ns_per_access, r.peak_rss_kb, r.run_allocations, allocs_per_access);
+
+		out << (first ? "" : ",\n");
+		out << "\t\t\"" << workload_names[i] << "\": {\n";
+		out << "\t\t\t\"accesses\": " << r.accesses << ",\n";
+		out << "\t\t\t\"sim_cycles\": " << r.sim_cycles << ",\n";
+		out << "\t\t\t\"setup_ms\": " << r.setup_ms << ",\n";
+		out << "\t\t\t\"run_ms\": " << r.run_ms << ",\n";
+		out << "\t\t\t\"accesses_per_second\": " << accesses_per_second << ",\n";
+		out << "\t\t\t\"ns_per_access\": " << ns_per_access << ",\n";
+		out << "\t\t\t\"peak_rss_kb\": " << r.peak_rss_kb << ",\n";
+		out << "\t\t\t\"setup_allocations\": " << r.setup_allocations << ",\n";
+		out << "\t\t\t\"allocations\": " << r.run_allocations << ",\n";
+		out << "\t\t\t\"allocated_bytes\": " << r.run_allocated_bytes << ",\n";
+		out << "\t\t\t\"allocations_per_access\": " << allocs_per_access << "\n";
+		out << "\t\t}";
+		first = false;
+	}
+
+	out << "\n\t}\n";
+	out << "}\n";
+	out.close();
+
+	cout << "Results written to " << outfile << "\n";
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,48 @@
+# Compares HybridBench results against a stored baseline.
+#
+# Usage: python compare.py <baseline.json> <results.json> [tolerance_percent]
+#
+# Exits with status 1 if any workload got slower (ns_per_access, setup_ms), allocated more per access or
+# used more peak memory than the baseline by more than the tolerance (default 10%).
+
+import json
+import sys
+
+# (metric, higher is worse, smallest absolute change that counts)
+# The absolute limits keep timer and page granularity noise on small values from being reported.
+METRICS = [('ns_per_access', True, 0.0), ('allocations_per_access', True, 0.0), ('peak_rss_kb', True, 1024.0),
+		('setup_ms', True, 10.0)]
+
+if len(sys.argv) < 3:
+	print('Usage: python compare.py <baseline.json> <results.json> [tolerance_percent]')
+	sys.exit(1)
+
+baseline = json.load(open(sys.argv[1]))['workloads']
+results = json.load(open(sys.argv[2]))['workloads']
+tolerance = float(sys.argv[3]) if len(sys.argv) > 3 else 10.0
+
+regressions = 0
+print('%-14s %-24s %14s %14s %9s' % ('workload', 'metric', 'baseline', 'current', 'change'))
+for name in sorted(results):
+	if name not in baseline:
+		print('%-14s (not in baseline)' % name)
+		continue
+	for (metric, higher_is_worse, min_delta) in METRICS:
+		old = float(baseline[name][metric])
+		new = float(results[name][metric])
+		if old == 0:
+			change = 0.0 if new == 0 else 100.0
+		else:
+			change = (new - old) * 100.0 / old
+		flag = ''
+		if abs(new - old) <= min_delta:
+			pass
+		elif (higher_is_worse and change > tolerance) or (not higher_is_worse and change < -tolerance):
+			flag = '  REGRESSION'
+			regressions += 1
+		print('%-14s %-24s %14.2f %14.2f %+8.1f%%%s' % (name, metric, old, new, change, flag))
+
+if regressions > 0:
+	print('%d regression(s) over %.1f%%' % (regressions, tolerance))
+	sys.exit(1)
+print('No regressions over %.1f%%' % tolerance)
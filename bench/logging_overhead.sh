@@ -0,0 +1,74 @@
+#!/bin/bash
+# Measures the host time overhead of HybridSim's logging.
+#
+# Builds the trace-based simulator twice (the normal stats build and "make FAST=1", which compiles
+# all logging out), runs the same synthetic trace through both and reports the wall clock times.
+#
+# Usage: bench/logging_overhead.sh [num_accesses] [runs]
+# Run from the HybridSim directory. Both variants are built in copies of the sources under a
+# temporary directory, so the build in the working tree is left alone.
+
+NUM_ACCESSES=${1:-200000}
+RUNS=${2:-3}
+
+HYBRIDSIM_DIR=`pwd`
+WORK_DIR=`mktemp -d`
+
+# HybridSystem loads ../HybridSim/ini/hybridsim.ini, so run from a directory next to a HybridSim link.
+ln -s "$HYBRIDSIM_DIR" "$WORK_DIR/HybridSim"
+mkdir "$WORK_DIR/run"
+
+# Generate a mixed trace: sequential streams interleaved with random accesses (25% writes).
+python3 - "$NUM_ACCESSES" > "$WORK_DIR/trace.txt" <<'PYEOF'
+import random
+import sys
+random.seed(1)
+n = int(sys.argv[1])
+seq = 512*1024*1024
+for i in range(n):
+	if i % 2 == 0:
+		addr = seq
+		seq += 64
+	else:
+		addr = random.randrange(0, 8*1024*1024*1024, 64)
+	op = 1 if random.random() < 0.25 else 0
+	sys.stdout.write('%d %d %d\n' % (i*10, op, addr))
+PYEOF
+
+build()
+{
+	src="$WORK_DIR/src_$2"
+	mkdir "$src"
+	cp "$HYBRIDSIM_DIR"/Makefile "$HYBRIDSIM_DIR"/*.cpp "$HYBRIDSIM_DIR"/*.h "$src"
+	# The Makefile finds DRAMSim2 and NVDIMMSim next to the directory it is run in.
+	(cd "$src" && make $1 DRAM_LIB="$HYBRIDSIM_DIR/../DRAMSim2" NV_LIB="$HYBRIDSIM_DIR/../NVDIMMSim/src" \
+		> "$WORK_DIR/build.log" 2>&1) || { cat "$WORK_DIR/build.log"; rm -rf "$WORK_DIR"; exit 1; }
+	cp "$src/HybridSim" "$WORK_DIR/$2"
+}
+
+build "" HybridSim.stats
+build "FAST=1" HybridSim.fast
+
+run()
+{
+	cd "$WORK_DIR/run"
+	best=0
+	for i in `seq $RUNS`; do
+		start=`date +%s.%N`
+		"$WORK_DIR/$1" "$WORK_DIR/trace.txt" > /dev/null 2>&1
+		end=`date +%s.%N`
+		best=`awk -v s=$start -v e=$end -v b=$best 'BEGIN { t = e - s; if (b == 0 || t < b) b = t; print b }'`
+	done
+	cd "$HYBRIDSIM_DIR"
+	echo $best
+}
+
+stats_time=`run HybridSim.stats`
+fast_time=`run HybridSim.fast`
+
+echo "accesses: $NUM_ACCESSES (best of $RUNS runs)"
+echo "stats build: $stats_time s"
+echo "fast build: $fast_time s"
+echo "logging overhead: `awk -v s=$stats_time -v f=$fast_time 'BEGIN { printf "%.1f", (s - f) * 100 / f }'` %"
+
+rm -rf "$WORK_DIR"
@@ -33,18 +33,31 @@
 
 // Temporary prefetch flags.
 #define ENABLE_PERFECT_PREFETCHING 0
-#define PREFETCH_FILE "traces/prefetch_data.txt"
+#define PREFETCH_FILE "traces/prefetch_data.bin"
 
 #define SEQUENTIAL_PREFETCHING_WINDOW 0
 
 // Stream Buffer Setup.
 #define ENABLE_STREAM_BUFFER 1
-#define ONE_MISS_TABLE_SIZE 10
-#define NUM_STREAM_BUFFERS 10
-#define STREAM_BUFFER_LENGTH 4
 #define DEBUG_STREAM_BUFFER 0
 #define DEBUG_STREAM_BUFFER_HIT 0 // This generates a lot of stuff.
 
+// Stride prefetcher (see StridePrefetcher.h).
+#define ENABLE_STRIDE_PREFETCHER 0
+
+// Feedback directed throttling of the sequential, stream buffer and stride prefetchers (see PrefetchThrottle.h).
+#define ENABLE_PREFETCH_THROTTLE 0
+
+
+// Compile-time instrumentation switch.
+// Building with "make FAST=1" defines HYBRIDSIM_FAST, which compiles out all Logger calls and
+// debug output regardless of the ini file. This is meant for long warmup runs that do not need stats.
+#ifdef HYBRIDSIM_FAST
+#define COMPILE_STATS 0
+#else
+#define COMPILE_STATS 1
+#endif
+
 
 // Debug flags.
 
@@ -57,11 +70,30 @@
 // Outputs the victim selection process during each eviction. Goes to debug_victim.log.
 #define DEBUG_VICTIM 0		
 
-// Outputs the full trace of accesses sent to NVDIMM. Goes to nvdimm_trace.log.
+// Outputs the full trace of accesses sent to NVDIMM. Goes to nvdimm_trace.bin (binary trace format).
 #define DEBUG_NVDIMM_TRACE 0
 
-// Outputs the full trace of accesses received by HybridSim. Goes to full_trace.log.
+// Outputs the full trace of accesses received by HybridSim. Goes to full_trace.bin (binary trace format).
+// The binary trace can be replayed directly with TraceBasedSim.
+#define DEBUG_FULL_TRACE 0
+
+// A fast build never produces debug output.
+#if !COMPILE_STATS
+#undef DEBUG_CACHE
+#define DEBUG_CACHE 0
+#undef DEBUG_LOGGER
+#define DEBUG_LOGGER 0
+#undef DEBUG_VICTIM
+#define DEBUG_VICTIM 0
+#undef DEBUG_NVDIMM_TRACE
+#define DEBUG_NVDIMM_TRACE 0
+#undef DEBUG_FULL_TRACE
 #define DEBUG_FULL_TRACE 0
+#undef DEBUG_STREAM_BUFFER
+#define DEBUG_STREAM_BUFFER 0
+#undef DEBUG_STREAM_BUFFER_HIT
+#define DEBUG_STREAM_BUFFER_HIT 0
+#endif
 
 
 // Map the first CACHE_PAGES of the NVDIMM address space.
@@ -132,6 +164,8 @@ const uint64_t FOURGB = 4294967296; // 1024^3 * 4
 #include <utility>
 #include <assert.h>
 
+#ifndef HYBRIDSIM_STANDALONE
+
 // Include external interface for DRAMSim.
 #include <DRAMSim.h>
 
@@ -146,6 +180,29 @@ using DRAMSim::SimulatorObject;
 // Include external interface for NVDIMM.
 #include <NVDIMMSim.h>
 
+#else
+
+// Standalone build (HYBRIDSIM_STANDALONE is set by the Makefile when ../DRAMSim2 or ../NVDIMMSim is missing).
+// Only the built-in memory backends are available (see MemoryBackend.h), so provide SimulatorObject here.
+#include <sys/types.h>
+
+namespace HybridSim
+{
+	class SimulatorObject
+	{
+		public:
+		uint64_t currentClockCycle;
+
+		SimulatorObject() : currentClockCycle(0) {}
+		virtual ~SimulatorObject() {}
+
+		void step() { currentClockCycle++; }
+		virtual void update()=0;
+	};
+}
+
+#endif
+
 
 // Include the Transaction type (which is needed below).
 #include "Transaction.h"
@@ -170,6 +227,15 @@ extern uint64_t EPOCH_LENGTH;
 extern uint64_t HISTOGRAM_BIN;
 extern uint64_t HISTOGRAM_MAX;
 
+// Stats output formats (any combination may be enabled).
+extern uint64_t ENABLE_TEXT_STATS; // hybridsim.log and hybridsim_epoch.log
+extern uint64_t ENABLE_JSON_STATS; // hybridsim_stats.json (written at the end of the run)
+extern uint64_t ENABLE_CSV_STATS; // hybridsim_epoch.csv (one row per epoch)
+
+// Host time profiling of HybridSim's own phases (hybridsim_profile.log).
+extern uint64_t ENABLE_PROFILER;
+extern uint64_t PROFILER_SAMPLE_PERIOD; // time one cycle in every PROFILER_SAMPLE_PERIOD cycles
+
 extern uint64_t PAGE_SIZE; // in bytes, so divide this by 64 to get the number of DDR3 transfers per page
 extern uint64_t SET_SIZE; // associativity of cache
 extern uint64_t BURST_SIZE; // number of bytes in a single transaction, this means with PAGE_SIZE=1024, 16 transactions are needed
@@ -179,6 +245,51 @@ extern uint64_t FLASH_BURST_SIZE; // number of bytes in a single flash transacti
 extern uint64_t TOTAL_PAGES; // 2 GB
 extern uint64_t CACHE_PAGES; // 1 GB
 
+// Replacement policy
+extern string REPLACEMENT_POLICY; // LRU or OPT (Belady, needs the trace ahead of time)
+extern string ORACLE_TRACE_FILE; // trace used by OPT (none = the trace-based simulator's own trace)
+
+// Stream buffer prefetcher (ENABLE_STREAM_BUFFER)
+extern uint64_t ONE_MISS_TABLE_SIZE; // recent misses remembered for detecting streams
+extern uint64_t NUM_STREAM_BUFFERS; // streams followed at once
+extern uint64_t STREAM_BUFFER_LENGTH; // pages prefetched ahead of each stream
+
+// Stride prefetcher (ENABLE_STRIDE_PREFETCHER)
+extern uint64_t STRIDE_NUM_STREAMS; // streams followed at once
+extern uint64_t STRIDE_MAX_DISTANCE; // in pages, farther accesses start a new stream
+extern uint64_t STRIDE_CONFIDENCE_THRESHOLD; // confirmations needed before prefetching
+extern uint64_t STRIDE_MIN_DEPTH; // strides prefetched ahead of a new stream
+extern uint64_t STRIDE_MAX_DEPTH; // strides prefetched ahead of a confident stream
+
+// Prefetch throttling (ENABLE_PREFETCH_THROTTLE)
+extern uint64_t PREFETCH_THROTTLE_EPOCH; // in cycles
+extern double PREFETCH_ACCURACY_HIGH;
+extern double PREFETCH_ACCURACY_LOW;
+extern double PREFETCH_LATENESS_THRESHOLD;
+extern double PREFETCH_POLLUTION_THRESHOLD;
+extern uint64_t PREFETCH_POLLUTION_FILTER_SIZE; // in bits
+
+// Sectored caching
+extern uint64_t SECTOR_SIZE; // in bytes (0 = move whole pages)
+extern string SECTOR_FILL; // DEMAND or BACKGROUND
+
+// Write-back buffer for dirty victims
+extern uint64_t WRITEBACK_BUFFER_SIZE; // in pages (0 = write victims to the NVM immediately)
+extern uint64_t WRITEBACK_BUFFER_HIGH_WATERMARK; // in pages, drain even if the NVM is busy at this occupancy
+extern uint64_t BUFFER_READ_DELAY; // cycles to read a page's lines out of a controller buffer
+
+// Eager cleaning
+extern double EAGER_CLEAN_THRESHOLD; // fraction of the cache that may be dirty before idle NVM time is used to clean (1 = never)
+
+// DRAM critical line first
+extern uint64_t DRAM_CRITICAL_LINE_FIRST; // move the missed line first and serve hits to a filling page from the fill buffer
+
+// Miss merging
+extern uint64_t MSHR_TARGETS; // accesses that can wait on one page being filled (0 = no merging)
+
+// Admission control
+extern uint64_t INPUT_QUEUE_DEPTH; // accesses accepted by addTransaction that have not completed yet (0 = unlimited)
+
 
 // Defined in marss memoryHierachy.cpp.
 // Need to confirm this and make it more flexible later.
@@ -189,6 +300,29 @@ extern string dram_ini;
 extern string flash_ini;
 extern string sys_ini;
 
+// Memory backends (see MemoryBackend.h)
+extern string DRAM_BACKEND; // dramsim2 or simple
+extern string FLASH_BACKEND; // nvdimmsim or simple
+
+// Order in which queued transactions are sent to the backends (see BackendQueue.h)
+extern string BACKEND_QUEUE_POLICY; // FIFO or PRIORITY
+extern uint64_t QUEUE_STARVATION_LIMIT; // in cycles, PRIORITY only
+
+// Simple backend parameters (all times are in HybridSim cycles)
+extern uint64_t DRAM_SIMPLE_READ_LATENCY; // cycles from issue to the data being returned
+extern uint64_t DRAM_SIMPLE_WRITE_LATENCY;
+extern uint64_t DRAM_SIMPLE_QUEUE_DEPTH; // maximum outstanding transactions (addTransaction returns false beyond this)
+extern uint64_t DRAM_SIMPLE_BUS_CYCLES; // data bus occupancy per transaction (0 = unlimited bandwidth)
+extern uint64_t DRAM_SIMPLE_NUM_BANKS; // 0 or 1 = no bank model
+extern uint64_t DRAM_SIMPLE_BANK_CYCLES; // minimum cycles between accesses to the same bank
+extern uint64_t FLASH_SIMPLE_READ_LATENCY;
+extern uint64_t FLASH_SIMPLE_WRITE_LATENCY;
+extern uint64_t FLASH_SIMPLE_QUEUE_DEPTH;
+extern uint64_t FLASH_SIMPLE_BUS_CYCLES;
+extern uint64_t FLASH_SIMPLE_NUM_BANKS;
+extern uint64_t FLASH_SIMPLE_BANK_CYCLES;
+extern uint64_t FLASH_SIMPLE_CRIT_LINE_FIRST; // return reads to the host as soon as the first line arrives
+
 // Save/Restore options
 extern uint64_t ENABLE_RESTORE;
 extern uint64_t ENABLE_SAVE;
@@ -201,6 +335,29 @@ extern string NVDIMM_SAVE_FILE;
 
 
 
+// Instrumentation policies.
+// All Logger calls are guarded by Instrumentation::logging(). In a stats build this checks ENABLE_LOGGER
+// from the ini file. In a fast build it is a constant false, so the compiler removes the Logger calls
+// and the code computing their arguments entirely. Profiler phases are handled the same way with
+// Instrumentation::profiling() and ENABLE_PROFILER.
+template <bool Compiled>
+struct InstrumentationPolicy
+{
+	static inline bool logging() { return Compiled && (ENABLE_LOGGER != 0); }
+	static inline bool profiling() { return Compiled && (ENABLE_PROFILER != 0); }
+};
+
+typedef InstrumentationPolicy<true> StatsBuild;
+typedef InstrumentationPolicy<false> FastBuild;
+
+#if COMPILE_STATS
+typedef StatsBuild Instrumentation;
+#else
+typedef FastBuild Instrumentation;
+#endif
+
+
+
 // Macros derived from Ini settings.
 
 #define NUM_SETS (CACHE_PAGES / SET_SIZE)
@@ -212,6 +369,13 @@ extern string NVDIMM_SAVE_FILE;
 #define FLASH_ADDRESS(tag, set) ((tag * NUM_SETS + set) * PAGE_SIZE)
 #define ALIGN(addr) (((addr / BURST_SIZE) * BURST_SIZE) % (TOTAL_PAGES * PAGE_SIZE))
 
+// Sector macros (an unsectored page is a single sector).
+#define SECTOR_BYTES ((SECTOR_SIZE == 0) ? PAGE_SIZE : SECTOR_SIZE)
+#define SECTORS_PER_PAGE (PAGE_SIZE / SECTOR_BYTES)
+#define SECTOR_BIT(addr) ((uint32_t)1 << (PAGE_OFFSET(addr) / SECTOR_BYTES))
+#define ALL_SECTORS ((uint32_t)((1ULL << SECTORS_PER_PAGE) - 1))
+#define MAX_SECTORS_PER_PAGE 32
+
 // TLB derived parameters
 #define BYTES_PER_READ 64
 #define TLB_MAX_ENTRIES (TLB_SIZE / BYTES_PER_READ)
@@ -226,19 +390,23 @@ class cache_line
         bool valid;
         bool dirty;
 		bool locked;
+		bool prefetched; // Set to 1 if a cache_line is brought into DRAM as a prefetch.
+		bool used; // Like dirty, but also set to 1 for reads. Used for tracking prefetch hits vs. misses.
 		uint64_t lock_count;
         uint64_t tag;
-        uint64_t data;
+		uint32_t sector_valid; // One bit per sector (see SECTOR_SIZE). Unsectored pages only use bit 0.
+		uint32_t sector_dirty; // Sectors written since the page was filled. dirty is set iff this is non-zero.
         uint64_t ts;
-		bool prefetched; // Set to 1 if a cache_line is brought into DRAM as a prefetch.
-		bool used; // Like dirty, but also set to 1 for reads. Used for tracking prefetch hits vs. misses.
 
-        cache_line() : valid(false), dirty(false), locked(false), lock_count(0), tag(0), data(0), ts(0), prefetched(0), used(0) {}
+		// The flags are grouped together to keep the cache table entries at 40 bytes.
+        cache_line() : valid(false), dirty(false), locked(false), prefetched(0), used(0), lock_count(0), tag(0), sector_valid(0), 
+			sector_dirty(0), ts(0) {}
         string str() 
 		{ 
 			stringstream out; 
-			out << "tag=" << tag << " data=" << data << " valid=" << valid << " dirty=" << dirty << " locked=" << locked 
-				<< " lock_count=" << lock_count << " ts=" << ts << " prefetched=" << prefetched << " used=" << used;
+			out << "tag=" << tag << " valid=" << valid << " dirty=" << dirty << " locked=" << locked 
+				<< " lock_count=" << lock_count << " ts=" << ts << " prefetched=" << prefetched << " used=" << used
+				<< " sector_valid=" << hex << sector_valid << " sector_dirty=" << sector_dirty << dec;
 			return out.str(); 
 		}
 };
@@ -249,7 +417,8 @@ enum PendingOperation
 	VICTIM_WRITE, // Write victim line to Flash
 	LINE_READ, // Read new line from Flash
 	CACHE_READ, // Perform a DRAM read and return the final result.
-	CACHE_WRITE // Perform a DRAM read and return the final result.
+	CACHE_WRITE, // Perform a DRAM read and return the final result.
+	SECTOR_READ // Read missing sectors of a cached page from Flash
 };
 
 // Entries in the pending table.
@@ -264,8 +433,10 @@ class Pending
 	bool victim_valid;
 	bool callback_sent;
 	TransactionType type; // DATA_READ or DATA_WRITE
+	uint32_t sectors; // Sectors moved by LINE_READ and SECTOR_READ
+	uint32_t victim_sectors; // Sectors of the victim to write back
 
-	Pending() : op(VICTIM_READ), flash_addr(0), cache_addr(0), victim_tag(0), type(DATA_READ) {};
+	Pending() : op(VICTIM_READ), flash_addr(0), cache_addr(0), victim_tag(0), type(DATA_READ), sectors(0), victim_sectors(0) {};
         string str() { stringstream out; out << "O=" << op << " F=" << flash_addr << " C=" << cache_addr << " V=" << victim_tag 
 		<< " T=" << type; return out.str(); }
 };
@@ -1,8 +1,11 @@
 import ctypes
 from ctypes import byref
 from ctypes import c_ulonglong
+from ctypes import c_bool
 
 lib = ctypes.cdll.LoadLibrary('./libhybridsim.so')
+lib.HybridSim_C_addTransaction.restype = c_bool
+lib.HybridSim_C_WillAcceptTransaction.restype = c_bool
 
 class HybridSim(object):
 	def __init__(self, sys_id, ini):
@@ -124,7 +124,11 @@ class TraceThread(object):
 		self.trace_cycles += 1
 
 		if self.trace_cycles >= self.trans_cycle:
-			self.parent.addTransaction(self.thread_id, self.trans_write, self.trans_addr)
+			if not self.parent.addTransaction(self.thread_id, self.trans_write, self.trans_addr):
+				# HybridSim's input queue is full (INPUT_QUEUE_DEPTH), so stall and try again next cycle.
+				self.trace_cycles -= 1
+				self.throttle_cycles += 1
+				return
 			self.pending += 1
 			self.get_next_trans()
 
@@ -263,7 +267,8 @@ class MultiThreadedTBS(object):
 
 
 	def addTransaction(self, thread_id, isWrite, addr):
-		self.mem.addTransaction(isWrite, addr)
+		if not self.mem.addTransaction(isWrite, addr):
+			return False
 		self.pending += 1
 
 		trans_key = (addr, isWrite)
@@ -274,6 +279,7 @@ class MultiThreadedTBS(object):
 		self.scheduler_prefetcher.addTransaction(thread_id, isWrite, addr)
 
 		#print 'Added (%d,%d,%d)'%(thread_id, isWrite, addr)
+		return True
 		
 
 	def transaction_complete(self, isWrite, sysID, addr, cycle):
@@ -457,7 +463,10 @@ class HybridSimTBS(object):
 				mem.update()
 				self.trace_cycles += 1
 
-			mem.addTransaction(write, addr)
+			# HybridSim turns the access away while its input queue is full (INPUT_QUEUE_DEPTH).
+			while not mem.addTransaction(write, addr):
+				mem.update()
+				self.throttle_cycles += 1
 			self.pending += 1
 
 			if self.pending >= self.MAX_PENDING:
@@ -69,7 +69,10 @@ class HybridSimTBS(object):
 				mem.update()
 				self.trace_cycles += 1
 
-			mem.addTransaction(write, addr)
+			# HybridSim turns the access away while its input queue is full (INPUT_QUEUE_DEPTH).
+			while not mem.addTransaction(write, addr):
+				mem.update()
+				self.throttle_cycles += 1
 			self.pending += 1
 
 			if self.pending >= self.MAX_PENDING:
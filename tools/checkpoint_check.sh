@@ -0,0 +1,66 @@
+#!/bin/bash
+# Checks that full system checkpoints are exact.
+#
+# Runs a trace once uninterrupted while saving a full system checkpoint at the given trace cycle
+# (HybridSim -save), then restores that checkpoint in a second run (HybridSim -restore). The restored
+# run must finish on the same cycle with the same output and the same hybridsim.log as the
+# uninterrupted one. Both runs use the simple memory backends, since only they support checkpoints.
+#
+# Usage: tools/checkpoint_check.sh <trace-file> <cycle>
+# Run from the HybridSim directory after "make".
+
+if [ $# -ne 2 ]; then
+	echo "Usage: tools/checkpoint_check.sh <trace-file> <cycle>"
+	exit 1
+fi
+
+TRACE=`readlink -f "$1"`
+CYCLE=$2
+
+HYBRIDSIM_DIR=`pwd`
+WORK_DIR=`mktemp -d`
+
+# HybridSystem loads ../HybridSim/ini/hybridsim.ini, so set up a copy of the ini files next to the run directory.
+mkdir "$WORK_DIR/HybridSim" "$WORK_DIR/run"
+cp -r "$HYBRIDSIM_DIR/ini" "$WORK_DIR/HybridSim/ini"
+sed -i 's/^DRAM_BACKEND=.*/DRAM_BACKEND=simple/; s/^FLASH_BACKEND=.*/FLASH_BACKEND=simple/' "$WORK_DIR/HybridSim/ini/hybridsim.ini"
+
+cd "$WORK_DIR/run"
+
+"$HYBRIDSIM_DIR/HybridSim" "$TRACE" -save $CYCLE "$WORK_DIR/state.bin" > "$WORK_DIR/full.out" 2>&1
+cp hybridsim.log "$WORK_DIR/full.log" 2> /dev/null
+"$HYBRIDSIM_DIR/HybridSim" "$TRACE" -restore "$WORK_DIR/state.bin" > "$WORK_DIR/restored.out" 2>&1
+cp hybridsim.log "$WORK_DIR/restored.log" 2> /dev/null
+
+cd "$HYBRIDSIM_DIR"
+
+if ! grep -q "Saved state" "$WORK_DIR/full.out"; then
+	echo "FAIL: no checkpoint was saved (is cycle $CYCLE inside the trace?)"
+	tail "$WORK_DIR/full.out"
+	rm -rf "$WORK_DIR"
+	exit 1
+fi
+
+# Compare everything printed after the checkpoint.
+sed -n '/^Saved state/,$p' "$WORK_DIR/full.out" | tail -n +2 > "$WORK_DIR/full.tail"
+sed -n '/^Restored state/,$p' "$WORK_DIR/restored.out" | tail -n +2 > "$WORK_DIR/restored.tail"
+
+status=0
+if ! cmp -s "$WORK_DIR/full.tail" "$WORK_DIR/restored.tail"; then
+	echo "FAIL: output differs after the checkpoint"
+	diff "$WORK_DIR/full.tail" "$WORK_DIR/restored.tail" | head -20
+	status=1
+fi
+# There is no hybridsim.log in FAST builds or with ENABLE_LOGGER=0.
+if [ -f "$WORK_DIR/full.log" -o -f "$WORK_DIR/restored.log" ] && ! cmp -s "$WORK_DIR/full.log" "$WORK_DIR/restored.log"; then
+	echo "FAIL: hybridsim.log differs"
+	diff "$WORK_DIR/full.log" "$WORK_DIR/restored.log" | head -20
+	status=1
+fi
+
+if [ $status -eq 0 ]; then
+	echo "PASS: `grep -E '^[0-9]+: completed' "$WORK_DIR/restored.out"` (checkpoint at trace cycle $CYCLE)"
+fi
+
+rm -rf "$WORK_DIR"
+exit $status
@@ -0,0 +1,106 @@
+# Converts HybridSim cache table checkpoints between the ASCII and binary formats (see Checkpoint.h).
+#
+# Usage:
+#   python checkpoint_convert.py <input> <output>
+#
+# The direction is picked from the input file: binary checkpoints are converted to ASCII and
+# ASCII checkpoints are converted to binary. The ASCII format only lists valid pages and does not
+# record the prefetched/used flags or the sector bitmaps, so those are lost when converting to ASCII.
+# Binary checkpoints of either version can be read. ASCII checkpoints are written as unsectored version 2
+# checkpoints, which restore as whole pages.
+
+import struct
+import sys
+
+MAGIC = b'HYBCKPT\0'
+VERSION = 2
+RECORD = struct.Struct('=QQIIII') # tag, ts, flags, sector valid, sector dirty, reserved
+HEADER = struct.Struct('=8sIIQQQQQQQ') # magic, version, record size, page size, set size, cache pages, total pages, records, checksum, sector size
+RECORD_V1 = struct.Struct('=QQII') # tag, ts, flags, reserved
+HEADER_V1 = struct.Struct('=8sIIQQQQQQ') # as HEADER, without the sector size
+
+VALID = 0x1
+DIRTY = 0x2
+
+FNV_OFFSET = 0xcbf29ce484222325
+FNV_PRIME = 0x100000001b3
+MASK = 0xffffffffffffffff
+
+def checksum(h, record):
+	for w in struct.unpack('=%dQ' % (len(record) // 8), record):
+		h = ((h ^ w) * FNV_PRIME) & MASK
+	return h
+
+def is_binary(filename):
+	f = open(filename, 'rb')
+	magic = f.read(8)
+	f.close()
+	return magic == MAGIC
+
+def binary_to_text(infile, outfile):
+	f = open(infile, 'rb')
+	out = open(outfile, 'w')
+	(magic, version, record_size, page_size, set_size, cache_pages, total_pages, num_records, check) = HEADER_V1.unpack(f.read(HEADER_V1.size))
+	if version == VERSION:
+		f.read(HEADER.size - HEADER_V1.size)
+		record = RECORD
+	elif version == 1:
+		record = RECORD_V1
+	else:
+		record = None
+	if record is None or record_size != record.size:
+		print('ERROR: Unsupported checkpoint version or record size.')
+		sys.exit(1)
+	out.write('%d %d %d %d\n' % (page_size, set_size, cache_pages, total_pages))
+	h = FNV_OFFSET
+	for i in range(num_records):
+		data = f.read(record.size)
+		if len(data) != record.size:
+			print('ERROR: Checkpoint file is truncated.')
+			sys.exit(1)
+		h = checksum(h, data)
+		(tag, ts, flags) = record.unpack(data)[0:3]
+		if flags & VALID:
+			out.write('%d 1 %d %d 0 %d\n' % (i * page_size, 1 if flags & DIRTY else 0, tag, ts))
+	if h != check:
+		print('ERROR: Checkpoint checksum mismatch.')
+		sys.exit(1)
+	f.close()
+	out.close()
+
+def text_to_binary(infile, outfile):
+	f = open(infile, 'r')
+	(page_size, set_size, cache_pages, total_pages) = [int(i) for i in f.readline().split()]
+	records = [RECORD.pack(0, 0, 0, 0, 0, 0)] * cache_pages
+	for line in f:
+		fields = line.split()
+		if len(fields) == 0:
+			continue
+		if len(fields) != 6:
+			print('ERROR: Parsing checkpoint failed on line: ' + line)
+			sys.exit(1)
+		(cache_addr, valid, dirty, tag, data, ts) = [int(i) for i in fields]
+		if cache_addr % page_size != 0 or cache_addr // page_size >= cache_pages:
+			print('ERROR: Invalid cache address on line: ' + line)
+			sys.exit(1)
+		flags = (VALID if valid else 0) | (DIRTY if dirty else 0)
+		# With a sector size of 0 the whole page is sector 0.
+		records[cache_addr // page_size] = RECORD.pack(tag, ts, flags, 1 if valid else 0, 1 if dirty else 0, 0)
+	f.close()
+
+	h = FNV_OFFSET
+	for r in records:
+		h = checksum(h, r)
+	out = open(outfile, 'wb')
+	out.write(HEADER.pack(MAGIC, VERSION, RECORD.size, page_size, set_size, cache_pages, total_pages, cache_pages, h, 0))
+	out.write(b''.join(records))
+	out.close()
+
+if len(sys.argv) != 3:
+	print('Usage: python checkpoint_convert.py <input> <output>')
+	sys.exit(1)
+
+if is_binary(sys.argv[1]):
+	binary_to_text(sys.argv[1], sys.argv[2])
+else:
+	text_to_binary(sys.argv[1], sys.argv[2])
@@ -0,0 +1,243 @@
+/*********************************************************************************
+* Copyright (c) 2010-2011, 
+* Jim Stevens, Paul Tschirhart, Ishwar Singh Bhati, Mu-Tien Chang, Peter Enns, 
+* Elliott Cooper-Balis, Paul Rosenfeld, Bruce Jacob
+* University of Maryland
+* Contact: jims [at] cs [dot] umd [dot] edu
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* * Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+*
+* * Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************************/
+
+// PrefetchGen: generates a perfect prefetching schedule from a trace.
+//
+// Usage: tools/perfect_prefetching/PrefetchGen [-i ini_file] [-p opt|lru] [-a adjustment] [-o schedule_file] [-s state_file] <trace-file>
+//
+// The trace is read once into an OracleTrace (split by cache set with the geometry in the ini file and the same
+// address math as HybridSystem, with the next use of every access indexed), then each set is replayed through
+// a model of the cache set, one thread per core. With -p opt (the default) the model evicts the page whose next
+// use is farthest away (Belady's OPT); with -p lru it evicts the least recently used page.
+//
+// Whenever a full set misses, the evicted page is known not to be needed between its last access and the miss,
+// so the schedule flushes it and prefetches the missed page right after that last access (plus the adjustment,
+// which keeps non-deterministic runs such as marss from evicting pages too early; use -a 0 for fully
+// deterministic runs). The entries of each set are sorted by that access number.
+//
+// The schedule is written in the binary format of PrefetchSchedule.h (load it with PREFETCH_FILE in config.h).
+// The initial contents of each set (the first SET_SIZE pages it sees) are written as a cache table checkpoint
+// to the state file, which should be restored with ENABLE_RESTORE so the run starts from the same state.
+//
+// Build with "make prefetch_gen".
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+
+#include "../../IniReader.h"
+#include "../../OracleTrace.h"
+#include "../../CacheTable.h"
+#include "../../Checkpoint.h"
+#include "../../PrefetchSchedule.h"
+
+using namespace HybridSim;
+using namespace std;
+
+struct SetResult
+{
+	vector<PrefetchEntry> schedule;
+	vector<uint64_t> init; // The initial pages in the set.
+};
+
+bool earlier(const PrefetchEntry &a, const PrefetchEntry &b)
+{
+	return a.access_number < b.access_number;
+}
+
+// Belady's OPT for one set. Resident pages map to (last access, next use). The heap holds (next use, tag) for
+// every access; entries that no longer match the resident page's next use are stale and skipped on eviction.
+void opt_set(OracleTrace &trace, uint64_t set, uint64_t adjustment, SetResult &result)
+{
+	unordered_map<uint32_t, pair<uint32_t, uint32_t> > resident;
+	priority_queue<pair<uint32_t, uint32_t> > farthest;
+
+	for (uint64_t i=0; i < trace.accesses(set); i++)
+	{
+		uint32_t tag = trace.tag(set, i);
+		uint32_t next = trace.next_use(set, i);
+
+		unordered_map<uint32_t, pair<uint32_t, uint32_t> >::iterator it = resident.find(tag);
+		if (it == resident.end())
+		{
+			if (resident.size() == SET_SIZE)
+			{
+				unordered_map<uint32_t, pair<uint32_t, uint32_t> >::iterator victim;
+				while (true)
+				{
+					pair<uint32_t, uint32_t> top = farthest.top();
+					farthest.pop();
+					victim = resident.find(top.second);
+					if ((victim != resident.end()) && (victim->second.second == top.first))
+						break;
+				}
+
+				PrefetchEntry e;
+				e.access_number = victim->second.first + adjustment;
+				e.flush_addr = FLASH_ADDRESS((uint64_t)victim->first, set);
+				e.new_addr = trace.page(set, i);
+				result.schedule.push_back(e);
+				resident.erase(victim);
+			}
+			else
+			{
+				// The set isn't full yet, so this page is part of the initial state.
+				result.init.push_back(trace.page(set, i));
+			}
+		}
+
+		resident[tag] = make_pair((uint32_t)i, next);
+		farthest.push(make_pair(next, tag));
+	}
+
+	// Victims are chosen by next use, so their last accesses are out of order.
+	stable_sort(result.schedule.begin(), result.schedule.end(), earlier);
+}
+
+// LRU for one set. The set is kept most recently used first, each page with its last access.
+void lru_set(OracleTrace &trace, uint64_t set, uint64_t adjustment, SetResult &result)
+{
+	vector<pair<uint64_t, uint64_t> > lru;
+
+	for (uint64_t i=0; i < trace.accesses(set); i++)
+	{
+		uint64_t page = trace.page(set, i);
+
+		// Check for a hit.
+		uint64_t way = 0;
+		while ((way < lru.size()) && (lru[way].first != page))
+			way++;
+
+		if (way < lru.size())
+		{
+			// We hit. Remove the old entry, it is reinserted at the front below.
+			lru.erase(lru.begin() + way);
+		}
+		else if (lru.size() == SET_SIZE)
+		{
+			// We missed in a full set. The LRU page is dead after its last access,
+			// so flush it and bring in the new page right after that.
+			PrefetchEntry e;
+			e.access_number = lru.back().second + adjustment;
+			e.flush_addr = lru.back().first;
+			e.new_addr = page;
+			result.schedule.push_back(e);
+			lru.pop_back();
+		}
+		else
+		{
+			// The set isn't full yet, so this page is part of the initial state.
+			result.init.push_back(page);
+		}
+
+		lru.insert(lru.begin(), make_pair(page, i));
+	}
+}
+
+void usage()
+{
+	cerr << "Usage: PrefetchGen [-i ini_file] [-p opt|lru] [-a adjustment] [-o schedule_file] [-s state_file] <trace-file>\n";
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	string ini = "ini/hybridsim.ini";
+	string tracefile = "";
+	string policy = "opt";
+	string schedule_file = "prefetch_data.bin";
+	string state_file = "prefetch_cache_state.bin";
+	uint64_t adjustment = 400;
+
+	for (int i=1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if ((arg == "-i") && (i+1 < argc))
+			ini = argv[++i];
+		else if ((arg == "-p") && (i+1 < argc))
+			policy = argv[++i];
+		else if ((arg == "-a") && (i+1 < argc))
+			adjustment = strtoull(argv[++i], NULL, 10);
+		else if ((arg == "-o") && (i+1 < argc))
+			schedule_file = argv[++i];
+		else if ((arg == "-s") && (i+1 < argc))
+			state_file = argv[++i];
+		else if ((arg[0] != '-') && (tracefile == ""))
+			tracefile = arg;
+		else
+			usage();
+	}
+	if ((tracefile == "") || ((policy != "opt") && (policy != "lru")))
+		usage();
+
+	IniReader iniReader;
+	iniReader.read(ini);
+
+	OracleTrace trace;
+	trace.load(tracefile);
+
+	vector<SetResult> results(NUM_SETS);
+	void (*model)(OracleTrace &, uint64_t, uint64_t, SetResult &) = (policy == "opt") ? opt_set : lru_set;
+	trace.for_each_set([&](uint64_t set) { model(trace, set, adjustment, results[set]); });
+
+	vector<vector<PrefetchEntry> > schedule(NUM_SETS);
+	uint64_t total = 0;
+	for (uint64_t i=0; i < NUM_SETS; i++)
+	{
+		schedule[i].swap(results[i].schedule);
+		total += schedule[i].size();
+	}
+	savePrefetchSchedule(schedule_file, schedule);
+
+	// Cache page i is way i / NUM_SETS of set i % NUM_SETS.
+	CacheTable state;
+	state.init(CACHE_PAGES, PAGE_SIZE);
+	for (uint64_t i=0; i < CACHE_PAGES; i++)
+	{
+		uint64_t set_index = i % NUM_SETS;
+		uint64_t way = i / NUM_SETS;
+		if (way < results[set_index].init.size())
+		{
+			cache_line &line = state.line(i);
+			line.valid = true;
+			line.dirty = true;
+			line.tag = TAG(results[set_index].init[way]);
+			line.ts = way;
+		}
+	}
+	saveCheckpoint(state_file, state);
+
+	cout << "Processed " << trace.total_accesses() << " accesses (" << policy << "), wrote " << total << " prefetches to "
+		<< schedule_file << " and the initial cache state to " << state_file << "\n";
+
+	return 0;
+}
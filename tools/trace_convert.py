@@ -0,0 +1,64 @@
+# Converts HybridSim traces between the ASCII and binary formats (see TraceFile.h).
+#
+# Usage:
+#   python trace_convert.py <input> <output>
+#
+# The direction is picked from the input file: binary traces are converted to ASCII and
+# ASCII traces are converted to binary.
+
+import struct
+import sys
+
+MAGIC = b'HYBTRACE'
+VERSION = 1
+RECORD = struct.Struct('=QQII') # cycle, address, op, reserved
+HEADER = struct.Struct('=8sII') # magic, version, record size
+
+def is_binary(filename):
+	f = open(filename, 'rb')
+	magic = f.read(8)
+	f.close()
+	return magic == MAGIC
+
+def binary_to_text(infile, outfile):
+	f = open(infile, 'rb')
+	out = open(outfile, 'w')
+	(magic, version, record_size) = HEADER.unpack(f.read(HEADER.size))
+	if version != VERSION or record_size != RECORD.size:
+		print('ERROR: Unsupported binary trace version or record size.')
+		sys.exit(1)
+	while True:
+		data = f.read(RECORD.size * 4096)
+		if not data:
+			break
+		for i in range(0, len(data) - RECORD.size + 1, RECORD.size):
+			(cycle, address, op, reserved) = RECORD.unpack_from(data, i)
+			out.write('%d %d %d\n' % (cycle, op, address))
+	f.close()
+	out.close()
+
+def text_to_binary(infile, outfile):
+	f = open(infile, 'r')
+	out = open(outfile, 'wb')
+	out.write(HEADER.pack(MAGIC, VERSION, RECORD.size))
+	for line in f:
+		line = line.split('#')[0].strip()
+		if line == '':
+			continue
+		fields = line.split()
+		if len(fields) != 3:
+			print('ERROR: Parsing trace failed on line: ' + line)
+			sys.exit(1)
+		(cycle, op, address) = [int(i) for i in fields]
+		out.write(RECORD.pack(cycle, address, op % 2, 0))
+	f.close()
+	out.close()
+
+if len(sys.argv) != 3:
+	print('Usage: python trace_convert.py <input> <output>')
+	sys.exit(1)
+
+if is_binary(sys.argv[1]):
+	binary_to_text(sys.argv[1], sys.argv[2])
+else:
+	text_to_binary(sys.argv[1], sys.argv[2])
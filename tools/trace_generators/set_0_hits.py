@@ -0,0 +1,58 @@
+import sys
+
+# Hits and misses to set 0. Every cold access misses and locks a line in set 0 until its fill is done,
+# so with enough misses outstanding the whole set is locked. The hot pages stay in the cache, so their
+# accesses are hits that should not have to wait for a free line.
+#
+# Usage: python set_0_hits.py [SET_SIZE [CACHE_PAGES [TOTAL_PAGES]]] > trace.txt
+# The geometry must match the ini file the trace is run with (the defaults match ini/hybridsim.ini).
+# The set is only ever fully locked if SET_SIZE is below INPUT_QUEUE_DEPTH, since no more misses than
+# that are outstanding at once.
+
+SET_SIZE = 64
+PAGE_SIZE = 4096
+CACHE_PAGES = 131072
+TOTAL_PAGES = 2097152
+BURST_SIZE = 64
+
+if len(sys.argv) > 4:
+	sys.stderr.write('Usage: python set_0_hits.py [SET_SIZE [CACHE_PAGES [TOTAL_PAGES]]]\n')
+	sys.exit(1)
+if len(sys.argv) > 1:
+	SET_SIZE = int(sys.argv[1])
+if len(sys.argv) > 2:
+	CACHE_PAGES = int(sys.argv[2])
+if len(sys.argv) > 3:
+	TOTAL_PAGES = int(sys.argv[3])
+
+NUM_SETS = CACHE_PAGES // SET_SIZE
+
+HOT_PAGES = 4		# Pages that are hit over and over.
+HOTS_PER_MISS = 3	# Hot accesses between two cold misses.
+ACCESSES = 100000
+CYCLE_STEP = 10
+
+def FLASH_ADDRESS(tag, set_num):
+	return ((tag * NUM_SETS + set_num) * PAGE_SIZE)
+
+cycle = 0
+def emit(write, addr):
+	global cycle
+	sys.stdout.write('%d %d %d\n' % (cycle, write, addr))
+	cycle += CYCLE_STEP
+
+# Bring the hot pages into the cache.
+for tag in range(HOT_PAGES):
+	emit(0, FLASH_ADDRESS(tag, 0))
+
+cold_tag = HOT_PAGES
+line = 0
+for i in range(ACCESSES):
+	if i % (HOTS_PER_MISS + 1) == 0:
+		emit(1, FLASH_ADDRESS(cold_tag, 0))
+		cold_tag += 1
+		if cold_tag == TOTAL_PAGES // NUM_SETS:
+			cold_tag = HOT_PAGES
+	else:
+		line = (line + 1) % (PAGE_SIZE // BURST_SIZE)
+		emit(0, FLASH_ADDRESS(i % HOT_PAGES, 0) + line * BURST_SIZE)
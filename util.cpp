@@ -48,6 +48,19 @@ void convert_uint64_t(uint64_t &var, string value, string infostring)
 	ss >> var;
 }
 
+void convert_double(double &var, string value, string infostring)
+{
+	// Convert it and check that the whole value was used.
+	stringstream ss;
+	ss << value;
+	ss >> var;
+	if (ss.fail() || !ss.eof())
+	{
+		cerr << "ERROR: Invalid number: " << infostring << " : " << value << "\n";
+		abort();
+	}
+}
+
 string strip(string input, string chars)
 {
 	size_t pos;